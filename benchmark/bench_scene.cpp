@@ -0,0 +1,124 @@
+#include "bench_scene.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    //wavy grid patch of (about) the wanted triangle count
+    void generate_mesh(BenchRandom &random, uint32_t triangles,
+                       std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+    {
+        //2 triangles per grid cell
+        const uint32_t cells = std::max(1u, uint32_t(std::lround(std::sqrt(triangles / 2.0))));
+        const uint32_t side = cells + 1;
+
+        const float frequency_x = random.range(1.f, 6.f);
+        const float frequency_y = random.range(1.f, 6.f);
+        const float phase = random.range(0.f, 6.2831853f);
+        const float amplitude = random.range(0.02f, 0.15f);
+        const glm::vec3 tint{random.next_float(), random.next_float(), random.next_float()};
+
+        vertices.clear();
+        vertices.reserve(side * side);
+        for(uint32_t y = 0; y < side; ++y)
+            for(uint32_t x = 0; x < side; ++x)
+            {
+                const float u = float(x) / float(cells) - 0.5f;
+                const float v = float(y) / float(cells) - 0.5f;
+                const float height = amplitude * std::sin(frequency_x * u * 6.2831853f + phase)
+                                               * std::cos(frequency_y * v * 6.2831853f);
+                const float shade = 0.5f + height / (2.f * amplitude);
+                vertices.push_back({{u, v, height}, tint * 0.6f + glm::vec3(shade * 0.4f)});
+            }
+
+        indices.clear();
+        indices.reserve(cells * cells * 6);
+        for(uint32_t y = 0; y < cells; ++y)
+            for(uint32_t x = 0; x < cells; ++x)
+            {
+                const uint32_t i = y * side + x;
+                //counter clockwise, same as front face of the pipeline
+                indices.insert(indices.end(), {i, i + 1, i + side + 1,
+                                               i + side + 1, i + side, i});
+            }
+    }
+}
+
+BenchScene generate_bench_scene(const BenchSceneParams &params)
+{
+    BenchScene scene;
+    scene.params = params;
+
+    BenchRandom random(params.seed);
+
+    scene.mesh_vertices.resize(params.mesh_count);
+    scene.mesh_indices.resize(params.mesh_count);
+    for(uint32_t m = 0; m < params.mesh_count; ++m)
+        generate_mesh(random, params.triangles_per_mesh, scene.mesh_vertices[m], scene.mesh_indices[m]);
+
+    //spread objects in front of the default camera
+    for(uint32_t m = 0; m < params.mesh_count; ++m)
+        for(uint32_t i = 0; i < params.instances_per_mesh; ++i)
+        {
+            BenchObject object
+            {
+                .mesh = m,
+                .position = {random.range(-3.f, 3.f), random.range(-2.f, 2.f), random.range(-10.f, -3.f)},
+                .rotation_axis = glm::normalize(glm::vec3(random.range(-1.f, 1.f), random.range(-1.f, 1.f), 1.f)),
+                .start_angle = random.range(0.f, 360.f),
+                .angular_speed = random.range(-90.f, 90.f),
+                .scale = random.range(0.3f, 1.2f)
+            };
+            scene.objects.push_back(object);
+        }
+
+    //own stream: same seed gives the same objects with or without lights
+    BenchRandom light_random(params.seed ^ 0x6C69676874ull);
+    const float volume = 6.f * 4.f * 7.f;
+    //lights covering a point on average
+    const float coverage = 8.f;
+    for(uint32_t i = 0; i < params.light_count; ++i)
+    {
+        const float radius = std::cbrt(3.f * coverage * volume / (4.f * 3.1415927f * float(params.light_count)));
+        Light light
+        {
+            .position = {light_random.range(-3.f, 3.f), light_random.range(-2.f, 2.f), light_random.range(-10.f, -3.f)},
+            .radius = radius,
+            .color = {light_random.range(0.2f, 1.f), light_random.range(0.2f, 1.f), light_random.range(0.2f, 1.f)},
+            //same brightness at the same fraction of the radius
+            .intensity = 1.f + radius * radius
+        };
+        //every 4th is a spot light pointing down
+        if(i % 4 == 3)
+        {
+            light.direction = glm::normalize(glm::vec3(light_random.range(-0.3f, 0.3f), -1.f, light_random.range(-0.3f, 0.3f)));
+            light.spot_cos_outer = 0.7f;
+            light.spot_cos_inner = 0.9f;
+        }
+        scene.lights.push_back(light);
+    }
+
+    return scene;
+}
+
+glm::mat4 BenchScene::model_at(const BenchObject &object, float time) const
+{
+    const float angle = object.start_angle + (params.animated ? object.angular_speed * time : 0.f);
+
+    glm::mat4 model(1.f);
+    model = glm::translate(model, object.position);
+    model = glm::rotate(model, glm::radians(angle), object.rotation_axis);
+    model = glm::scale(model, glm::vec3(object.scale));
+    return model;
+}
+
+uint64_t BenchScene::triangle_count() const
+{
+    uint64_t triangles = 0;
+    for(const BenchObject &object : objects)
+        triangles += mesh_indices[object.mesh].size() / 3;
+    return triangles;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../vk_utils.h"
+#include "../vk_light_clusters.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+//Synthetic scenes for benchmarks
+//Same seed + params give the same scene on every platform and compiler
+//(own random generator, std distributions are implementation defined)
+
+struct BenchSceneParams
+{
+    uint64_t seed = 1;
+    //unique geometries
+    uint32_t mesh_count = 16;
+    //draws of every geometry
+    uint32_t instances_per_mesh = 4;
+    uint32_t triangles_per_mesh = 2000;
+    bool animated = true;
+    //point + spot lights in the object volume, radius shrinks with the count
+    //so a point is lit by about the same number of lights (constant cluster load)
+    uint32_t light_count = 0;
+};
+
+//one draw of a mesh
+struct BenchObject
+{
+    uint32_t mesh;
+    glm::vec3 position;
+    glm::vec3 rotation_axis;
+    float start_angle;
+    //degrees per second
+    float angular_speed;
+    float scale;
+};
+
+struct BenchScene
+{
+    BenchSceneParams params;
+    std::vector<std::vector<Vertex>> mesh_vertices;
+    std::vector<std::vector<uint32_t>> mesh_indices;
+    std::vector<BenchObject> objects;
+    std::vector<Light> lights;
+
+    glm::mat4 model_at(const BenchObject &object, float time) const;
+    uint64_t triangle_count() const;
+};
+
+class BenchRandom
+{
+public:
+    explicit BenchRandom(uint64_t seed) : _state(seed) {}
+
+    //splitmix64
+    uint64_t next()
+    {
+        uint64_t z = (_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    //[0, 1)
+    float next_float() { return float(next() >> 40) * (1.f / 16777216.f); }
+    float range(float min, float max) { return min + (max - min) * next_float(); }
+
+private:
+    uint64_t _state;
+};
+
+BenchScene generate_bench_scene(const BenchSceneParams &params);
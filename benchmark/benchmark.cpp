@@ -0,0 +1,305 @@
+#define GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <glfw/glfw3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../vulkan_renderer.h"
+#include "../profiler.h"
+#include "bench_scene.h"
+
+//Deterministic end-to-end frame benchmark
+//usage: Benchmark [--seed N] [--meshes N] [--instances N] [--triangles N] [--lights N] [--static]
+//                 [--frames N] [--warmup N] [--width N] [--height N] [--windowed]
+//                 [--prepass off|on|auto] [--target-gpu-ms X] [--out file.json]
+//headless by default, so the same run works on CI (software ICD) and on lab GPUs
+
+struct BenchConfig
+{
+    BenchSceneParams scene;
+    uint32_t frames = 1000;
+    uint32_t warmup_frames = 60;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    bool windowed = false;
+    DepthPrepassMode depth_prepass = DepthPrepassMode::Auto;
+    //dynamic resolution target, 0 -- native resolution
+    double target_gpu_ms = 0.0;
+    std::string out_path;
+};
+
+struct Percentiles
+{
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+static bool parse_args(int argc, char **argv, BenchConfig &config)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        auto next_u64 = [&]() { return std::stoull(argv[++i]); };
+
+        if(arg == "--seed" && has_value)            config.scene.seed = next_u64();
+        else if(arg == "--meshes" && has_value)     config.scene.mesh_count = uint32_t(next_u64());
+        else if(arg == "--instances" && has_value)  config.scene.instances_per_mesh = uint32_t(next_u64());
+        else if(arg == "--triangles" && has_value)  config.scene.triangles_per_mesh = uint32_t(next_u64());
+        else if(arg == "--lights" && has_value)     config.scene.light_count = uint32_t(next_u64());
+        else if(arg == "--static")                  config.scene.animated = false;
+        else if(arg == "--frames" && has_value)     config.frames = uint32_t(next_u64());
+        else if(arg == "--warmup" && has_value)     config.warmup_frames = uint32_t(next_u64());
+        else if(arg == "--width" && has_value)      config.width = uint32_t(next_u64());
+        else if(arg == "--height" && has_value)     config.height = uint32_t(next_u64());
+        else if(arg == "--windowed")                config.windowed = true;
+        else if(arg == "--prepass" && has_value)
+        {
+            const std::string mode = argv[++i];
+            if(mode == "off")       config.depth_prepass = DepthPrepassMode::Off;
+            else if(mode == "on")   config.depth_prepass = DepthPrepassMode::On;
+            else if(mode == "auto") config.depth_prepass = DepthPrepassMode::Auto;
+            else
+            {
+                std::cerr << "Unknown prepass mode: " << mode << "\n";
+                return false;
+            }
+        }
+        else if(arg == "--target-gpu-ms" && has_value)  config.target_gpu_ms = std::stod(argv[++i]);
+        else if(arg == "--out" && has_value)        config.out_path = argv[++i];
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return false;
+        }
+    }
+    return config.frames > 0;
+}
+
+static Percentiles compute_percentiles(std::vector<double> samples)
+{
+    Percentiles result;
+    if(samples.empty())
+        return result;
+
+    std::sort(begin(samples), end(samples));
+    //nearest rank
+    auto rank = [&](double p)
+    {
+        size_t index = size_t(p * double(samples.size()));
+        return samples[std::min(index, samples.size() - 1)];
+    };
+
+    double sum = 0.0;
+    for(double s : samples)
+        sum += s;
+
+    result.mean = sum / double(samples.size());
+    result.p50 = rank(0.50);
+    result.p95 = rank(0.95);
+    result.p99 = rank(0.99);
+    result.max = samples.back();
+    return result;
+}
+
+static void write_percentiles(std::ostream &out, const char *name, const Percentiles &p)
+{
+    out << "  \"" << name << "\": {\"mean\": " << p.mean << ", \"p50\": " << p.p50
+        << ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << "}";
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    if(!parse_args(argc, argv, config))
+        return EXIT_FAILURE;
+
+    GLFWwindow *window = nullptr;
+    VulkanRenderer renderer;
+
+    if(config.windowed)
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        window = glfwCreateWindow(int(config.width), int(config.height), "Benchmark", nullptr, nullptr);
+        if(renderer.init(window))
+            return EXIT_FAILURE;
+    }
+    else if(renderer.init_headless(config.width, config.height))
+    {
+        return EXIT_FAILURE;
+    }
+
+    renderer.set_depth_prepass_mode(config.depth_prepass);
+    if(config.target_gpu_ms > 0.0 && !renderer.set_dynamic_resolution(config.target_gpu_ms))
+        std::cerr << "Running at native resolution\n";
+
+    //Build the scene: first object of a mesh uploads it, the rest are instances
+    const BenchScene scene = generate_bench_scene(config.scene);
+    std::vector<uint32_t> mesh_model_ids(scene.mesh_vertices.size(), UINT32_MAX);
+    std::vector<uint32_t> object_model_ids;
+    for(const BenchObject &object : scene.objects)
+    {
+        uint32_t &mesh_id = mesh_model_ids[object.mesh];
+        if(mesh_id == UINT32_MAX)
+        {
+            std::vector<Vertex> vertices = scene.mesh_vertices[object.mesh];
+            std::vector<uint32_t> indices = scene.mesh_indices[object.mesh];
+            mesh_id = renderer.add_mesh(vertices, indices);
+            object_model_ids.push_back(mesh_id);
+        }
+        else
+        {
+            object_model_ids.push_back(renderer.add_mesh_instance(mesh_id));
+        }
+        renderer.updateModel(object_model_ids.back(), scene.model_at(object, 0.f));
+    }
+    //lit scenes: dim ambient so the lights show
+    for(const Light &light : scene.lights)
+        renderer.add_light(light);
+    if(!scene.lights.empty())
+        renderer.set_ambient_light(glm::vec3(0.1f));
+    const uint64_t scene_upload_bytes = renderer.get_stats().uploaded_bytes;
+
+    //fixed time step: animated scenes are the same on every run
+    const float delta_time = 1.f / 60.f;
+    float scene_time = 0.f;
+
+    std::vector<double> frame_times_ms;
+    std::vector<double> gpu_times_ms;
+    frame_times_ms.reserve(config.frames);
+    gpu_times_ms.reserve(config.frames);
+    uint64_t draw_calls = 0;
+    uint32_t depth_prepass_frames = 0;
+    std::vector<double> render_scales;
+    render_scales.reserve(config.frames);
+    uint64_t measure_begin_ns = 0;
+    uint64_t measure_begin_bytes = 0;
+
+    const uint32_t total_frames = config.warmup_frames + config.frames;
+    for(uint32_t frame = 0; frame < total_frames; ++frame)
+    {
+        if(window)
+        {
+            glfwPollEvents();
+            if(glfwWindowShouldClose(window))
+                break;
+        }
+
+        const bool measured = frame >= config.warmup_frames;
+        if(frame == config.warmup_frames)
+        {
+            measure_begin_ns = profiler::now_ns();
+            measure_begin_bytes = renderer.get_stats().uploaded_bytes;
+        }
+
+        const uint64_t frame_begin_ns = profiler::now_ns();
+
+        if(config.scene.animated)
+        {
+            PROFILE_ZONE("scene update");
+            scene_time += delta_time;
+            for(size_t i = 0; i < scene.objects.size(); ++i)
+                renderer.updateModel(object_model_ids[i], scene.model_at(scene.objects[i], scene_time));
+        }
+
+        renderer.draw();
+
+        if(measured)
+        {
+            frame_times_ms.push_back(double(profiler::now_ns() - frame_begin_ns) / 1e6);
+            //result of an earlier frame, but the same amount of samples
+            if(renderer.get_gpu_frame_time_ms() > 0.0)
+                gpu_times_ms.push_back(renderer.get_gpu_frame_time_ms());
+            draw_calls += renderer.get_stats().draw_calls;
+            depth_prepass_frames += renderer.get_stats().depth_prepass ? 1 : 0;
+            render_scales.push_back(renderer.get_stats().render_scale);
+        }
+    }
+    const uint64_t measure_end_ns = profiler::now_ns();
+    const uint64_t measured_bytes = renderer.get_stats().uploaded_bytes - measure_begin_bytes;
+    const std::string device_name = renderer.get_stats().device_name;
+    const double init_ms = renderer.get_stats().init_ms;
+    const bool pipeline_cache_warm = renderer.get_stats().pipeline_cache_warm;
+    const uint64_t lazy_attachment_bytes = renderer.get_stats().lazy_attachment_bytes;
+    const double overdraw = renderer.get_stats().overdraw;
+    const DescriptorAllocator::Stats descriptor_stats = renderer.get_descriptor_stats();
+
+    renderer.cleanup();
+    if(window)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+
+    const size_t measured_frames = std::max<size_t>(frame_times_ms.size(), 1);
+
+    //CPU time per subsystem from profiler zones of measured frames
+    std::map<std::string, double> zone_totals_ms;
+    for(const profiler::ZoneEvent &event : profiler::collect())
+    {
+        if(event.thread_id == profiler::GPU_THREAD_ID || event.begin_ns < measure_begin_ns || event.end_ns > measure_end_ns)
+            continue;
+        zone_totals_ms[event.name] += double(event.end_ns - event.begin_ns) / 1e6;
+    }
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"device\": \"" << device_name << "\",\n";
+    json << "  \"mode\": \"" << (config.windowed ? "windowed" : "headless") << "\",\n";
+    json << "  \"resolution\": [" << config.width << ", " << config.height << "],\n";
+    json << "  \"init_ms\": " << init_ms << ",\n";
+    json << "  \"pipeline_cache\": \"" << (pipeline_cache_warm ? "warm" : "cold") << "\",\n";
+    json << "  \"lazy_attachment_bytes\": " << lazy_attachment_bytes << ",\n";
+    json << "  \"scene\": {\"seed\": " << config.scene.seed
+         << ", \"meshes\": " << config.scene.mesh_count
+         << ", \"instances_per_mesh\": " << config.scene.instances_per_mesh
+         << ", \"triangles_per_mesh\": " << config.scene.triangles_per_mesh
+         << ", \"lights\": " << config.scene.light_count
+         << ", \"animated\": " << (config.scene.animated ? "true" : "false")
+         << ", \"total_triangles\": " << scene.triangle_count() << "},\n";
+    json << "  \"frames\": " << frame_times_ms.size() << ",\n";
+    json << "  \"warmup_frames\": " << config.warmup_frames << ",\n";
+    write_percentiles(json, "frame_time_ms", compute_percentiles(frame_times_ms));
+    json << ",\n";
+    write_percentiles(json, "gpu_time_ms", compute_percentiles(gpu_times_ms));
+    json << ",\n";
+    json << "  \"cpu_ms_per_frame\": {";
+    bool first = true;
+    for(const auto &[name, total_ms] : zone_totals_ms)
+    {
+        json << (first ? "" : ", ") << "\"" << name << "\": " << total_ms / double(measured_frames);
+        first = false;
+    }
+    json << "},\n";
+    json << "  \"draw_calls_per_frame\": " << double(draw_calls) / double(measured_frames) << ",\n";
+    json << "  \"overdraw\": " << overdraw << ",\n";
+    json << "  \"depth_prepass_frames\": " << depth_prepass_frames << ",\n";
+    json << "  \"target_gpu_ms\": " << config.target_gpu_ms << ",\n";
+    write_percentiles(json, "render_scale", compute_percentiles(render_scales));
+    json << ",\n";
+    json << "  \"descriptors\": {\"requests\": " << descriptor_stats.requests
+         << ", \"cache_hits\": " << descriptor_stats.cache_hits
+         << ", \"allocations\": " << descriptor_stats.allocations
+         << ", \"pools\": " << descriptor_stats.pools << "},\n";
+    json << "  \"uploaded_bytes_scene\": " << scene_upload_bytes << ",\n";
+    json << "  \"uploaded_bytes_per_frame\": " << double(measured_bytes) / double(measured_frames) << "\n";
+    json << "}\n";
+
+    std::cout << json.str();
+    if(!config.out_path.empty())
+    {
+        std::ofstream out(config.out_path, std::ios::trunc);
+        out << json.str();
+    }
+
+    return EXIT_SUCCESS;
+}
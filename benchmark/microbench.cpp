@@ -0,0 +1,331 @@
+#define GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <benchmark/benchmark.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../vulkan_renderer.h"
+#include "../mapped_file.h"
+#include "../geometry_codec.h"
+#include "../mesh_file.h"
+#include "../mesh_import.h"
+#include "bench_scene.h"
+
+//Microbenchmarks of renderer CPU hot paths (Google Benchmark)
+//Vulkan cases run on a headless renderer, so a software ICD (lavapipe) is enough
+//items_per_second in the output is the throughput per object / byte
+
+struct RendererBenchAccess
+{
+    static void record_commands(VulkanRenderer &renderer, uint32_t image)
+    {
+        //nothing is submitted, so uniform space can be rewound like after a fence wait
+        renderer._uniform_ring.begin_frame(renderer._current_frame);
+        renderer.record_commands(image);
+    }
+    static void update_uniform_buffers(VulkanRenderer &renderer, uint32_t image) { renderer.update_uniform_buffers(image); }
+};
+
+namespace
+{
+    //headless renderer with `objects` draws of one small mesh
+    std::unique_ptr<VulkanRenderer> create_renderer(uint32_t objects)
+    {
+        auto renderer = std::make_unique<VulkanRenderer>();
+        if(renderer->init_headless(256, 256))
+            return nullptr;
+
+        BenchSceneParams params;
+        params.mesh_count = 1;
+        params.instances_per_mesh = objects;
+        params.triangles_per_mesh = 128;
+        const BenchScene scene = generate_bench_scene(params);
+
+        std::vector<Vertex> vertices = scene.mesh_vertices[0];
+        std::vector<uint32_t> indices = scene.mesh_indices[0];
+        const uint32_t mesh_id = renderer->add_mesh(vertices, indices);
+        for(uint32_t i = 1; i < objects; ++i)
+            renderer->add_mesh_instance(mesh_id);
+
+        return renderer;
+    }
+}
+
+static void BM_record_commands(benchmark::State &state)
+{
+    const uint32_t objects = uint32_t(state.range(0));
+    auto renderer = create_renderer(objects);
+    if(!renderer)
+    {
+        state.SkipWithError("No Vulkan device");
+        return;
+    }
+
+    for(auto _ : state)
+        RendererBenchAccess::record_commands(*renderer, 0);
+
+    state.SetItemsProcessed(state.iterations() * objects);
+    renderer->cleanup();
+}
+BENCHMARK(BM_record_commands)->RangeMultiplier(8)->Range(8, 4096)->Unit(benchmark::kMicrosecond);
+
+static void BM_update_uniform_buffers(benchmark::State &state)
+{
+    auto renderer = create_renderer(1);
+    if(!renderer)
+    {
+        state.SkipWithError("No Vulkan device");
+        return;
+    }
+
+    for(auto _ : state)
+        RendererBenchAccess::update_uniform_buffers(*renderer, 0);
+
+    state.SetItemsProcessed(state.iterations());
+    renderer->cleanup();
+}
+BENCHMARK(BM_update_uniform_buffers);
+
+//model matrices of an animated scene (what the application does every frame)
+static void BM_model_matrix_update(benchmark::State &state)
+{
+    BenchSceneParams params;
+    params.mesh_count = 1;
+    params.instances_per_mesh = uint32_t(state.range(0));
+    params.triangles_per_mesh = 2;
+    const BenchScene scene = generate_bench_scene(params);
+
+    std::vector<glm::mat4> models(scene.objects.size());
+    float time = 0.f;
+    for(auto _ : state)
+    {
+        time += 1.f / 60.f;
+        for(size_t i = 0; i < scene.objects.size(); ++i)
+            models[i] = scene.model_at(scene.objects[i], time);
+        benchmark::DoNotOptimize(models.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * scene.objects.size());
+}
+BENCHMARK(BM_model_matrix_update)->RangeMultiplier(8)->Range(64, 32768);
+
+//split + sort of the scene into opaque / transparent draw lists (every 4th object transparent)
+static void BM_build_render_queues(benchmark::State &state)
+{
+    BenchSceneParams params;
+    params.mesh_count = 1;
+    params.instances_per_mesh = uint32_t(state.range(0));
+    params.triangles_per_mesh = 2;
+    const BenchScene scene = generate_bench_scene(params);
+
+    std::vector<Mesh> meshes(scene.objects.size());
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+        meshes[i].set_model(scene.model_at(scene.objects[i], 0.f));
+        meshes[i].set_transparent(i % 4 == 0);
+    }
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+
+    RenderQueues queues;
+    for(auto _ : state)
+    {
+        queues.build(meshes, view);
+        benchmark::DoNotOptimize(queues.get_opaque().data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * meshes.size());
+}
+BENCHMARK(BM_build_render_queues)->RangeMultiplier(8)->Range(64, 262144);
+
+//whole file read (the old read_f: ifstream into a vector) vs MappedFile, arg 1: 0 -- read, 1 -- mapped
+//every page is touched, a mapping costs its page faults instead of the copy
+static void BM_read_file(benchmark::State &state)
+{
+    const size_t file_size = size_t(state.range(0)) << 20;
+    const bool mapped = state.range(1) != 0;
+    const std::string path = "microbench_read_file.bin";
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        std::vector<char> chunk(1 << 20, 'v');
+        for(size_t written = 0; written < file_size; written += chunk.size())
+            file.write(chunk.data(), chunk.size());
+    }
+
+    auto touch_pages = [](const uint8_t *data, size_t size)
+    {
+        uint64_t sum = 0;
+        for(size_t i = 0; i < size; i += 4096)
+            sum += data[i];
+        return sum;
+    };
+
+    for(auto _ : state)
+    {
+        if(mapped)
+        {
+            MappedFile file(path);
+            benchmark::DoNotOptimize(touch_pages(file.data(), file.size()));
+        }
+        else
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            std::vector<char> data(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), std::streamsize(data.size()));
+            benchmark::DoNotOptimize(touch_pages(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * file_size);
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_read_file)->ArgsProduct({{1, 64, 256}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+//CPU side of load_mesh_file: map + parse + blobs copied (or decoded) to a staging sized buffer
+//(files stay in the page cache, so this is the ceiling, cold loads are bound by the disk)
+//compressed files pay off while file_bytes/s stays above what the disk reads
+static void BM_mesh_file_load(benchmark::State &state)
+{
+    BenchSceneParams params;
+    params.mesh_count = uint32_t(state.range(0));
+    params.instances_per_mesh = 1;
+    params.triangles_per_mesh = 4096;
+    const BenchScene scene = generate_bench_scene(params);
+
+    std::vector<MeshFileSource> sources;
+    for(size_t i = 0; i < scene.mesh_vertices.size(); ++i)
+    {
+        const std::vector<Vertex> &vertices = scene.mesh_vertices[i];
+        sources.push_back({{reinterpret_cast<const uint8_t*>(vertices.data()), vertices.size() * sizeof(Vertex)},
+                           {scene.mesh_indices[i]}});
+    }
+    const std::string path = "microbench_meshes.vmsh";
+    write_mesh_file(path, sizeof(Vertex), sources, state.range(1) != 0);
+
+    std::vector<uint8_t> staging(64 << 20);
+    uint64_t bytes = 0, file_bytes = 0;
+    for(auto _ : state)
+    {
+        MappedFile file(path);
+        MeshFileView view;
+        std::string error;
+        if(!parse_mesh_file(file.data(), file.size(), view, error))
+        {
+            state.SkipWithError(error.c_str());
+            break;
+        }
+        const uint64_t blob_sizes[] = {view.vertex_count * view.vertex_stride, view.index_count * sizeof(uint32_t)};
+        const std::span<const uint8_t> blobs[] =
+        {
+            view.vertices,
+            {reinterpret_cast<const uint8_t*>(view.indices.data()), view.indices.size_bytes()}
+        };
+        const std::span<const uint8_t> streams[] = {view.vertex_stream, view.index_stream};
+        for(size_t b = 0; b < 2; ++b)
+            for(uint64_t offset = 0; offset < blob_sizes[b]; offset += staging.size())
+            {
+                const size_t size = size_t(std::min<uint64_t>(staging.size(), blob_sizes[b] - offset));
+                if(view.compressed)
+                    decode_stream(streams[b], staging.data(), offset, size);
+                else
+                    std::memcpy(staging.data(), blobs[b].data() + offset, size);
+            }
+        benchmark::DoNotOptimize(staging.data());
+        bytes = blob_sizes[0] + blob_sizes[1];
+        file_bytes = file.size();
+    }
+
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.counters["file_bytes/s"] = benchmark::Counter(double(state.iterations() * file_bytes), benchmark::Counter::kIsRate);
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_mesh_file_load)->ArgsProduct({{16, 256}, {0, 1}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//geometry_codec decode of a scene`s vertices + indices with `range` threads (0 -- all cores)
+//decode outruns the disk when compressed_bytes/s is above its read speed (NVMe: ~3-7 GB/s)
+static void BM_decode_geometry(benchmark::State &state)
+{
+    BenchSceneParams params;
+    params.mesh_count = 64;
+    params.instances_per_mesh = 1;
+    params.triangles_per_mesh = 16384;
+    const BenchScene scene = generate_bench_scene(params);
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    for(size_t i = 0; i < scene.mesh_vertices.size(); ++i)
+    {
+        vertices.insert(vertices.end(), scene.mesh_vertices[i].begin(), scene.mesh_vertices[i].end());
+        indices.insert(indices.end(), scene.mesh_indices[i].begin(), scene.mesh_indices[i].end());
+    }
+    const std::vector<uint8_t> vertex_stream = encode_vertices(reinterpret_cast<const uint8_t*>(vertices.data()),
+                                                               vertices.size(), sizeof(Vertex));
+    const std::vector<uint8_t> index_stream = encode_indices(indices.data(), indices.size());
+
+    const uint32_t threads = uint32_t(state.range(0));
+    std::vector<uint8_t> decoded_vertices(vertices.size() * sizeof(Vertex)), decoded_indices(indices.size() * sizeof(uint32_t));
+    for(auto _ : state)
+    {
+        decode_stream(vertex_stream, decoded_vertices.data(), 0, decoded_vertices.size(), threads);
+        decode_stream(index_stream, decoded_indices.data(), 0, decoded_indices.size(), threads);
+        benchmark::DoNotOptimize(decoded_vertices.data());
+        benchmark::DoNotOptimize(decoded_indices.data());
+    }
+
+    const double compressed = double(vertex_stream.size() + index_stream.size());
+    state.SetBytesProcessed(state.iterations() * (decoded_vertices.size() + decoded_indices.size()));
+    state.counters["compressed_bytes/s"] = benchmark::Counter(state.iterations() * compressed, benchmark::Counter::kIsRate);
+    state.counters["ratio"] = double(decoded_vertices.size() + decoded_indices.size()) / compressed;
+}
+BENCHMARK(BM_decode_geometry)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//OBJ of `range` bench meshes through the importer (parallel across meshes, no upload)
+static void BM_import_obj(benchmark::State &state)
+{
+    BenchSceneParams params;
+    params.mesh_count = uint32_t(state.range(0));
+    params.instances_per_mesh = 1;
+    params.triangles_per_mesh = 4096;
+    const BenchScene scene = generate_bench_scene(params);
+
+    const std::string path = "microbench_import.obj";
+    {
+        std::ofstream file(path, std::ios::trunc);
+        uint32_t first_vertex = 1;
+        for(size_t i = 0; i < scene.mesh_vertices.size(); ++i)
+        {
+            file << "o mesh" << i << "\n";
+            for(const Vertex &vertex : scene.mesh_vertices[i])
+                file << "v " << vertex.position.x << " " << vertex.position.y << " " << vertex.position.z << " "
+                     << vertex.color.r << " " << vertex.color.g << " " << vertex.color.b << "\n";
+            const std::vector<uint32_t> &indices = scene.mesh_indices[i];
+            for(size_t t = 0; t + 2 < indices.size(); t += 3)
+                file << "f " << indices[t] + first_vertex << " " << indices[t + 1] + first_vertex << " "
+                     << indices[t + 2] + first_vertex << "\n";
+            first_vertex += static_cast<uint32_t>(scene.mesh_vertices[i].size());
+        }
+    }
+
+    uint64_t bytes = 0, triangles = 0;
+    for(auto _ : state)
+    {
+        const ImportStats stats = import_meshes(path, [](ImportedMesh &mesh) { benchmark::DoNotOptimize(mesh.indices.data()); });
+        bytes = stats.bytes;
+        triangles = stats.triangles;
+    }
+
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.counters["triangles/s"] = benchmark::Counter(double(state.iterations() * triangles), benchmark::Counter::kIsRate);
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_import_obj)->Arg(16)->Arg(128)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
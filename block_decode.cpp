@@ -0,0 +1,126 @@
+#include "block_decode.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    void unpack_565(uint16_t c, uint8_t *rgb)
+    {
+        //bit replication fills the low bits
+        const uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = uint8_t((r << 3) | (r >> 2));
+        rgb[1] = uint8_t((g << 2) | (g >> 4));
+        rgb[2] = uint8_t((b << 3) | (b >> 2));
+    }
+
+    //BC1 colour block, 16 RGBA texels row by row
+    //four_colors -- BC2/BC3 colour blocks never use the 3 colour + transparent mode
+    void decode_color_block(const uint8_t *block, bool four_colors, bool alpha, uint8_t texels[16][4])
+    {
+        uint16_t c0, c1;
+        uint32_t indices;
+        std::memcpy(&c0, block, 2);
+        std::memcpy(&c1, block + 2, 2);
+        std::memcpy(&indices, block + 4, 4);
+
+        uint8_t palette[4][4];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = 255;
+        if(four_colors || c0 > c1)
+        {
+            for(int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = uint8_t((2 * palette[0][c] + palette[1][c] + 1) / 3);
+                palette[3][c] = uint8_t((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+            }
+            palette[2][3] = palette[3][3] = 255;
+        }
+        else
+        {
+            for(int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = uint8_t((palette[0][c] + palette[1][c]) / 2);
+                palette[3][c] = 0;
+            }
+            palette[2][3] = 255;
+            //transparent black, opaque black in the RGB format
+            palette[3][3] = alpha ? 0 : 255;
+        }
+
+        for(int i = 0; i < 16; ++i)
+            std::memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4);
+    }
+
+    //BC3 / BC4 style alpha: 2 endpoints + 3 bit indices
+    void decode_alpha_block(const uint8_t *block, uint8_t texels[16][4])
+    {
+        const uint32_t a0 = block[0], a1 = block[1];
+        uint8_t palette[8];
+        palette[0] = uint8_t(a0);
+        palette[1] = uint8_t(a1);
+        if(a0 > a1)
+        {
+            for(uint32_t i = 1; i < 7; ++i)
+                palette[i + 1] = uint8_t(((7 - i) * a0 + i * a1 + 3) / 7);
+        }
+        else
+        {
+            for(uint32_t i = 1; i < 5; ++i)
+                palette[i + 1] = uint8_t(((5 - i) * a0 + i * a1 + 2) / 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        std::memcpy(&indices, block + 2, 6);
+        for(int i = 0; i < 16; ++i)
+            texels[i][3] = palette[(indices >> (3 * i)) & 7];
+    }
+}
+
+size_t get_block_size(BlockFormat format)
+{
+    return format == BlockFormat::BC1_RGB || format == BlockFormat::BC1_RGBA ? 8 : 16;
+}
+
+void decode_block_rows(BlockFormat format, const uint8_t *blocks, uint32_t width, uint32_t height,
+                       uint32_t first_row, uint32_t last_row, uint8_t *rgba)
+{
+    const uint32_t blocks_x = (width + 3) / 4;
+    const size_t block_size = get_block_size(format);
+
+    uint8_t texels[16][4];
+    for(uint32_t by = first_row; by < last_row; ++by)
+        for(uint32_t bx = 0; bx < blocks_x; ++bx)
+        {
+            const uint8_t *block = blocks + (size_t(by) * blocks_x + bx) * block_size;
+            switch(format)
+            {
+            case BlockFormat::BC1_RGB:
+            case BlockFormat::BC1_RGBA:
+                decode_color_block(block, false, format == BlockFormat::BC1_RGBA, texels);
+                break;
+            case BlockFormat::BC2:
+                decode_color_block(block + 8, true, false, texels);
+                //explicit 4 bit alpha
+                for(int i = 0; i < 16; ++i)
+                {
+                    const uint32_t a = (block[i / 2] >> (4 * (i % 2))) & 15;
+                    texels[i][3] = uint8_t(a * 17);
+                }
+                break;
+            case BlockFormat::BC3:
+                decode_color_block(block + 8, true, false, texels);
+                decode_alpha_block(block, texels);
+                break;
+            }
+
+            //blocks on the right / bottom edge cover texels past the image
+            const uint32_t x0 = bx * 4, y0 = by * 4;
+            for(uint32_t y = 0; y < 4 && y0 + y < height; ++y)
+                for(uint32_t x = 0; x < 4 && x0 + x < width; ++x)
+                    std::memcpy(rgba + ((size_t(y0 + y) * width) + x0 + x) * 4, texels[y * 4 + x], 4);
+        }
+}
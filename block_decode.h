@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//Software decoders of block compressed texels (4x4 blocks -> 8 bit RGBA)
+//fallback for devices without the format (e.g. BC textures on mobile GPUs)
+enum class BlockFormat
+{
+    BC1_RGB,
+    BC1_RGBA,
+    BC2,
+    BC3
+};
+
+//bytes of one 4x4 block
+size_t get_block_size(BlockFormat format);
+
+//block rows [first_row, last_row) of a width x height image into RGBA rows (width * 4 bytes each)
+//independent rows, so big images are split between threads
+void decode_block_rows(BlockFormat format, const uint8_t *blocks, uint32_t width, uint32_t height,
+                       uint32_t first_row, uint32_t last_row, uint8_t *rgba);
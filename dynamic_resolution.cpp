@@ -0,0 +1,57 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    //weight of a new GPU time sample (moving average, one spike doesn`t halve the resolution)
+    constexpr double SAMPLE_WEIGHT = 0.2;
+    //aim a bit below the target, so small spikes still fit
+    constexpr double TARGET_HEADROOM = 0.95;
+    //scale changes smaller than it are ignored (no resolution wobble)
+    constexpr float DEAD_BAND = 0.02f;
+    //max change per sample: drop fast on spikes, come back slowly
+    constexpr float MAX_STEP_DOWN = 0.1f;
+    constexpr float MAX_STEP_UP = 0.02f;
+    constexpr uint32_t EXTENT_ALIGNMENT = 8;
+}
+
+void DynamicResolution::configure(double target_gpu_ms, float min_scale, float max_scale)
+{
+    _target_ms = std::max(target_gpu_ms, 0.0);
+    _min_scale = std::clamp(min_scale, 0.1f, 1.f);
+    _max_scale = std::clamp(max_scale, _min_scale, 1.f);
+    _scale = _max_scale;
+    _filtered_ms = 0.0;
+}
+
+float DynamicResolution::update(double gpu_frame_ms)
+{
+    if(!is_enabled() || gpu_frame_ms <= 0.0)
+        return get_scale();
+
+    _filtered_ms = _filtered_ms == 0.0 ? gpu_frame_ms : _filtered_ms + (gpu_frame_ms - _filtered_ms) * SAMPLE_WEIGHT;
+
+    //GPU time is mostly per pixel, pixels go with scale^2
+    const float wanted = std::clamp(_scale * float(std::sqrt(_target_ms * TARGET_HEADROOM / _filtered_ms)),
+                                    _min_scale, _max_scale);
+    if(std::abs(wanted - _scale) >= DEAD_BAND || wanted == _min_scale || wanted == _max_scale)
+        _scale = std::clamp(wanted, _scale - MAX_STEP_DOWN, _scale + MAX_STEP_UP);
+
+    return _scale;
+}
+
+VkExtent2D DynamicResolution::get_render_extent(VkExtent2D full_extent) const
+{
+    const float scale = get_scale();
+    if(scale >= 1.f)
+        return full_extent;
+
+    auto scaled = [scale](uint32_t size)
+    {
+        const uint32_t aligned = uint32_t(float(size) * scale) / EXTENT_ALIGNMENT * EXTENT_ALIGNMENT;
+        return std::clamp(aligned, std::min(size, EXTENT_ALIGNMENT), size);
+    };
+    return {scaled(full_extent.width), scaled(full_extent.height)};
+}
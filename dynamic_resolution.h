@@ -0,0 +1,26 @@
+#pragma once
+
+#include "vk_utils.h"
+
+//Render scale controller: keeps GPU frame time at the target by changing the rendered pixel count
+//fed with GPU timestamp results (MAX_FRAME_DRAWS frames old), so it reacts smoothly instead of per frame
+class DynamicResolution
+{
+public:
+    //target_gpu_ms 0 -- off, scene is rendered at full resolution
+    void configure(double target_gpu_ms, float min_scale, float max_scale);
+    bool is_enabled() const { return _target_ms > 0.0; }
+
+    //GPU time of a finished frame, returns the new scale
+    float update(double gpu_frame_ms);
+    float get_scale() const { return is_enabled() ? _scale : 1.f; }
+    //part of the full size target to render into (multiple of 8 pixels, never bigger than full)
+    VkExtent2D get_render_extent(VkExtent2D full_extent) const;
+
+private:
+    double _target_ms = 0.0;
+    float _min_scale = 0.5f;
+    float _max_scale = 1.f;
+    float _scale = 1.f;
+    double _filtered_ms = 0.0;
+};
@@ -0,0 +1,355 @@
+#include "geometry_codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace geometry_codec;
+
+namespace
+{
+    constexpr size_t GROUP_SIZE = 16;
+
+    uint32_t zigzag(uint32_t delta) { return (delta << 1) ^ uint32_t(int32_t(delta) >> 31); }
+    uint32_t unzigzag(uint32_t value) { return (value >> 1) ^ (0u - (value & 1)); }
+
+    size_t padded_count(size_t count) { return (count + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE; }
+
+    [[noreturn]] void fail_decode() { throw std::runtime_error("Failed to decode geometry: broken chunk data!"); }
+
+    //byte plane (padded to whole groups) -> 2 bit mode per group in a header, then the packed groups
+    void encode_plane(const uint8_t *plane, size_t padded, std::vector<uint8_t> &out)
+    {
+        const size_t groups = padded / GROUP_SIZE;
+        const size_t header = out.size();
+        out.resize(out.size() + (groups + 3) / 4, 0);
+        for(size_t g = 0; g < groups; ++g)
+        {
+            const uint8_t *values = plane + g * GROUP_SIZE;
+            const uint8_t max_value = *std::max_element(values, values + GROUP_SIZE);
+            const uint32_t mode = max_value == 0 ? 0 : max_value < 4 ? 1 : max_value < 16 ? 2 : 3;
+            out[header + g / 4] |= uint8_t(mode << (g % 4 * 2));
+
+            if(mode == 1)
+            {
+                for(size_t k = 0; k < GROUP_SIZE; k += 4)
+                    out.push_back(uint8_t(values[k] | values[k + 1] << 2 | values[k + 2] << 4 | values[k + 3] << 6));
+            }
+            else if(mode == 2)
+            {
+                for(size_t k = 0; k < GROUP_SIZE; k += 2)
+                    out.push_back(uint8_t(values[k] | values[k + 1] << 4));
+            }
+            else if(mode == 3)
+            {
+                out.insert(out.end(), values, values + GROUP_SIZE);
+            }
+        }
+    }
+
+    //fixed 16 wide unpack loops, the compiler turns them into SIMD shifts and masks
+    const uint8_t* decode_plane(const uint8_t *src, const uint8_t *end, uint8_t *plane, size_t padded)
+    {
+        const size_t groups = padded / GROUP_SIZE;
+        const uint8_t *header = src;
+        src += (groups + 3) / 4;
+        if(src > end)
+            fail_decode();
+
+        for(size_t g = 0; g < groups; ++g)
+        {
+            uint8_t *values = plane + g * GROUP_SIZE;
+            switch((header[g / 4] >> (g % 4 * 2)) & 3)
+            {
+            case 0:
+                std::memset(values, 0, GROUP_SIZE);
+                break;
+            case 1:
+                if(end - src < 4)
+                    fail_decode();
+                for(size_t k = 0; k < GROUP_SIZE; ++k)
+                    values[k] = (src[k / 4] >> (k % 4 * 2)) & 3;
+                src += 4;
+                break;
+            case 2:
+                if(end - src < 8)
+                    fail_decode();
+                for(size_t k = 0; k < GROUP_SIZE; ++k)
+                    values[k] = (src[k / 2] >> (k % 2 * 4)) & 15;
+                src += 8;
+                break;
+            default:
+                if(end - src < ptrdiff_t(GROUP_SIZE))
+                    fail_decode();
+                std::memcpy(values, src, GROUP_SIZE);
+                src += GROUP_SIZE;
+                break;
+            }
+        }
+        return src;
+    }
+
+    void encode_vertex_chunk(const uint8_t *vertices, size_t count, uint32_t stride, std::vector<uint8_t> &out)
+    {
+        const uint32_t lanes = stride / 4;
+        const size_t padded = padded_count(count);
+        std::vector<uint8_t> planes(size_t(lanes) * 4 * padded, 0);
+        for(uint32_t lane = 0; lane < lanes; ++lane)
+        {
+            uint32_t previous = 0;
+            for(size_t i = 0; i < count; ++i)
+            {
+                uint32_t value;
+                std::memcpy(&value, vertices + i * stride + lane * 4, 4);
+                //neighbouring vertices are close, so are the bit patterns of their floats
+                const uint32_t delta = zigzag(value - previous);
+                previous = value;
+                for(uint32_t b = 0; b < 4; ++b)
+                    planes[(size_t(lane) * 4 + b) * padded + i] = uint8_t(delta >> (b * 8));
+            }
+        }
+        for(size_t plane = 0; plane < size_t(lanes) * 4; ++plane)
+            encode_plane(planes.data() + plane * padded, padded, out);
+    }
+
+    void decode_vertex_chunk(const uint8_t *src, const uint8_t *end, uint8_t *dst, size_t count, uint32_t stride,
+                             std::vector<uint8_t> &scratch)
+    {
+        const uint32_t lanes = stride / 4;
+        const size_t padded = padded_count(count);
+        scratch.resize(size_t(lanes) * 4 * padded);
+        for(size_t plane = 0; plane < size_t(lanes) * 4; ++plane)
+            src = decode_plane(src, end, scratch.data() + plane * padded, padded);
+
+        for(uint32_t lane = 0; lane < lanes; ++lane)
+        {
+            const uint8_t *p0 = scratch.data() + (size_t(lane) * 4 + 0) * padded;
+            const uint8_t *p1 = p0 + padded, *p2 = p1 + padded, *p3 = p2 + padded;
+            uint8_t *out = dst + lane * 4;
+            uint32_t value = 0;
+            for(size_t i = 0; i < count; ++i)
+            {
+                value += unzigzag(uint32_t(p0[i]) | uint32_t(p1[i]) << 8 | uint32_t(p2[i]) << 16 | uint32_t(p3[i]) << 24);
+                std::memcpy(out + i * stride, &value, 4);
+            }
+        }
+    }
+
+    void encode_index_chunk(const uint32_t *indices, size_t count, std::vector<uint8_t> &out)
+    {
+        uint32_t previous = 0;
+        for(size_t i = 0; i < count; ++i)
+        {
+            //triangles of optimized meshes use nearby vertices: mostly 1 byte per index
+            uint32_t value = zigzag(indices[i] - previous);
+            previous = indices[i];
+            while(value >= 0x80)
+            {
+                out.push_back(uint8_t(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(uint8_t(value));
+        }
+    }
+
+    void decode_index_chunk(const uint8_t *src, const uint8_t *end, uint8_t *dst, size_t count)
+    {
+        uint32_t previous = 0;
+        for(size_t i = 0; i < count; ++i)
+        {
+            uint32_t value = 0;
+            for(uint32_t shift = 0; ; shift += 7)
+            {
+                if(src == end || shift > 28)
+                    fail_decode();
+                const uint8_t byte = *src++;
+                value |= uint32_t(byte & 0x7F) << shift;
+                if(byte < 0x80)
+                    break;
+            }
+            previous += unzigzag(value);
+            std::memcpy(dst + i * 4, &previous, 4);
+        }
+    }
+
+    //header + chunk table, then chunk data from encode_chunk(first element, count, out)
+    template<typename EncodeChunk>
+    std::vector<uint8_t> encode_stream(uint32_t kind, size_t count, uint32_t element_size, uint32_t per_chunk,
+                                       const EncodeChunk &encode_chunk)
+    {
+        const size_t chunk_count = (count + per_chunk - 1) / per_chunk;
+        StreamHeader header{kind, static_cast<uint32_t>(chunk_count), element_size, 0, uint64_t(count) * element_size};
+        std::vector<ChunkRecord> chunks(chunk_count);
+        const size_t data_offset = sizeof(StreamHeader) + chunk_count * sizeof(ChunkRecord);
+
+        std::vector<uint8_t> out(data_offset);
+        for(size_t c = 0; c < chunk_count; ++c)
+        {
+            const size_t first = c * per_chunk;
+            const size_t elements = std::min<size_t>(per_chunk, count - first);
+            chunks[c].offset = out.size();
+            chunks[c].decoded_offset = uint64_t(first) * element_size;
+            chunks[c].element_count = elements;
+            encode_chunk(first, elements, out);
+            chunks[c].size = out.size() - chunks[c].offset;
+        }
+        std::memcpy(out.data(), &header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), chunks.data(), chunks.size() * sizeof(ChunkRecord));
+        return out;
+    }
+
+    StreamHeader read_header(std::span<const uint8_t> stream)
+    {
+        StreamHeader header;
+        std::memcpy(&header, stream.data(), sizeof(header));
+        return header;
+    }
+
+    ChunkRecord read_chunk(std::span<const uint8_t> stream, size_t chunk)
+    {
+        ChunkRecord record;
+        std::memcpy(&record, stream.data() + sizeof(StreamHeader) + chunk * sizeof(ChunkRecord), sizeof(record));
+        return record;
+    }
+}
+
+std::vector<uint8_t> encode_vertices(const uint8_t *vertices, size_t vertex_count, uint32_t stride)
+{
+    if(stride == 0 || stride % 4 != 0)
+        throw std::runtime_error("Failed to encode vertices: stride has to be a multiple of 4!");
+
+    return encode_stream(VERTEX_STREAM, vertex_count, stride, VERTICES_PER_CHUNK,
+        [&](size_t first, size_t count, std::vector<uint8_t> &out)
+        {
+            encode_vertex_chunk(vertices + first * stride, count, stride, out);
+        });
+}
+
+std::vector<uint8_t> encode_indices(const uint32_t *indices, size_t index_count)
+{
+    return encode_stream(INDEX_STREAM, index_count, sizeof(uint32_t), INDICES_PER_CHUNK,
+        [&](size_t first, size_t count, std::vector<uint8_t> &out)
+        {
+            encode_index_chunk(indices + first, count, out);
+        });
+}
+
+bool check_encoded_stream(std::span<const uint8_t> stream, uint32_t kind, std::string &error)
+{
+    if(stream.size() < sizeof(StreamHeader))
+    {
+        error = "codec stream is too small";
+        return false;
+    }
+    const StreamHeader header = read_header(stream);
+    const uint32_t per_chunk = kind == VERTEX_STREAM ? VERTICES_PER_CHUNK : INDICES_PER_CHUNK;
+    if(header.kind != kind || header.element_size == 0 || header.element_size % 4 != 0
+       || (kind == INDEX_STREAM && header.element_size != sizeof(uint32_t)))
+    {
+        error = "unknown codec stream";
+        return false;
+    }
+    const uint64_t data_offset = sizeof(StreamHeader) + uint64_t(header.chunk_count) * sizeof(ChunkRecord);
+    if(data_offset > stream.size())
+    {
+        error = "codec chunk table out of the stream";
+        return false;
+    }
+
+    //chunks follow each other in the decoded blob and cover all of it
+    uint64_t decoded = 0;
+    for(size_t c = 0; c < header.chunk_count; ++c)
+    {
+        const ChunkRecord chunk = read_chunk(stream, c);
+        if(chunk.offset < data_offset || chunk.offset > stream.size() || chunk.size > stream.size() - chunk.offset
+           || chunk.decoded_offset != decoded || chunk.element_count == 0 || chunk.element_count > per_chunk)
+        {
+            error = "codec chunk out of range";
+            return false;
+        }
+        decoded += chunk.element_count * header.element_size;
+    }
+    if(decoded != header.decoded_size)
+    {
+        error = "codec chunks don`t add up to the decoded size";
+        return false;
+    }
+    return true;
+}
+
+uint64_t get_decoded_size(std::span<const uint8_t> stream)
+{
+    return read_header(stream).decoded_size;
+}
+
+void decode_stream(std::span<const uint8_t> stream, uint8_t *dst, uint64_t first_byte, uint64_t byte_count,
+                   uint32_t thread_count)
+{
+    const StreamHeader header = read_header(stream);
+    const uint64_t window_end = first_byte + byte_count;
+
+    //chunks that touch the window
+    std::vector<ChunkRecord> chunks;
+    for(size_t c = 0; c < header.chunk_count; ++c)
+    {
+        const ChunkRecord chunk = read_chunk(stream, c);
+        const uint64_t chunk_end = chunk.decoded_offset + chunk.element_count * header.element_size;
+        if(chunk_end > first_byte && chunk.decoded_offset < window_end)
+            chunks.push_back(chunk);
+    }
+
+    std::atomic<size_t> next_chunk = 0;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto worker = [&]()
+    {
+        //planes of a vertex chunk, chunk that is only partly in the window
+        std::vector<uint8_t> scratch, partial;
+        try
+        {
+            for(size_t i = next_chunk++; i < chunks.size(); i = next_chunk++)
+            {
+                const ChunkRecord &chunk = chunks[i];
+                const uint64_t chunk_size = chunk.element_count * header.element_size;
+                const bool inside = chunk.decoded_offset >= first_byte && chunk.decoded_offset + chunk_size <= window_end;
+                if(!inside)
+                    partial.resize(chunk_size);
+                uint8_t *out = inside ? dst + (chunk.decoded_offset - first_byte) : partial.data();
+
+                const uint8_t *src = stream.data() + chunk.offset;
+                if(header.kind == VERTEX_STREAM)
+                    decode_vertex_chunk(src, src + chunk.size, out, chunk.element_count, header.element_size, scratch);
+                else
+                    decode_index_chunk(src, src + chunk.size, out, chunk.element_count);
+
+                if(!inside)
+                {
+                    const uint64_t begin = std::max(first_byte, chunk.decoded_offset);
+                    const uint64_t end = std::min(window_end, chunk.decoded_offset + chunk_size);
+                    std::memcpy(dst + (begin - first_byte), partial.data() + (begin - chunk.decoded_offset), end - begin);
+                }
+            }
+        }
+        catch(...)
+        {
+            next_chunk = chunks.size();
+            std::lock_guard<std::mutex> lock(error_mutex);
+            error = std::current_exception();
+        }
+    };
+
+    if(thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < std::min<size_t>(thread_count, chunks.size()); ++i)
+        threads.emplace_back(worker);
+    worker();
+    for(std::thread &thread : threads)
+        thread.join();
+    if(error)
+        std::rethrow_exception(error);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+//Lossless codec of vertex and index blobs (mesh file compression)
+//streams are split into independent chunks, so they decode in parallel and into any window of the output
+//vertices: per 32 bit lane delta to the previous vertex, zigzag, split to byte planes,
+//          planes packed in groups of 16 bytes with 0/2/4/8 bits per byte
+//indices:  delta to the previous index, zigzag, LEB128 varint
+namespace geometry_codec
+{
+    constexpr uint32_t VERTEX_STREAM = 0x31585456; //"VTX1"
+    constexpr uint32_t INDEX_STREAM = 0x31584449; //"IDX1"
+    //elements per chunk (indices: a multiple of 3, chunks hold whole triangles)
+    constexpr uint32_t VERTICES_PER_CHUNK = 8192;
+    constexpr uint32_t INDICES_PER_CHUNK = 3 * 8192;
+
+    //stream layout: StreamHeader, chunk_count ChunkRecords, chunk data
+    struct StreamHeader
+    {
+        uint32_t kind;
+        uint32_t chunk_count;
+        //bytes of an element: vertex stride, 4 for indices
+        uint32_t element_size;
+        uint32_t reserved;
+        uint64_t decoded_size;
+    };
+    static_assert(sizeof(StreamHeader) == 24, "codec stream header layout");
+
+    struct ChunkRecord
+    {
+        //data of the chunk, from the start of the stream
+        uint64_t offset;
+        uint64_t size;
+        //where it goes in the decoded blob
+        uint64_t decoded_offset;
+        uint64_t element_count;
+    };
+    static_assert(sizeof(ChunkRecord) == 32, "codec chunk record layout");
+}
+
+//stride has to be a multiple of 4 (vertices are coded as 32 bit lanes)
+std::vector<uint8_t> encode_vertices(const uint8_t *vertices, size_t vertex_count, uint32_t stride);
+std::vector<uint8_t> encode_indices(const uint32_t *indices, size_t index_count);
+
+//checks the header and the chunk table, false with a reason otherwise
+bool check_encoded_stream(std::span<const uint8_t> stream, uint32_t kind, std::string &error);
+//decoded size of a checked stream
+uint64_t get_decoded_size(std::span<const uint8_t> stream);
+
+//decodes bytes [first_byte, first_byte + byte_count) of the decoded blob to dst
+//chunks in the window are decoded by thread_count threads (0 -- all cores), chunks inside it straight to dst
+//throws if chunk data is broken
+void decode_stream(std::span<const uint8_t> stream, uint8_t *dst, uint64_t first_byte, uint64_t byte_count,
+                   uint32_t thread_count = 0);
@@ -0,0 +1,95 @@
+#include "hash_utils.h"
+
+#include <cstring>
+
+namespace
+{
+    constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t PRIME_5 = 0x27D4EB2F165667C5ull;
+
+    inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    //unaligned little endian reads
+    inline uint64_t read64(const uint8_t *p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+    inline uint32_t read32(const uint8_t *p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+
+    inline uint64_t round(uint64_t acc, uint64_t lane)
+    {
+        acc += lane * PRIME_2;
+        acc = rotl(acc, 31);
+        return acc * PRIME_1;
+    }
+
+    inline uint64_t merge_round(uint64_t acc, uint64_t val)
+    {
+        acc ^= round(0, val);
+        return acc * PRIME_1 + PRIME_4;
+    }
+}
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    const uint8_t *end = p + size;
+    uint64_t hash;
+
+    if(size >= 32)
+    {
+        //4 independent lanes, 32 bytes per step
+        uint64_t v1 = seed + PRIME_1 + PRIME_2;
+        uint64_t v2 = seed + PRIME_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME_1;
+
+        const uint8_t *limit = end - 32;
+        do
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while(p <= limit);
+
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    }
+    else
+    {
+        hash = seed + PRIME_5;
+    }
+
+    hash += static_cast<uint64_t>(size);
+
+    //tail
+    for(; p + 8 <= end; p += 8)
+    {
+        hash ^= round(0, read64(p));
+        hash = rotl(hash, 27) * PRIME_1 + PRIME_4;
+    }
+    if(p + 4 <= end)
+    {
+        hash ^= uint64_t(read32(p)) * PRIME_1;
+        hash = rotl(hash, 23) * PRIME_2 + PRIME_3;
+        p += 4;
+    }
+    for(; p < end; ++p)
+    {
+        hash ^= (*p) * PRIME_5;
+        hash = rotl(hash, 11) * PRIME_1;
+    }
+
+    //avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//Fast non-cryptographic hashing (XXH64) for caches and content deduplication
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0);
+
+//fold one more value into a running hash (e.g. fields of a cache key)
+inline uint64_t hash_combine(uint64_t hash, uint64_t value)
+{
+    //boost style mixing widened to 64 bits
+    return hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 12) + (hash >> 4));
+}
+
+template<typename T>
+inline uint64_t hash_value(const T &value, uint64_t seed = 0)
+{
+    return hash_bytes(&value, sizeof(T), seed);
+}
@@ -0,0 +1,149 @@
+#include "image_file.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace
+{
+    bool decode_tga(const uint8_t *data, size_t size, ImageData &image)
+    {
+        constexpr size_t HEADER_SIZE = 18;
+        if(size < HEADER_SIZE)
+            return false;
+
+        const uint8_t id_length = data[0];
+        const uint8_t color_map_type = data[1];
+        const uint8_t image_type = data[2];
+        const uint32_t width = data[12] | (data[13] << 8);
+        const uint32_t height = data[14] | (data[15] << 8);
+        const uint8_t bits_per_pixel = data[16];
+        //bit 5 -- first row is the top one
+        const bool top_left_origin = (data[17] & 0x20) != 0;
+
+        //2 / 10 -- true colour raw / RLE, 3 / 11 -- grayscale raw / RLE, palettes are not supported
+        const bool rle = image_type == 10 || image_type == 11;
+        const bool grayscale = image_type == 3 || image_type == 11;
+        if(color_map_type != 0 || (image_type != 2 && image_type != 3 && !rle))
+            return false;
+        const uint32_t bytes_per_pixel = bits_per_pixel / 8;
+        if(grayscale ? bits_per_pixel != 8 : (bits_per_pixel != 24 && bits_per_pixel != 32))
+            return false;
+        if(width == 0 || height == 0)
+            return false;
+
+        const uint8_t *p = data + HEADER_SIZE + id_length;
+        const uint8_t *end = data + size;
+        const size_t pixel_count = size_t(width) * height;
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(pixel_count * 4);
+
+        //BGR(A) or gray -> RGBA
+        auto write_pixel = [&](size_t index, const uint8_t *src)
+        {
+            //file rows go bottom to top unless the origin bit says otherwise
+            const size_t x = index % width;
+            const size_t y = top_left_origin ? index / width : height - 1 - index / width;
+            uint8_t *dst = &image.pixels[(y * width + x) * 4];
+            if(grayscale)
+            {
+                dst[0] = dst[1] = dst[2] = src[0];
+                dst[3] = 255;
+            }
+            else
+            {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = bytes_per_pixel == 4 ? src[3] : 255;
+            }
+        };
+
+        size_t index = 0;
+        while(index < pixel_count)
+        {
+            //RLE packet: header byte, high bit -- one value repeated, otherwise raw values
+            size_t count = 1;
+            bool repeated = false;
+            if(rle)
+            {
+                if(p >= end)
+                    return false;
+                repeated = (*p & 0x80) != 0;
+                count = (*p & 0x7F) + 1;
+                ++p;
+            }
+            else
+            {
+                count = pixel_count;
+            }
+            if(count > pixel_count - index)
+                return false;
+
+            const size_t packet_bytes = repeated ? bytes_per_pixel : count * bytes_per_pixel;
+            if(size_t(end - p) < packet_bytes)
+                return false;
+            for(size_t i = 0; i < count; ++i)
+                write_pixel(index++, repeated ? p : p + i * bytes_per_pixel);
+            p += packet_bytes;
+        }
+        return true;
+    }
+
+    //number after whitespace and # comments
+    bool read_ppm_value(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+    {
+        while(p < end && (std::isspace(*p) || *p == '#'))
+        {
+            if(*p == '#')
+                while(p < end && *p != '\n')
+                    ++p;
+            else
+                ++p;
+        }
+        if(p == end || !std::isdigit(*p))
+            return false;
+
+        uint64_t result = 0;
+        while(p < end && std::isdigit(*p) && result <= UINT32_MAX)
+            result = result * 10 + (*p++ - '0');
+        value = uint32_t(result);
+        return result <= UINT32_MAX;
+    }
+
+    bool decode_ppm(const uint8_t *data, size_t size, ImageData &image)
+    {
+        const uint8_t *p = data + 2;
+        const uint8_t *end = data + size;
+        uint32_t width = 0, height = 0, max_value = 0;
+        if(!read_ppm_value(p, end, width) || !read_ppm_value(p, end, height) || !read_ppm_value(p, end, max_value))
+            return false;
+        //8 bit samples only, one whitespace before the pixels
+        if(width == 0 || height == 0 || max_value == 0 || max_value > 255 || p == end || !std::isspace(*p))
+            return false;
+        ++p;
+
+        const size_t pixel_count = size_t(width) * height;
+        if(size_t(end - p) < pixel_count * 3)
+            return false;
+
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(pixel_count * 4);
+        for(size_t i = 0; i < pixel_count; ++i)
+        {
+            for(size_t c = 0; c < 3; ++c)
+                image.pixels[i * 4 + c] = uint8_t(uint32_t(p[i * 3 + c]) * 255 / max_value);
+            image.pixels[i * 4 + 3] = 255;
+        }
+        return true;
+    }
+}
+
+bool decode_image(const uint8_t *data, size_t size, ImageData &image)
+{
+    //PPM has a magic number, TGA doesn`t (its header is validated instead)
+    if(size >= 2 && data[0] == 'P' && data[1] == '6')
+        return decode_ppm(data, size, image);
+    return decode_tga(data, size, image);
+}
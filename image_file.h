@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//8 bit RGBA pixels, rows top to bottom
+struct ImageData
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+//Decoders of simple uncompressed image files (no external image library):
+//TGA (true colour / grayscale, raw or RLE) and binary PPM (P6)
+//false if the format is not one of them or the data is broken
+bool decode_image(const uint8_t *data, size_t size, ImageData &image);
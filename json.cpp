@@ -0,0 +1,247 @@
+#include "json.h"
+
+#include <charconv>
+#include <stdexcept>
+
+namespace
+{
+    const JsonValue NULL_VALUE;
+    //nesting limit, so broken files can`t overflow the stack
+    constexpr uint32_t MAX_DEPTH = 256;
+}
+
+//recursive descent, errors are thrown inside and turned into the bool + message of parse_json
+class JsonParser
+{
+public:
+    explicit JsonParser(std::string_view text) : _text(text) {}
+
+    void parse_document(JsonValue &value)
+    {
+        parse_value(value, 0);
+        skip_whitespace();
+        if(_pos != _text.size())
+            fail("unexpected data after the value");
+    }
+
+    size_t get_position() const { return _pos; }
+
+private:
+    std::string_view _text;
+    size_t _pos = 0;
+
+    [[noreturn]] void fail(const char *message) { throw std::runtime_error(message); }
+
+    void skip_whitespace()
+    {
+        while(_pos < _text.size() && (_text[_pos] == ' ' || _text[_pos] == '\t' || _text[_pos] == '\n' || _text[_pos] == '\r'))
+            ++_pos;
+    }
+
+    bool consume(char c)
+    {
+        skip_whitespace();
+        if(_pos < _text.size() && _text[_pos] == c)
+        {
+            ++_pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect_literal(std::string_view literal)
+    {
+        if(_text.substr(_pos, literal.size()) != literal)
+            fail("unknown literal");
+        _pos += literal.size();
+    }
+
+    void parse_value(JsonValue &value, uint32_t depth)
+    {
+        if(depth > MAX_DEPTH)
+            fail("nested too deep");
+
+        skip_whitespace();
+        if(_pos >= _text.size())
+            fail("unexpected end");
+
+        switch(_text[_pos])
+        {
+        case '{':
+            ++_pos;
+            value._type = JsonValue::Type::Object;
+            if(consume('}'))
+                return;
+            do
+            {
+                skip_whitespace();
+                std::string key;
+                parse_string(key);
+                if(!consume(':'))
+                    fail("expected ':'");
+                value._object.emplace_back(std::move(key), JsonValue());
+                parse_value(value._object.back().second, depth + 1);
+            } while(consume(','));
+            if(!consume('}'))
+                fail("expected '}'");
+            return;
+        case '[':
+            ++_pos;
+            value._type = JsonValue::Type::Array;
+            if(consume(']'))
+                return;
+            do
+            {
+                value._array.emplace_back();
+                parse_value(value._array.back(), depth + 1);
+            } while(consume(','));
+            if(!consume(']'))
+                fail("expected ']'");
+            return;
+        case '"':
+            value._type = JsonValue::Type::String;
+            parse_string(value._string);
+            return;
+        case 't':
+            expect_literal("true");
+            value._type = JsonValue::Type::Bool;
+            value._bool = true;
+            return;
+        case 'f':
+            expect_literal("false");
+            value._type = JsonValue::Type::Bool;
+            return;
+        case 'n':
+            expect_literal("null");
+            return;
+        default:
+        {
+            value._type = JsonValue::Type::Number;
+            const char *begin = _text.data() + _pos;
+            //from_chars doesn`t take the leading '+', JSON doesn`t allow it either
+            const auto [end, ec] = std::from_chars(begin, _text.data() + _text.size(), value._number);
+            if(ec != std::errc() || end == begin)
+                fail("bad number");
+            _pos += size_t(end - begin);
+            return;
+        }
+        }
+    }
+
+    uint32_t parse_hex4()
+    {
+        if(_pos + 4 > _text.size())
+            fail("bad \\u escape");
+        uint32_t code = 0;
+        const auto [end, ec] = std::from_chars(_text.data() + _pos, _text.data() + _pos + 4, code, 16);
+        if(ec != std::errc() || end != _text.data() + _pos + 4)
+            fail("bad \\u escape");
+        _pos += 4;
+        return code;
+    }
+
+    void append_utf8(std::string &out, uint32_t code)
+    {
+        if(code < 0x80)
+        {
+            out += char(code);
+        }
+        else if(code < 0x800)
+        {
+            out += char(0xC0 | (code >> 6));
+            out += char(0x80 | (code & 0x3F));
+        }
+        else if(code < 0x10000)
+        {
+            out += char(0xE0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += char(0xF0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3F));
+            out += char(0x80 | ((code >> 6) & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+    }
+
+    void parse_string(std::string &out)
+    {
+        if(_pos >= _text.size() || _text[_pos] != '"')
+            fail("expected a string");
+        ++_pos;
+
+        while(true)
+        {
+            //runs without escapes are appended at once
+            const size_t run_start = _pos;
+            while(_pos < _text.size() && _text[_pos] != '"' && _text[_pos] != '\\')
+                ++_pos;
+            out.append(_text.substr(run_start, _pos - run_start));
+            if(_pos >= _text.size())
+                fail("unterminated string");
+            if(_text[_pos++] == '"')
+                return;
+
+            if(_pos >= _text.size())
+                fail("unterminated string");
+            switch(_text[_pos++])
+            {
+            case '"':  out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/'; break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u':
+            {
+                uint32_t code = parse_hex4();
+                //surrogate pair
+                if(code >= 0xD800 && code < 0xDC00 && _text.substr(_pos, 2) == "\\u")
+                {
+                    _pos += 2;
+                    const uint32_t low = parse_hex4();
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                fail("bad escape");
+            }
+        }
+    }
+};
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+    return _type == Type::Array && index < _array.size() ? _array[index] : NULL_VALUE;
+}
+
+const JsonValue& JsonValue::operator[](std::string_view key) const
+{
+    if(_type == Type::Object)
+        for(const auto &[name, value] : _object)
+            if(name == key)
+                return value;
+    return NULL_VALUE;
+}
+
+bool parse_json(std::string_view text, JsonValue &value, std::string &error)
+{
+    JsonParser parser(text);
+    try
+    {
+        value = JsonValue();
+        parser.parse_document(value);
+    }
+    catch(const std::runtime_error &e)
+    {
+        error = std::string(e.what()) + " at byte " + std::to_string(parser.get_position());
+        return false;
+    }
+    return true;
+}
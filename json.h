@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//Small JSON DOM for asset files (glTF), no external library
+//objects keep member order, lookups are linear (asset objects have a handful of members)
+class JsonValue
+{
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type get_type() const { return _type; }
+    bool is_null() const { return _type == Type::Null; }
+    bool is_number() const { return _type == Type::Number; }
+    bool is_string() const { return _type == Type::String; }
+    bool is_array() const { return _type == Type::Array; }
+    bool is_object() const { return _type == Type::Object; }
+
+    //fallback if the value has another type
+    bool as_bool(bool fallback = false) const { return _type == Type::Bool ? _bool : fallback; }
+    double as_number(double fallback = 0.0) const { return _type == Type::Number ? _number : fallback; }
+    uint64_t as_uint(uint64_t fallback = 0) const { return _type == Type::Number && _number >= 0.0 ? uint64_t(_number) : fallback; }
+    const std::string& as_string() const { return _string; }
+
+    //elements of an array (empty for other types)
+    const std::vector<JsonValue>& get_array() const { return _array; }
+    size_t size() const { return _type == Type::Array ? _array.size() : _object.size(); }
+    const JsonValue& operator[](size_t index) const;
+
+    //member of an object, null value if there is none
+    const JsonValue& operator[](std::string_view key) const;
+    bool contains(std::string_view key) const { return !(*this)[key].is_null(); }
+    const std::vector<std::pair<std::string, JsonValue>>& get_members() const { return _object; }
+
+private:
+    friend class JsonParser;
+
+    Type _type = Type::Null;
+    bool _bool = false;
+    double _number = 0.0;
+    std::string _string;
+    std::vector<JsonValue> _array;
+    std::vector<std::pair<std::string, JsonValue>> _object;
+};
+
+//false with a reason (and the byte offset) for malformed text
+bool parse_json(std::string_view text, JsonValue &value, std::string &error);
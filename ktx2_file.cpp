@@ -0,0 +1,104 @@
+#include "ktx2_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+    //file layout (little endian): identifier, header, index, level index
+    struct Header
+    {
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+        //index: data format descriptor, key/value data, supercompression global data
+        uint32_t dfd_byte_offset;
+        uint32_t dfd_byte_length;
+        uint32_t kvd_byte_offset;
+        uint32_t kvd_byte_length;
+    };
+    //+ sgdByteOffset, sgdByteLength (uint64 each, unused)
+    constexpr size_t HEADER_SIZE = sizeof(Header) + 2 * sizeof(uint64_t);
+    static_assert(sizeof(Header) == 52, "KTX2 header + index without the 64 bit fields");
+
+    struct LevelIndex
+    {
+        uint64_t byte_offset;
+        uint64_t byte_length;
+        uint64_t uncompressed_byte_length;
+    };
+}
+
+bool is_ktx2(const uint8_t *data, size_t size)
+{
+    return size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+bool parse_ktx2(const uint8_t *data, size_t size, Ktx2Image &image, std::string &error)
+{
+    if(!is_ktx2(data, size) || size < sizeof(KTX2_IDENTIFIER) + HEADER_SIZE)
+    {
+        error = "not a KTX2 file";
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+    if(header.vk_format == 0)
+    {
+        error = "Basis Universal / unknown format (needs a transcoder)";
+        return false;
+    }
+    if(header.supercompression_scheme != 0)
+    {
+        error = "supercompressed level data";
+        return false;
+    }
+    if(header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1
+       || header.layer_count > 1 || header.face_count != 1)
+    {
+        error = "only 2D images are supported";
+        return false;
+    }
+
+    //0 -- level 0 only, the loader generates the rest (generate_mips)
+    const uint32_t level_count = std::max(header.level_count, 1u);
+    const size_t level_index_offset = sizeof(KTX2_IDENTIFIER) + HEADER_SIZE;
+    if(level_count > 32 || size < level_index_offset + level_count * sizeof(LevelIndex))
+    {
+        error = "broken level index";
+        return false;
+    }
+
+    image.vk_format = header.vk_format;
+    image.width = header.pixel_width;
+    image.height = header.pixel_height;
+    image.generate_mips = header.level_count == 0;
+    image.levels.clear();
+    for(uint32_t level = 0; level < level_count; ++level)
+    {
+        LevelIndex index;
+        std::memcpy(&index, data + level_index_offset + level * sizeof(LevelIndex), sizeof(index));
+        if(index.byte_offset > size || index.byte_length > size - index.byte_offset)
+        {
+            error = "level data out of the file";
+            return false;
+        }
+        image.levels.push_back(
+        {
+            .data = data + index.byte_offset,
+            .size = size_t(index.byte_length),
+            .width = std::max(header.pixel_width >> level, 1u),
+            .height = std::max(header.pixel_height >> level, 1u)
+        });
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//KTX2 container (Khronos texture), 2D images with their mip levels
+//level data points into the parsed memory (a mapped file), nothing is copied or decoded
+struct Ktx2Image
+{
+    struct Level
+    {
+        const uint8_t *data;
+        size_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    //VkFormat of the texel data
+    uint32_t vk_format = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    //largest first
+    std::vector<Level> levels;
+    //levelCount 0 in the file: only level 0 is there, the loader generates the rest
+    bool generate_mips = false;
+};
+
+bool is_ktx2(const uint8_t *data, size_t size);
+//false with a reason for broken files and for what isn`t supported:
+//Basis Universal (vkFormat UNDEFINED), supercompression, cube maps, arrays and 3D images
+bool parse_ktx2(const uint8_t *data, size_t size, Ktx2Image &image, std::string &error);
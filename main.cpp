@@ -4,10 +4,13 @@
 #include <glfw/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <bit>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "vulkan_renderer.h"
+#include "profiler.h"
 
 GLFWwindow *window = nullptr;
 VulkanRenderer vk_renderer;
@@ -32,24 +35,117 @@ void init_window(std::string w_name = "Please render something!", const int widt
     window = glfwCreateWindow(width, height, w_name.c_str(), nullptr, nullptr);
 }
 
-int main()
+//two quads, the second one see-through
+void add_quads()
 {
-    init_window();
+    //create a mesh
+    //vertex data
+    std::vector<Vertex> mesh_vertices =
+    {
+        {{-0.4,-0.2,0.0}, {1.,0.,0.}}, //0 shared
+        {{0.0,0.6,0.0}, {1.,0.,0.}}, //1 shared
+        {{-0.8,0.2,0.0}, {1.,1.,0.}}, //2
+        {{-0.8,-0.2,0.0}, {1.,1.,0.}}, //3
+    };
+    std::vector<Vertex> mesh_vertices2 =
+    {
+        {{0.4,0.2,0.0}, {0.,1.,0.}}, //0 shared
+        {{0.0,-0.6,0.0}, {0.,1.,0.}}, //1 shared
+        {{0.8,-0.2,0.0}, {0.,1.,0.}}, //2
+        {{0.8,0.2,0.0}, {1.,1.,0.}}, //3
+    };
+    //index data
+    std::vector<uint32_t> mesh_indices =
+    {
+        0, 1, 2,
+        2, 3, 0
+    };
+    const uint32_t first_quad = vk_renderer.add_mesh(mesh_vertices, mesh_indices);
+    const uint32_t second_quad = vk_renderer.add_mesh(mesh_vertices2, mesh_indices);
+
+    //second quad is see-through: own pipeline variant with ALPHA specialization constant
+    //(opaque default pipeline draws it until the variant is compiled)
+    PipelineDesc translucent = vk_renderer.get_default_pipeline_desc();
+    translucent.name = "translucent";
+    translucent.transparent = true;
+    translucent.blend = true;
+    //transparent meshes don`t hide each other, the back-to-front queue orders them
+    translucent.depth_write = false;
+    translucent.specialization.push_back(std::bit_cast<uint32_t>(0.6f));
+    vk_renderer.set_mesh_pipeline(second_quad, vk_renderer.add_pipeline_variant(translucent));
+
+    //first quad takes its tint from a material in the bindless heap
+    if(vk_renderer.get_bindless_heap())
+    {
+        PipelineDesc bindless = vk_renderer.get_default_pipeline_desc();
+        bindless.name = "bindless material";
+        bindless.fragment_shader = "shaders/frag_bindless.spv";
+        vk_renderer.set_mesh_draw_handles(first_quad, vk_renderer.add_material({0.5f, 0.8f, 1.f, 1.f}));
+        vk_renderer.set_mesh_pipeline(first_quad, vk_renderer.add_pipeline_variant(bindless));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    //--headless renders into offscreen images without a window (e.g. CI with a software Vulkan driver)
+    //--asset file.gltf|.glb|.obj shows the meshes of the file instead of the two quads
+    //(.vmsh mesh cache files are streamed: the first frames show up before the geometry is loaded)
+    bool headless = false;
+    std::string asset_path;
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--headless")
+            headless = true;
+        else if(arg == "--asset" && i + 1 < argc)
+            asset_path = argv[++i];
+    }
+    const uint32_t headless_frames = 600;
+
+    if(headless)
+    {
+        if(vk_renderer.init_headless(800, 600))
+            return EXIT_FAILURE;
+    }
+    else
+    {
+        init_window();
+
+        if(vk_renderer.init(window))
+            return EXIT_FAILURE;
+    }
 
-    if(vk_renderer.init(window))
-        return EXIT_FAILURE;
+    if(!asset_path.empty())
+    {
+        const bool streamed = asset_path.ends_with(".vmsh");
+        for(uint32_t model_id : streamed ? vk_renderer.stream_mesh_file(asset_path) : vk_renderer.import_asset(asset_path))
+            vk_renderer.updateModel(model_id, glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -3.f)));
+    }
+    else
+    {
+        add_quads();
+    }
 
     float angle = 0.f, delta_time = 0.f, last_time = 0.f;
+    uint32_t frame = 0;
 
-    while (!glfwWindowShouldClose(window))
+    while (headless ? frame++ < headless_frames : !glfwWindowShouldClose(window))
     {
         using namespace glm;
 
-        glfwPollEvents();
+        if(headless)
+        {
+            //fixed step, so headless runs are reproducible
+            delta_time = 1.f / 60.f;
+        }
+        else
+        {
+            glfwPollEvents();
 
-        float now = glfwGetTime();
-        delta_time = now - last_time;
-        last_time = now;
+            float now = glfwGetTime();
+            delta_time = now - last_time;
+            last_time = now;
+        }
 
         angle += 20.f * delta_time;
         if(angle > 360.f)
@@ -65,16 +161,26 @@ int main()
         scnd_model = glm::translate(scnd_model, vec3(0.f, 0.f, -2.9f));
         scnd_model = glm::rotate(scnd_model, glm::radians(-angle * 3), glm::vec3(0.f, 0.f, 1.f));
 
-        vk_renderer.updateModel(0, first_model);
-        vk_renderer.updateModel(1, scnd_model);
+        if(asset_path.empty())
+        {
+            vk_renderer.updateModel(0, first_model);
+            vk_renderer.updateModel(1, scnd_model);
+        }
 
         vk_renderer.draw();
     }
     
     vk_renderer.cleanup();
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+#if ENABLE_PROFILER
+    profiler::write_chrome_trace("frame_trace.json");
+#endif
+
+    if(!headless)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path, Access access)
+{
+#ifdef _WIN32
+    const DWORD access_flag = access == Access::Random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | access_flag, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed to open the file: " + path);
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to get the size of the file: " + path);
+    }
+    _size = static_cast<size_t>(file_size.QuadPart);
+    _opened = true;
+    if(_size > 0)
+    {
+        //mapping keeps the file alive, its handle isn`t needed anymore
+        _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(_mapping)
+            _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    CloseHandle(file);
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("Failed to open the file: " + path);
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Failed to get the size of the file: " + path);
+    }
+    _size = static_cast<size_t>(file_stat.st_size);
+    _opened = true;
+    if(_size > 0)
+    {
+        void *mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped != MAP_FAILED)
+        {
+            _data = static_cast<const uint8_t*>(mapped);
+            const int advice = access == Access::Random ? MADV_RANDOM
+                             : access == Access::WholeFile ? MADV_WILLNEED : MADV_SEQUENTIAL;
+            madvise(mapped, _size, advice);
+        }
+    }
+    //mapping keeps the file alive
+    ::close(fd);
+#endif
+    if(_size > 0 && !_data)
+        read_fallback(path);
+}
+
+void MappedFile::read_fallback(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    _copy = std::make_unique<Block[]>((_size + sizeof(Block) - 1) / sizeof(Block));
+    if(!file.read(reinterpret_cast<char*>(_copy.get()), std::streamsize(_size)))
+    {
+        close();
+        throw std::runtime_error("Failed to read the file: " + path);
+    }
+    _data = reinterpret_cast<const uint8_t*>(_copy.get());
+}
+
+MappedFile& MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if(this != &other)
+    {
+        close();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _opened = std::exchange(other._opened, false);
+        _copy = std::move(other._copy);
+#ifdef _WIN32
+        _mapping = std::exchange(other._mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::close()
+{
+    if(_copy)
+        _copy.reset();
+#ifdef _WIN32
+    else if(_data)
+        UnmapViewOfFile(_data);
+    if(_mapping)
+        CloseHandle(_mapping);
+    _mapping = nullptr;
+#else
+    else if(_data)
+        munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+    _data = nullptr;
+    _size = 0;
+    _opened = false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+//Read-only memory mapping of a whole file
+//pages are read by the OS on first touch, nothing is copied into a heap buffer
+//files that can`t be mapped (e.g. on some network or virtual file systems) are read into memory instead
+//either way data() is at least 16 byte aligned
+class MappedFile
+{
+public:
+    //how the file is going to be read (hint for the OS read-ahead)
+    enum class Access
+    {
+        //front to back, once (decoders, parsers)
+        Sequential,
+        //scattered ranges (e.g. meshes of a file in priority order)
+        Random,
+        //all of it right away (small files: shaders) -- read ahead of the first touch
+        WholeFile
+    };
+
+    MappedFile() = default;
+    //throws if the file can`t be opened or read
+    explicit MappedFile(const std::string &path, Access access = Access::Sequential);
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile &&other) noexcept;
+
+    void close();
+
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool is_open() const { return _opened; }
+    //false -- the file was read into memory (mapping failed)
+    bool is_mapped() const { return _opened && !_copy; }
+
+    std::span<const uint8_t> bytes() const { return {_data, _size}; }
+    //whole file as elements of T (e.g. uint32_t SPIR-V words), throws if the size isn`t a multiple of T
+    template<typename T>
+    std::span<const T> as_span() const
+    {
+        static_assert(alignof(T) <= 16, "mapped data is only 16 byte aligned");
+        if(_size % sizeof(T) != 0)
+            throw std::runtime_error("File size isn`t a multiple of the element size!");
+        return {reinterpret_cast<const T*>(_data), _size / sizeof(T)};
+    }
+
+private:
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+    //empty files have nothing mapped, but are open
+    bool _opened = false;
+    //read fallback, blocks keep it aligned like a mapping for any T of as_span
+    struct alignas(16) Block { uint8_t bytes[16]; };
+    std::unique_ptr<Block[]> _copy;
+
+    void read_fallback(const std::string &path);
+#ifdef _WIN32
+    void *_mapping = nullptr;
+#endif
+};
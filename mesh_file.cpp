@@ -0,0 +1,358 @@
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "geometry_codec.h"
+
+using namespace mesh_file;
+
+namespace
+{
+    bool section_in_file(const Section &section, size_t file_size, size_t alignment)
+    {
+        return section.offset % alignment == 0 && section.offset <= file_size && section.size <= file_size - section.offset;
+    }
+
+    template<typename T>
+    std::span<const T> section_span(const uint8_t *data, const Section &section)
+    {
+        return {reinterpret_cast<const T*>(data + section.offset), size_t(section.size / sizeof(T))};
+    }
+
+    size_t align_up(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    const float* get_position(const MeshFileSource &mesh, uint32_t vertex_stride, uint32_t vertex)
+    {
+        return reinterpret_cast<const float*>(mesh.vertices.data() + size_t(vertex) * vertex_stride);
+    }
+
+    //center of the bounding box, radius to the farthest vertex
+    template<typename Vertices>
+    void bounding_sphere(const MeshFileSource &mesh, uint32_t vertex_stride, const Vertices &vertices,
+                         float bounds_min[3], float bounds_max[3], float sphere[4])
+    {
+        for(int c = 0; c < 3; ++c)
+        {
+            bounds_min[c] = INFINITY;
+            bounds_max[c] = -INFINITY;
+        }
+        for(uint32_t v : vertices)
+        {
+            const float *position = get_position(mesh, vertex_stride, v);
+            for(int c = 0; c < 3; ++c)
+            {
+                bounds_min[c] = std::min(bounds_min[c], position[c]);
+                bounds_max[c] = std::max(bounds_max[c], position[c]);
+            }
+        }
+
+        float radius = 0.f;
+        for(int c = 0; c < 3; ++c)
+            sphere[c] = (bounds_min[c] + bounds_max[c]) * 0.5f;
+        for(uint32_t v : vertices)
+        {
+            const float *position = get_position(mesh, vertex_stride, v);
+            const float dx = position[0] - sphere[0], dy = position[1] - sphere[1], dz = position[2] - sphere[2];
+            radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+        }
+        sphere[3] = std::sqrt(radius);
+    }
+
+    //consecutive triangles go to one meshlet until a limit is hit (index order is the locality)
+    void build_meshlets(const MeshFileSource &mesh, uint32_t vertex_stride, std::span<const uint32_t> indices,
+                        std::vector<MeshletRecord> &meshlets, std::vector<uint32_t> &meshlet_vertices,
+                        std::vector<uint8_t> &meshlet_triangles)
+    {
+        const uint32_t vertex_count = static_cast<uint32_t>(mesh.vertices.size() / vertex_stride);
+        //mesh vertex -> meshlet vertex, UINT32_MAX if not in the current meshlet
+        std::vector<uint32_t> local(vertex_count, UINT32_MAX);
+        MeshletRecord meshlet{};
+        meshlet.vertex_offset = static_cast<uint32_t>(meshlet_vertices.size());
+        meshlet.triangle_offset = static_cast<uint32_t>(meshlet_triangles.size());
+
+        auto flush = [&]()
+        {
+            if(meshlet.triangle_count == 0)
+                return;
+            std::span<const uint32_t> used(meshlet_vertices.data() + meshlet.vertex_offset, meshlet.vertex_count);
+            float bounds_min[3], bounds_max[3];
+            bounding_sphere(mesh, vertex_stride, used, bounds_min, bounds_max, meshlet.sphere);
+            for(uint32_t v : used)
+                local[v] = UINT32_MAX;
+            meshlets.push_back(meshlet);
+
+            meshlet = {};
+            meshlet.vertex_offset = static_cast<uint32_t>(meshlet_vertices.size());
+            meshlet.triangle_offset = static_cast<uint32_t>(meshlet_triangles.size());
+        };
+
+        for(size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            uint32_t new_vertices = 0;
+            for(size_t k = 0; k < 3; ++k)
+                new_vertices += local[indices[i + k]] == UINT32_MAX;
+            if(meshlet.vertex_count + new_vertices > MAX_MESHLET_VERTICES || meshlet.triangle_count == MAX_MESHLET_TRIANGLES)
+                flush();
+
+            for(size_t k = 0; k < 3; ++k)
+            {
+                uint32_t &slot = local[indices[i + k]];
+                if(slot == UINT32_MAX)
+                {
+                    slot = meshlet.vertex_count++;
+                    meshlet_vertices.push_back(indices[i + k]);
+                }
+                meshlet_triangles.push_back(static_cast<uint8_t>(slot));
+            }
+            meshlet.triangle_count++;
+        }
+        flush();
+    }
+}
+
+bool is_mesh_file(const uint8_t *data, size_t size)
+{
+    return size >= sizeof(Header) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool parse_mesh_file(const uint8_t *data, size_t size, MeshFileView &view, std::string &error)
+{
+    if(!is_mesh_file(data, size))
+    {
+        error = "not a mesh file";
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if(header.version != VERSION)
+    {
+        error = "version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION) + " (rebuild the file)";
+        return false;
+    }
+
+    //records are read in place, so sections have to be aligned for them
+    const bool sections_valid =
+        section_in_file(header.meshes, size, alignof(MeshRecord)) &&
+        section_in_file(header.lods, size, alignof(LodRecord)) &&
+        section_in_file(header.meshlets, size, alignof(MeshletRecord)) &&
+        section_in_file(header.vertices, size, BLOB_ALIGNMENT) &&
+        section_in_file(header.indices, size, BLOB_ALIGNMENT) &&
+        section_in_file(header.meshlet_vertices, size, alignof(uint32_t)) &&
+        section_in_file(header.meshlet_triangles, size, 1);
+    if(!sections_valid
+       || header.meshes.size != uint64_t(header.mesh_count) * sizeof(MeshRecord)
+       || header.lods.size != uint64_t(header.lod_count) * sizeof(LodRecord)
+       || header.meshlets.size != uint64_t(header.meshlet_count) * sizeof(MeshletRecord)
+       || header.vertex_stride == 0 || header.meshlet_vertices.size % sizeof(uint32_t) != 0)
+    {
+        error = "broken section table";
+        return false;
+    }
+
+    view = {};
+    view.vertex_stride = header.vertex_stride;
+    view.compressed = (header.flags & FLAG_COMPRESSED) != 0;
+    view.meshes = section_span<MeshRecord>(data, header.meshes);
+    view.lods = section_span<LodRecord>(data, header.lods);
+    view.meshlets = section_span<MeshletRecord>(data, header.meshlets);
+    view.meshlet_vertices = section_span<uint32_t>(data, header.meshlet_vertices);
+    view.meshlet_triangles = section_span<uint8_t>(data, header.meshlet_triangles);
+    if(view.compressed)
+    {
+        view.vertex_stream = section_span<uint8_t>(data, header.vertices);
+        view.index_stream = section_span<uint8_t>(data, header.indices);
+        if(!check_encoded_stream(view.vertex_stream, geometry_codec::VERTEX_STREAM, error)
+           || !check_encoded_stream(view.index_stream, geometry_codec::INDEX_STREAM, error))
+            return false;
+        if(get_decoded_size(view.vertex_stream) % view.vertex_stride != 0)
+        {
+            error = "vertex stream doesn`t match the vertex stride";
+            return false;
+        }
+        view.vertex_count = get_decoded_size(view.vertex_stream) / view.vertex_stride;
+        view.index_count = get_decoded_size(view.index_stream) / sizeof(uint32_t);
+    }
+    else
+    {
+        if(header.vertices.size % header.vertex_stride != 0 || header.indices.size % sizeof(uint32_t) != 0)
+        {
+            error = "broken section table";
+            return false;
+        }
+        view.vertices = section_span<uint8_t>(data, header.vertices);
+        view.indices = section_span<uint32_t>(data, header.indices);
+        view.vertex_count = view.vertices.size() / view.vertex_stride;
+        view.index_count = view.indices.size();
+    }
+
+    //work per record, not per vertex
+    for(const MeshRecord &mesh : view.meshes)
+    {
+        if(uint64_t(mesh.vertex_offset) + mesh.vertex_count > view.vertex_count
+           || mesh.lod_count == 0 || uint64_t(mesh.first_lod) + mesh.lod_count > view.lods.size()
+           || uint64_t(mesh.first_meshlet) + mesh.meshlet_count > view.meshlets.size())
+        {
+            error = "mesh record out of range";
+            return false;
+        }
+    }
+    for(const LodRecord &lod : view.lods)
+    {
+        if(uint64_t(lod.first_index) + lod.index_count > view.index_count || lod.index_count % 3 != 0)
+        {
+            error = "LOD record out of range";
+            return false;
+        }
+    }
+    for(const MeshletRecord &meshlet : view.meshlets)
+    {
+        if(meshlet.vertex_count > MAX_MESHLET_VERTICES || meshlet.triangle_count > MAX_MESHLET_TRIANGLES
+           || uint64_t(meshlet.vertex_offset) + meshlet.vertex_count > view.meshlet_vertices.size()
+           || uint64_t(meshlet.triangle_offset) + meshlet.triangle_count * 3ull > view.meshlet_triangles.size())
+        {
+            error = "meshlet record out of range";
+            return false;
+        }
+    }
+    return true;
+}
+
+void write_mesh_file(const std::string &path, uint32_t vertex_stride, const std::vector<MeshFileSource> &meshes,
+                     bool compress)
+{
+    if(vertex_stride < 3 * sizeof(float))
+        throw std::runtime_error("Failed to write the mesh file " + path + ": vertex has no position");
+
+    std::vector<MeshRecord> mesh_records;
+    std::vector<LodRecord> lod_records;
+    std::vector<MeshletRecord> meshlet_records;
+    std::vector<uint32_t> meshlet_vertices;
+    std::vector<uint8_t> meshlet_triangles;
+    uint64_t vertex_bytes = 0, index_count = 0;
+
+    for(const MeshFileSource &mesh : meshes)
+    {
+        if(mesh.lods.empty() || mesh.vertices.size() % vertex_stride != 0)
+            throw std::runtime_error("Failed to write the mesh file " + path + ": mesh without LOD 0 or partial vertex");
+
+        MeshRecord record{};
+        record.vertex_offset = static_cast<uint32_t>(vertex_bytes / vertex_stride);
+        record.vertex_count = static_cast<uint32_t>(mesh.vertices.size() / vertex_stride);
+        record.first_lod = static_cast<uint32_t>(lod_records.size());
+        record.lod_count = static_cast<uint32_t>(mesh.lods.size());
+
+        std::vector<uint32_t> all_vertices(record.vertex_count);
+        for(uint32_t v = 0; v < record.vertex_count; ++v)
+            all_vertices[v] = v;
+        bounding_sphere(mesh, vertex_stride, all_vertices, record.bounds_min, record.bounds_max, record.sphere);
+
+        for(size_t lod = 0; lod < mesh.lods.size(); ++lod)
+        {
+            for(uint32_t index : mesh.lods[lod])
+                if(index >= record.vertex_count)
+                    throw std::runtime_error("Failed to write the mesh file " + path + ": index out of range");
+            lod_records.push_back(
+            {
+                .first_index = static_cast<uint32_t>(index_count),
+                .index_count = static_cast<uint32_t>(mesh.lods[lod].size() / 3 * 3),
+                .error = lod < mesh.lod_errors.size() ? mesh.lod_errors[lod] : 0.f,
+                .reserved = 0
+            });
+            index_count += lod_records.back().index_count;
+        }
+
+        record.first_meshlet = static_cast<uint32_t>(meshlet_records.size());
+        build_meshlets(mesh, vertex_stride, mesh.lods[0], meshlet_records, meshlet_vertices, meshlet_triangles);
+        record.meshlet_count = static_cast<uint32_t>(meshlet_records.size()) - record.first_meshlet;
+
+        mesh_records.push_back(record);
+        vertex_bytes += mesh.vertices.size();
+    }
+
+    //codec streams are made from the whole blobs
+    std::vector<uint8_t> vertex_stream, index_stream;
+    if(compress)
+    {
+        std::vector<uint8_t> vertices;
+        vertices.reserve(vertex_bytes);
+        std::vector<uint32_t> indices;
+        indices.reserve(index_count);
+        for(const MeshFileSource &mesh : meshes)
+        {
+            vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            for(std::span<const uint32_t> lod : mesh.lods)
+                indices.insert(indices.end(), lod.begin(), lod.begin() + lod.size() / 3 * 3);
+        }
+        vertex_stream = encode_vertices(vertices.data(), vertices.size() / vertex_stride, vertex_stride);
+        index_stream = encode_indices(indices.data(), indices.size());
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.flags = compress ? FLAG_COMPRESSED : 0;
+    header.version = VERSION;
+    header.vertex_stride = vertex_stride;
+    header.mesh_count = static_cast<uint32_t>(mesh_records.size());
+    header.lod_count = static_cast<uint32_t>(lod_records.size());
+    header.meshlet_count = static_cast<uint32_t>(meshlet_records.size());
+
+    //sections one after another, every one starts on BLOB_ALIGNMENT
+    size_t offset = sizeof(Header);
+    auto place = [&offset](Section &section, uint64_t size)
+    {
+        offset = align_up(offset, BLOB_ALIGNMENT);
+        section = {offset, size};
+        offset += size;
+    };
+    place(header.meshes, mesh_records.size() * sizeof(MeshRecord));
+    place(header.lods, lod_records.size() * sizeof(LodRecord));
+    place(header.meshlets, meshlet_records.size() * sizeof(MeshletRecord));
+    place(header.vertices, compress ? vertex_stream.size() : vertex_bytes);
+    place(header.indices, compress ? index_stream.size() : index_count * sizeof(uint32_t));
+    place(header.meshlet_vertices, meshlet_vertices.size() * sizeof(uint32_t));
+    place(header.meshlet_triangles, meshlet_triangles.size());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file.is_open())
+        throw std::runtime_error("Failed to open the file: " + path);
+
+    auto write_at = [&file](const Section &section, const void *data, size_t size)
+    {
+        //zero padding up to the section
+        static const char zeros[BLOB_ALIGNMENT] = {};
+        file.write(zeros, std::streamsize(section.offset - uint64_t(file.tellp())));
+        file.write(static_cast<const char*>(data), std::streamsize(size));
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_at(header.meshes, mesh_records.data(), header.meshes.size);
+    write_at(header.lods, lod_records.data(), header.lods.size);
+    write_at(header.meshlets, meshlet_records.data(), header.meshlets.size);
+    if(compress)
+    {
+        write_at(header.vertices, vertex_stream.data(), vertex_stream.size());
+        write_at(header.indices, index_stream.data(), index_stream.size());
+    }
+    else
+    {
+        write_at(header.vertices, nullptr, 0);
+        for(const MeshFileSource &mesh : meshes)
+            file.write(reinterpret_cast<const char*>(mesh.vertices.data()), std::streamsize(mesh.vertices.size()));
+        write_at(header.indices, nullptr, 0);
+        for(const MeshFileSource &mesh : meshes)
+            for(std::span<const uint32_t> lod : mesh.lods)
+                file.write(reinterpret_cast<const char*>(lod.data()), std::streamsize(lod.size() / 3 * 3 * sizeof(uint32_t)));
+    }
+    write_at(header.meshlet_vertices, meshlet_vertices.data(), header.meshlet_vertices.size);
+    write_at(header.meshlet_triangles, meshlet_triangles.data(), header.meshlet_triangles.size);
+
+    if(!file)
+        throw std::runtime_error("Failed to write the mesh file: " + path);
+}
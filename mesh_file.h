@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+//Binary mesh cache (.vmsh): geometry already in GPU layout, loaded from a mapped file without parsing
+//layout (little endian): MeshFileHeader, record tables, then 64 byte aligned blobs
+//blobs are copied to staging as they are, nothing is done per vertex or per index
+//(FLAG_COMPRESSED files have geometry_codec streams instead, decoded in parallel straight to staging)
+namespace mesh_file
+{
+    constexpr char MAGIC[4] = {'V', 'M', 'S', 'H'};
+    //bumped on every layout change, older files have to be rebuilt
+    constexpr uint32_t VERSION = 1;
+    constexpr size_t BLOB_ALIGNMENT = 64;
+    //meshlet limits (fit mesh shader workgroups and the 8 bit local indices)
+    constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+    constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+    //vertex and index sections are geometry_codec streams
+    constexpr uint32_t FLAG_COMPRESSED = 1;
+
+    struct Section
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        //sizeof the renderer`s Vertex the file was built for
+        uint32_t vertex_stride;
+        uint32_t mesh_count;
+        uint32_t lod_count;
+        uint32_t meshlet_count;
+        uint32_t flags;
+        uint32_t reserved;
+
+        Section meshes;
+        Section lods;
+        Section meshlets;
+        //vertex_stride bytes per vertex
+        Section vertices;
+        //uint32_t, relative to MeshRecord::vertex_offset
+        Section indices;
+        //(both are codec streams of that data with FLAG_COMPRESSED)
+        //uint32_t, mesh vertices used by meshlets (relative to MeshRecord::vertex_offset)
+        Section meshlet_vertices;
+        //3 uint8_t per triangle, into the vertices of their meshlet
+        Section meshlet_triangles;
+    };
+    static_assert(sizeof(Header) == 144, "mesh file header layout");
+
+    struct MeshRecord
+    {
+        float bounds_min[3];
+        float bounds_max[3];
+        //bounding sphere: center, radius
+        float sphere[4];
+        //first vertex in the vertex blob (vertexOffset of the draw) and count
+        uint32_t vertex_offset;
+        uint32_t vertex_count;
+        //LOD 0 is the full detail mesh, others have fewer triangles
+        uint32_t first_lod;
+        uint32_t lod_count;
+        //meshlets of LOD 0
+        uint32_t first_meshlet;
+        uint32_t meshlet_count;
+    };
+    static_assert(sizeof(MeshRecord) == 64, "mesh file record layout");
+
+    struct LodRecord
+    {
+        //range of the index blob
+        uint32_t first_index;
+        uint32_t index_count;
+        //object space distance error of the simplification, 0 for LOD 0
+        float error;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(LodRecord) == 16, "mesh file record layout");
+
+    struct MeshletRecord
+    {
+        //element offset into meshlet_vertices, byte offset into meshlet_triangles
+        uint32_t vertex_offset;
+        uint32_t triangle_offset;
+        uint32_t vertex_count;
+        uint32_t triangle_count;
+        //bounding sphere: center, radius
+        float sphere[4];
+    };
+    static_assert(sizeof(MeshletRecord) == 32, "mesh file record layout");
+}
+
+//mesh file seen through its memory: spans point into the mapped file
+struct MeshFileView
+{
+    uint32_t vertex_stride = 0;
+    uint64_t vertex_count = 0;
+    uint64_t index_count = 0;
+    //vertices and indices are empty, their codec streams are in vertex_stream and index_stream
+    bool compressed = false;
+    std::span<const uint8_t> vertex_stream;
+    std::span<const uint8_t> index_stream;
+    std::span<const mesh_file::MeshRecord> meshes;
+    std::span<const mesh_file::LodRecord> lods;
+    std::span<const mesh_file::MeshletRecord> meshlets;
+    std::span<const uint8_t> vertices;
+    std::span<const uint32_t> indices;
+    std::span<const uint32_t> meshlet_vertices;
+    std::span<const uint8_t> meshlet_triangles;
+};
+
+bool is_mesh_file(const uint8_t *data, size_t size);
+//checks the header and that all records stay inside their blobs, false with a reason otherwise
+//(index values aren`t checked, that would be work per index: files are trusted build output)
+bool parse_mesh_file(const uint8_t *data, size_t size, MeshFileView &view, std::string &error);
+
+//input of write_mesh_file
+struct MeshFileSource
+{
+    //vertex_stride bytes per vertex, position (3 floats) first
+    std::span<const uint8_t> vertices;
+    //LOD 0 first, then coarser index lists of the same vertices
+    std::vector<std::span<const uint32_t>> lods;
+    //simplification error of each LOD (missing ones are 0)
+    std::vector<float> lod_errors;
+};
+
+//builds bounds and meshlets of LOD 0 and writes the file, throws if it can`t be written
+//compress: vertices and indices through geometry_codec (smaller reads, decode costs CPU)
+void write_mesh_file(const std::string &path, uint32_t vertex_stride, const std::vector<MeshFileSource> &meshes,
+                     bool compress = false);
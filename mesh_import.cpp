@@ -0,0 +1,670 @@
+#include "mesh_import.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+#include "hash_utils.h"
+#include "json.h"
+#include "mapped_file.h"
+#include "profiler.h"
+
+namespace
+{
+    //identical vertices (every byte the same) share one index
+    class VertexDeduplicator
+    {
+    public:
+        explicit VertexDeduplicator(ImportedMesh &mesh, size_t expected_vertices) : _mesh(mesh)
+        {
+            _indices.reserve(expected_vertices);
+        }
+
+        uint32_t add(const Vertex &vertex)
+        {
+            const auto [it, inserted] = _indices.try_emplace(vertex, static_cast<uint32_t>(_mesh.vertices.size()));
+            if(inserted)
+                _mesh.vertices.push_back(vertex);
+            else
+                _duplicates++;
+            return it->second;
+        }
+
+        uint64_t get_duplicates() const { return _duplicates; }
+
+    private:
+        struct Hash
+        {
+            size_t operator()(const Vertex &v) const { return size_t(hash_value(v)); }
+        };
+        struct Equal
+        {
+            bool operator()(const Vertex &a, const Vertex &b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+        };
+
+        ImportedMesh &_mesh;
+        std::unordered_map<Vertex, uint32_t, Hash, Equal> _indices;
+        uint64_t _duplicates = 0;
+    };
+    static_assert(sizeof(Vertex) == 6 * sizeof(float), "Vertex is compared byte by byte, it can`t have padding");
+
+    //meshes converted by workers, handed to on_mesh on the calling thread in the order they finish
+    uint64_t convert_in_parallel(size_t mesh_count, uint32_t thread_count,
+                                 const std::function<ImportedMesh(size_t mesh, uint64_t &duplicates)> &convert,
+                                 const std::function<void(ImportedMesh &mesh)> &on_mesh)
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<ImportedMesh> done;
+        size_t finished = 0;
+        std::exception_ptr error;
+        std::atomic<size_t> next_mesh = 0;
+        std::atomic<uint64_t> duplicates = 0;
+
+        auto worker = [&]()
+        {
+            for(size_t i = next_mesh++; i < mesh_count; i = next_mesh++)
+            {
+                ImportedMesh mesh;
+                std::exception_ptr mesh_error;
+                try
+                {
+                    uint64_t mesh_duplicates = 0;
+                    mesh = convert(i, mesh_duplicates);
+                    duplicates += mesh_duplicates;
+                }
+                catch(...)
+                {
+                    mesh_error = std::current_exception();
+                    //others stop taking meshes
+                    next_mesh = mesh_count;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if(mesh_error)
+                    error = error ? error : mesh_error;
+                else
+                    done.push_back(std::move(mesh));
+                finished++;
+                ready.notify_one();
+            }
+        };
+
+        if(thread_count == 0)
+            thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<std::thread> threads;
+        for(size_t i = 0; i < std::min<size_t>(thread_count, mesh_count); ++i)
+            threads.emplace_back(worker);
+
+        //a failed mesh ends the loop early (its worker set next_mesh to the end)
+        try
+        {
+            while(true)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&]() { return !done.empty() || finished == mesh_count || error; });
+                if(error || done.empty())
+                    break;
+                ImportedMesh mesh = std::move(done.front());
+                done.pop_front();
+                lock.unlock();
+
+                on_mesh(mesh);
+            }
+        }
+        catch(...)
+        {
+            next_mesh = mesh_count;
+            //workers may still be storing their errors, the first one wins like there
+            std::lock_guard<std::mutex> lock(mutex);
+            error = error ? error : std::current_exception();
+        }
+
+        for(std::thread &thread : threads)
+            thread.join();
+        if(error)
+            std::rethrow_exception(error);
+        return duplicates;
+    }
+
+    //GLTF
+
+    constexpr uint32_t GLB_MAGIC = 0x46546C67; //"glTF"
+    constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+    constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+    enum ComponentType : uint32_t
+    {
+        BYTE = 5120,
+        UNSIGNED_BYTE = 5121,
+        SHORT = 5122,
+        UNSIGNED_SHORT = 5123,
+        UNSIGNED_INT = 5125,
+        FLOAT = 5126
+    };
+
+    uint32_t get_component_size(uint32_t component_type)
+    {
+        switch(component_type)
+        {
+        case BYTE:
+        case UNSIGNED_BYTE:     return 1;
+        case SHORT:
+        case UNSIGNED_SHORT:    return 2;
+        case UNSIGNED_INT:
+        case FLOAT:             return 4;
+        default:                return 0;
+        }
+    }
+
+    //accessor resolved to memory, checked to stay inside its buffer
+    struct AccessorView
+    {
+        const uint8_t *data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        uint32_t components = 0;
+        uint32_t component_type = 0;
+        bool normalized = false;
+    };
+
+    std::vector<uint8_t> decode_base64(std::string_view text)
+    {
+        auto value_of = [](char c) -> int
+        {
+            if(c >= 'A' && c <= 'Z') return c - 'A';
+            if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if(c >= '0' && c <= '9') return c - '0' + 52;
+            if(c == '+' || c == '-') return 62;
+            if(c == '/' || c == '_') return 63;
+            return -1;
+        };
+
+        std::vector<uint8_t> out;
+        out.reserve(text.size() / 4 * 3);
+        uint32_t bits = 0, bit_count = 0;
+        for(char c : text)
+        {
+            const int value = value_of(c);
+            if(value < 0)
+                continue; //padding and whitespace
+            bits = (bits << 6) | uint32_t(value);
+            bit_count += 6;
+            if(bit_count >= 8)
+            {
+                bit_count -= 8;
+                out.push_back(uint8_t(bits >> bit_count));
+            }
+        }
+        return out;
+    }
+
+    class GltfImporter
+    {
+    public:
+        explicit GltfImporter(const std::string &path) : _path(path), _file(path)
+        {
+            PROFILE_ZONE("glTF parse");
+
+            std::string_view json_text;
+            std::span<const uint8_t> bin_chunk;
+            uint32_t magic = 0;
+            if(_file.size() >= 12)
+                std::memcpy(&magic, _file.data(), sizeof(magic));
+            if(magic == GLB_MAGIC)
+            {
+                //12 byte header, then chunks: length, type, data (4 byte aligned)
+                size_t offset = 12;
+                while(offset + 8 <= _file.size())
+                {
+                    uint32_t chunk_length, chunk_type;
+                    std::memcpy(&chunk_length, _file.data() + offset, 4);
+                    std::memcpy(&chunk_type, _file.data() + offset + 4, 4);
+                    offset += 8;
+                    if(chunk_length > _file.size() - offset)
+                        fail("GLB chunk out of the file");
+                    if(chunk_type == GLB_CHUNK_JSON && json_text.empty())
+                        json_text = {reinterpret_cast<const char*>(_file.data() + offset), chunk_length};
+                    else if(chunk_type == GLB_CHUNK_BIN && bin_chunk.empty())
+                        bin_chunk = {_file.data() + offset, chunk_length};
+                    offset += (chunk_length + 3) & ~size_t(3);
+                }
+            }
+            else
+            {
+                json_text = {reinterpret_cast<const char*>(_file.data()), _file.size()};
+            }
+
+            std::string error;
+            if(!parse_json(json_text, _json, error))
+                fail(error);
+            if(!_json["asset"]["version"].as_string().starts_with("2"))
+                fail("only glTF 2.0 is supported");
+
+            _bytes = _file.size();
+            load_buffers(bin_chunk);
+        }
+
+        size_t get_mesh_count() const { return _json["meshes"].size(); }
+        uint64_t get_bytes() const { return _bytes; }
+
+        //safe to call from several threads at once (reads only)
+        ImportedMesh convert_mesh(size_t mesh_index, uint64_t &duplicates) const
+        {
+            PROFILE_ZONE("glTF mesh");
+
+            const JsonValue &json_mesh = _json["meshes"][mesh_index];
+            ImportedMesh mesh;
+            mesh.name = json_mesh["name"].is_string() ? json_mesh["name"].as_string() : "mesh " + std::to_string(mesh_index);
+
+            size_t expected_vertices = 0;
+            for(const JsonValue &primitive : json_mesh["primitives"].get_array())
+                expected_vertices += _json["accessors"][primitive["attributes"]["POSITION"].as_uint(SIZE_MAX)]["count"].as_uint();
+            VertexDeduplicator dedup(mesh, expected_vertices);
+
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+            for(const JsonValue &primitive : json_mesh["primitives"].get_array())
+            {
+                //points and lines have no place in a triangle mesh
+                constexpr uint64_t TRIANGLES = 4;
+                if(primitive["mode"].as_uint(TRIANGLES) != TRIANGLES)
+                    continue;
+
+                const JsonValue &attributes = primitive["attributes"];
+                if(!attributes.contains("POSITION"))
+                    continue;
+                const AccessorView positions = get_accessor(attributes["POSITION"].as_uint(SIZE_MAX));
+                if(positions.components != 3 || positions.component_type != FLOAT)
+                    fail("POSITION has to be float VEC3");
+
+                vertices.resize(positions.count);
+                read_floats(positions, &vertices[0].position.x, 3);
+                if(attributes.contains("COLOR_0"))
+                {
+                    const AccessorView colors = get_accessor(attributes["COLOR_0"].as_uint(SIZE_MAX));
+                    if(colors.count != positions.count || colors.components < 3)
+                        fail("COLOR_0 doesn`t match POSITION");
+                    read_floats(colors, &vertices[0].color.x, 3);
+                }
+                else
+                {
+                    for(Vertex &vertex : vertices)
+                        vertex.color = glm::vec3(1.f);
+                }
+
+                if(primitive.contains("indices"))
+                {
+                    read_indices(get_accessor(primitive["indices"].as_uint(SIZE_MAX)), indices);
+                }
+                else
+                {
+                    indices.resize(positions.count);
+                    for(uint32_t i = 0; i < indices.size(); ++i)
+                        indices[i] = i;
+                }
+
+                //each source vertex is looked up once, indices are remapped through the table
+                std::vector<uint32_t> remap(vertices.size());
+                for(size_t i = 0; i < vertices.size(); ++i)
+                    remap[i] = dedup.add(vertices[i]);
+                const size_t index_count = indices.size() / 3 * 3;
+                mesh.indices.reserve(mesh.indices.size() + index_count);
+                for(size_t i = 0; i < index_count; ++i)
+                {
+                    if(indices[i] >= remap.size())
+                        fail("index out of range");
+                    mesh.indices.push_back(remap[indices[i]]);
+                }
+            }
+            duplicates = dedup.get_duplicates();
+            return mesh;
+        }
+
+    private:
+        std::string _path;
+        MappedFile _file;
+        JsonValue _json;
+        //external .bin files, data URI buffers
+        std::vector<MappedFile> _external_files;
+        std::vector<std::vector<uint8_t>> _decoded_buffers;
+        std::vector<std::span<const uint8_t>> _buffers;
+        uint64_t _bytes = 0;
+
+        [[noreturn]] void fail(const std::string &reason) const
+        {
+            throw std::runtime_error("Failed to import the glTF file " + _path + ": " + reason);
+        }
+
+        void load_buffers(std::span<const uint8_t> bin_chunk)
+        {
+            const std::string directory = _path.substr(0, _path.find_last_of("/\\") + 1);
+            for(const JsonValue &buffer : _json["buffers"].get_array())
+            {
+                std::span<const uint8_t> data;
+                const std::string &uri = buffer["uri"].as_string();
+                if(!buffer.contains("uri"))
+                {
+                    data = bin_chunk;
+                }
+                else if(uri.starts_with("data:"))
+                {
+                    const size_t comma = uri.find(',');
+                    if(comma == std::string::npos || uri.find(";base64") > comma)
+                        fail("only base64 data URIs are supported");
+                    _decoded_buffers.push_back(decode_base64(std::string_view(uri).substr(comma + 1)));
+                    data = _decoded_buffers.back();
+                }
+                else
+                {
+                    //(URIs with percent escapes aren`t decoded)
+                    _external_files.emplace_back(directory + uri);
+                    data = {_external_files.back().data(), _external_files.back().size()};
+                    _bytes += data.size();
+                }
+
+                if(data.size() < buffer["byteLength"].as_uint())
+                    fail("buffer is shorter than its byteLength");
+                _buffers.push_back(data);
+            }
+        }
+
+        AccessorView get_accessor(uint64_t accessor_index) const
+        {
+            const JsonValue &accessor = _json["accessors"][accessor_index];
+            if(!accessor.is_object())
+                fail("missing accessor");
+            if(accessor.contains("sparse"))
+                fail("sparse accessors are not supported");
+            const JsonValue &view = _json["bufferViews"][accessor["bufferView"].as_uint(SIZE_MAX)];
+            if(!view.is_object())
+                fail("accessor without a buffer view");
+            const uint64_t buffer_index = view["buffer"].as_uint(SIZE_MAX);
+            if(buffer_index >= _buffers.size())
+                fail("missing buffer");
+
+            static const std::pair<std::string_view, uint32_t> TYPES[] =
+            {
+                {"SCALAR", 1}, {"VEC2", 2}, {"VEC3", 3}, {"VEC4", 4}
+            };
+            AccessorView result;
+            for(const auto &[name, components] : TYPES)
+                if(accessor["type"].as_string() == name)
+                    result.components = components;
+            result.component_type = static_cast<uint32_t>(accessor["componentType"].as_uint());
+            result.normalized = accessor["normalized"].as_bool();
+            result.count = accessor["count"].as_uint();
+            const uint32_t element_size = result.components * get_component_size(result.component_type);
+            if(element_size == 0)
+                fail("unsupported accessor type");
+            result.stride = view["byteStride"].as_uint(element_size);
+
+            //last element has to end inside the view, the view inside the buffer
+            const uint64_t view_offset = view["byteOffset"].as_uint();
+            const uint64_t view_length = view["byteLength"].as_uint();
+            const uint64_t offset = accessor["byteOffset"].as_uint();
+            const std::span<const uint8_t> buffer = _buffers[buffer_index];
+            if(view_offset + view_length > buffer.size()
+               || (result.count > 0 && offset + (result.count - 1) * result.stride + element_size > view_length))
+                fail("accessor out of its buffer");
+            result.data = buffer.data() + view_offset + offset;
+            return result;
+        }
+
+        //components of every element as floats, written `out_components` per vertex
+        //one loop per component type, so the inner loop has no branches (vectorizes)
+        template<typename T>
+        static void read_typed(const AccessorView &accessor, float *out, uint32_t out_components, float scale)
+        {
+            //normalized signed types have two values for -1
+            const float min_value = std::is_signed_v<T> && accessor.normalized ? -1.f : float(std::numeric_limits<T>::lowest());
+            constexpr size_t OUT_STRIDE = sizeof(Vertex) / sizeof(float);
+            const uint32_t components = std::min(accessor.components, out_components);
+            for(size_t i = 0; i < accessor.count; ++i)
+            {
+                const uint8_t *element = accessor.data + i * accessor.stride;
+                float *dst = out + i * OUT_STRIDE;
+                for(uint32_t c = 0; c < components; ++c)
+                {
+                    T value;
+                    std::memcpy(&value, element + c * sizeof(T), sizeof(T));
+                    dst[c] = std::max(float(value) * scale, min_value);
+                }
+            }
+        }
+
+        void read_floats(const AccessorView &accessor, float *out, uint32_t out_components) const
+        {
+            switch(accessor.component_type)
+            {
+            case FLOAT:
+            {
+                constexpr size_t OUT_STRIDE = sizeof(Vertex) / sizeof(float);
+                const uint32_t components = std::min(accessor.components, out_components);
+                for(size_t i = 0; i < accessor.count; ++i)
+                    std::memcpy(out + i * OUT_STRIDE, accessor.data + i * accessor.stride, components * sizeof(float));
+                break;
+            }
+            case UNSIGNED_BYTE:  read_typed<uint8_t>(accessor, out, out_components, accessor.normalized ? 1.f / 255.f : 1.f); break;
+            case UNSIGNED_SHORT: read_typed<uint16_t>(accessor, out, out_components, accessor.normalized ? 1.f / 65535.f : 1.f); break;
+            case BYTE:           read_typed<int8_t>(accessor, out, out_components, accessor.normalized ? 1.f / 127.f : 1.f); break;
+            case SHORT:          read_typed<int16_t>(accessor, out, out_components, accessor.normalized ? 1.f / 32767.f : 1.f); break;
+            default:             fail("unsupported vertex component type");
+            }
+        }
+
+        void read_indices(const AccessorView &accessor, std::vector<uint32_t> &indices) const
+        {
+            if(accessor.components != 1)
+                fail("indices have to be SCALAR");
+            indices.resize(accessor.count);
+            auto read = [&]<typename T>(T)
+            {
+                for(size_t i = 0; i < accessor.count; ++i)
+                {
+                    T value;
+                    std::memcpy(&value, accessor.data + i * accessor.stride, sizeof(T));
+                    indices[i] = value;
+                }
+            };
+            switch(accessor.component_type)
+            {
+            case UNSIGNED_BYTE:  read(uint8_t()); break;
+            case UNSIGNED_SHORT: read(uint16_t()); break;
+            case UNSIGNED_INT:   read(uint32_t()); break;
+            default:             fail("unsupported index type");
+            }
+        }
+    };
+
+    //OBJ
+
+    class ObjImporter
+    {
+    public:
+        explicit ObjImporter(const std::string &path) : _path(path), _file(path)
+        {
+            PROFILE_ZONE("OBJ parse");
+
+            //positions are global to the file, so they are read here
+            //face lines are only collected, they are parsed per object on the workers
+            const std::string_view text(reinterpret_cast<const char*>(_file.data()), _file.size());
+            size_t line_start = 0;
+            while(line_start < text.size())
+            {
+                size_t line_end = text.find('\n', line_start);
+                if(line_end == std::string_view::npos)
+                    line_end = text.size();
+                std::string_view line = text.substr(line_start, line_end - line_start);
+                line_start = line_end + 1;
+
+                if(line.starts_with("v "))
+                {
+                    float values[6] = {0.f, 0.f, 0.f, 1.f, 1.f, 1.f};
+                    const char *cursor = line.data() + 2;
+                    const char *end = line.data() + line.size();
+                    for(uint32_t i = 0; i < 6 && parse_float(cursor, end, values[i]); ++i);
+                    _vertices.push_back({{values[0], values[1], values[2]}, {values[3], values[4], values[5]}});
+                }
+                else if(line.starts_with("o ") || line.starts_with("g "))
+                {
+                    //group without faces is dropped, its name is taken by the next one
+                    if(_objects.empty() || !_objects.back().faces.empty())
+                        _objects.emplace_back();
+                    _objects.back().name = trim(line.substr(2));
+                }
+                else if(line.starts_with("f "))
+                {
+                    if(_objects.empty())
+                        _objects.push_back({path.substr(path.find_last_of("/\\") + 1), {}});
+                    _objects.back().faces.push_back({line.substr(2), static_cast<uint32_t>(_vertices.size())});
+                }
+            }
+            if(!_objects.empty() && _objects.back().faces.empty())
+                _objects.pop_back();
+        }
+
+        size_t get_mesh_count() const { return _objects.size(); }
+        uint64_t get_bytes() const { return _file.size(); }
+
+        ImportedMesh convert_mesh(size_t object_index, uint64_t &duplicates) const
+        {
+            PROFILE_ZONE("OBJ mesh");
+
+            const Object &object = _objects[object_index];
+            ImportedMesh mesh;
+            mesh.name = object.name;
+            VertexDeduplicator dedup(mesh, object.faces.size() * 2);
+
+            //file position index -> mesh vertex (texture coordinates and normals aren`t in Vertex)
+            std::unordered_map<uint32_t, uint32_t> used;
+            std::vector<uint32_t> polygon;
+            for(const Face &face : object.faces)
+            {
+                polygon.clear();
+                const char *cursor = face.text.data();
+                const char *end = cursor + face.text.size();
+                while(true)
+                {
+                    while(cursor < end && (*cursor == ' ' || *cursor == '\t'))
+                        ++cursor;
+                    int64_t index = 0;
+                    const auto [next, ec] = std::from_chars(cursor, end, index);
+                    if(ec != std::errc())
+                        break;
+                    //"v/vt/vn", only v matters
+                    cursor = next;
+                    while(cursor < end && *cursor != ' ' && *cursor != '\t')
+                        ++cursor;
+
+                    //1 based, negative -- relative to the vertices read before the face
+                    const int64_t position = index > 0 ? index - 1 : int64_t(face.vertices_before) + index;
+                    if(index == 0 || position < 0 || position >= int64_t(face.vertices_before))
+                        throw std::runtime_error("Failed to import the OBJ file " + _path + ": index out of range");
+
+                    const auto [it, inserted] = used.try_emplace(uint32_t(position), 0);
+                    if(inserted)
+                        it->second = dedup.add(_vertices[position]);
+                    polygon.push_back(it->second);
+                }
+
+                //triangle fan
+                for(size_t i = 2; i < polygon.size(); ++i)
+                    mesh.indices.insert(mesh.indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+            }
+            duplicates = dedup.get_duplicates();
+            return mesh;
+        }
+
+    private:
+        struct Face
+        {
+            std::string_view text;
+            uint32_t vertices_before;
+        };
+        struct Object
+        {
+            std::string name;
+            std::vector<Face> faces;
+        };
+
+        std::string _path;
+        MappedFile _file;
+        std::vector<Vertex> _vertices;
+        std::vector<Object> _objects;
+
+        static std::string trim(std::string_view text)
+        {
+            while(!text.empty() && (text.back() == '\r' || text.back() == ' ' || text.back() == '\t'))
+                text.remove_suffix(1);
+            return std::string(text);
+        }
+
+        static bool parse_float(const char *&cursor, const char *end, float &value)
+        {
+            while(cursor < end && (*cursor == ' ' || *cursor == '\t'))
+                ++cursor;
+            const auto [next, ec] = std::from_chars(cursor, end, value);
+            if(ec != std::errc())
+                return false;
+            cursor = next;
+            return true;
+        }
+    };
+
+    template<typename Importer>
+    ImportStats import_with(const std::string &path, const std::function<void(ImportedMesh &mesh)> &on_mesh,
+                            uint32_t thread_count)
+    {
+        Importer importer(path);
+        ImportStats stats;
+        stats.bytes = importer.get_bytes();
+        stats.duplicate_vertices = convert_in_parallel(importer.get_mesh_count(), thread_count,
+            [&importer](size_t mesh, uint64_t &duplicates) { return importer.convert_mesh(mesh, duplicates); },
+            [&](ImportedMesh &mesh)
+            {
+                //(e.g. glTF mesh of lines only)
+                if(mesh.indices.empty())
+                    return;
+                stats.meshes++;
+                stats.triangles += mesh.indices.size() / 3;
+                on_mesh(mesh);
+            });
+        return stats;
+    }
+}
+
+ImportStats import_meshes(const std::string &path, const std::function<void(ImportedMesh &mesh)> &on_mesh,
+                          uint32_t thread_count)
+{
+    PROFILE_ZONE("import_meshes");
+    const auto start = std::chrono::steady_clock::now();
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(std::tolower(c)); });
+
+    ImportStats stats;
+    if(extension == "gltf" || extension == "glb")
+        stats = import_with<GltfImporter>(path, on_mesh, thread_count);
+    else if(extension == "obj")
+        stats = import_with<ObjImporter>(path, on_mesh, thread_count);
+    else
+        throw std::runtime_error("Failed to import " + path + ": unknown file type");
+
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vk_utils.h"
+
+//mesh of an asset file in the renderer`s Vertex layout, identical vertices merged
+struct ImportedMesh
+{
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct ImportStats
+{
+    //asset file + external buffers read
+    uint64_t bytes = 0;
+    uint32_t meshes = 0;
+    uint64_t triangles = 0;
+    //source vertices merged into another one
+    uint64_t duplicate_vertices = 0;
+    //whole import, on_mesh calls included
+    double ms = 0.0;
+};
+
+//Importer of glTF 2.0 (.gltf with external or data URI buffers, .glb) and Wavefront OBJ
+//meshes are converted on worker threads, on_mesh gets every one on the calling thread as soon as it is done
+//(uploads start while other meshes are still being converted), meshes without triangles are skipped
+//throws if the file can`t be imported
+//glTF: triangle primitives of a mesh become one mesh (POSITION, COLOR_0), node transforms are not applied
+//OBJ: "o"/"g" groups become meshes, "v x y z [r g b]" positions with optional colours, polygons are fanned
+ImportStats import_meshes(const std::string &path, const std::function<void(ImportedMesh &mesh)> &on_mesh,
+                          uint32_t thread_count = 0);
@@ -0,0 +1,200 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace profiler
+{
+namespace
+{
+    //Single producer ring: only the owning thread writes, exporter only reads
+    //When the ring is full the oldest zones are overwritten
+    struct ThreadRing
+    {
+        static constexpr uint64_t CAPACITY = 1 << 16; //must be a power of two
+        static constexpr uint64_t MASK = CAPACITY - 1;
+
+        //CPU rings hold raw ticks, the GPU ring holds nanoseconds
+        ZoneEvent events[CAPACITY];
+        std::atomic<uint64_t> write_index{0};
+        uint32_t thread_id = 0;
+
+        void push(const char *name, uint64_t begin, uint64_t end)
+        {
+            const uint64_t index = write_index.load(std::memory_order_relaxed);
+            events[index & MASK] = ZoneEvent{name, begin, end, thread_id};
+            //publish the slot to the exporter
+            write_index.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        //rings outlive their threads, so zones of finished workers still get exported
+        std::vector<std::unique_ptr<ThreadRing>> rings;
+        ThreadRing gpu_ring;
+
+        //pair of timestamps to convert ticks into steady clock nanoseconds on export
+        const uint64_t base_ticks = now_ticks();
+        const uint64_t base_ns = now_ns();
+    };
+
+    Registry& registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    ThreadRing* register_thread()
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.push_back(std::make_unique<ThreadRing>());
+        reg.rings.back()->thread_id = static_cast<uint32_t>(reg.rings.size() - 1);
+        return reg.rings.back().get();
+    }
+
+    //the owning thread may keep pushing while we copy: the oldest CAPACITY / 8 slots of a full ring are
+    //skipped (next to be overwritten), and slots the writer reached meanwhile are dropped after the copy
+    void copy_ring(const ThreadRing &ring, std::vector<ZoneEvent> &out)
+    {
+        constexpr uint64_t MARGIN = ThreadRing::CAPACITY / 8;
+        const uint64_t end = ring.write_index.load(std::memory_order_acquire);
+        const uint64_t begin = end > ThreadRing::CAPACITY ? end - ThreadRing::CAPACITY + MARGIN : 0;
+        const size_t first = out.size();
+        for(uint64_t i = begin; i < end; ++i)
+            out.push_back(ring.events[i & ThreadRing::MASK]);
+
+        //like a seqlock reader: copies before the second load, everything up to the slot being written
+        //now (write_index - CAPACITY) may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t written = ring.write_index.load(std::memory_order_relaxed);
+        if(written + 1 > begin + ThreadRing::CAPACITY)
+        {
+            const uint64_t torn = std::min(written + 1 - ThreadRing::CAPACITY, end) - begin;
+            out.erase(out.begin() + first, out.begin() + first + torn);
+        }
+    }
+
+    struct TicksToNs
+    {
+        uint64_t base_ticks;
+        uint64_t base_ns;
+        double ns_per_tick;
+
+        uint64_t operator()(uint64_t ticks) const
+        {
+            return base_ns + uint64_t(double(int64_t(ticks - base_ticks)) * ns_per_tick);
+        }
+    };
+
+    void write_escaped(std::ofstream &file, const char *str)
+    {
+        for(; *str; ++str)
+        {
+            if(*str == '"' || *str == '\\')
+                file << '\\';
+            file << *str;
+        }
+    }
+}
+
+uint64_t now_ns()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t now_ticks_fallback()
+{
+    return now_ns();
+}
+
+void record_zone(const char *name, uint64_t begin_ticks, uint64_t end_ticks)
+{
+    //registration takes the lock once per thread, every other zone is lock-free
+    thread_local ThreadRing *ring = register_thread();
+    ring->push(name, begin_ticks, end_ticks);
+}
+
+void record_gpu_zone(const char *name, uint64_t begin_ns, uint64_t end_ns)
+{
+    //GPU results are read back on the render thread only
+    ThreadRing &ring = registry().gpu_ring;
+    ring.thread_id = GPU_THREAD_ID;
+    ring.push(name, begin_ns, end_ns);
+}
+
+std::vector<ZoneEvent> collect()
+{
+    std::vector<ZoneEvent> events;
+
+    Registry &reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for(const auto &ring : reg.rings)
+            copy_ring(*ring, events);
+    }
+
+    //measure tick rate over the whole run
+    const uint64_t elapsed_ticks = now_ticks() - reg.base_ticks;
+    const uint64_t elapsed_ns = now_ns() - reg.base_ns;
+    const TicksToNs to_ns
+    {
+        .base_ticks = reg.base_ticks,
+        .base_ns = reg.base_ns,
+        .ns_per_tick = elapsed_ticks ? double(elapsed_ns) / double(elapsed_ticks) : 1.0
+    };
+    for(ZoneEvent &event : events)
+    {
+        event.begin_ns = to_ns(event.begin_ns);
+        event.end_ns = to_ns(event.end_ns);
+    }
+
+    copy_ring(reg.gpu_ring, events);
+
+    std::sort(begin(events), end(events), [](const ZoneEvent &a, const ZoneEvent &b)
+    {
+        return a.begin_ns < b.begin_ns;
+    });
+    return events;
+}
+
+bool write_chrome_trace(const std::string &path)
+{
+    const std::vector<ZoneEvent> events = collect();
+
+    std::ofstream file(path, std::ios::trunc);
+    if(!file.is_open())
+        return false;
+
+    //keep timestamps small, trace viewers work in microseconds
+    const uint64_t base_ns = events.empty() ? 0 : events.front().begin_ns;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    //name the tracks: CPU threads in process 1, GPU queue in process 2
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+    for(const ZoneEvent &event : events)
+    {
+        const bool is_gpu = event.thread_id == GPU_THREAD_ID;
+        file << ",\n{\"name\":\"";
+        write_escaped(file, event.name);
+        file << "\",\"ph\":\"X\""
+             << ",\"pid\":" << (is_gpu ? 2 : 1)
+             << ",\"tid\":" << (is_gpu ? 0 : event.thread_id)
+             << ",\"ts\":" << double(event.begin_ns - base_ns) / 1000.0
+             << ",\"dur\":" << double(event.end_ns - event.begin_ns) / 1000.0
+             << "}";
+    }
+    file << "\n]}\n";
+
+    return file.good();
+}
+}
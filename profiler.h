@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//Scoped-zone CPU profiler
+//PROFILE_ZONE("name") records begin/end of the enclosing scope into a per-thread ring buffer
+//Define ENABLE_PROFILER=1 in the project preprocessor definitions to turn it on,
+//otherwise every PROFILE_* macro compiles to nothing
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 0
+#endif
+
+namespace profiler
+{
+    //one finished zone, times are in nanoseconds of the steady clock
+    struct ZoneEvent
+    {
+        //must be a string literal (we keep only the pointer)
+        const char *name;
+        uint64_t begin_ns;
+        uint64_t end_ns;
+        //index of the thread buffer the event came from (GPU events use GPU_THREAD_ID)
+        uint32_t thread_id;
+    };
+
+    static constexpr uint32_t GPU_THREAD_ID = 0xFFFFFFFF;
+
+    //steady clock, same time base as ZoneEvent
+    uint64_t now_ns();
+    //cheapest timestamp available (TSC on x86), converted to ns only on export
+    uint64_t now_ticks_fallback();
+    inline uint64_t now_ticks()
+    {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return now_ticks_fallback();
+#endif
+    }
+
+    //append a finished zone to the ring of the calling thread (no locks after the first call on a thread)
+    void record_zone(const char *name, uint64_t begin_ticks, uint64_t end_ticks);
+    //GPU timeline, already converted to the CPU clock by the caller
+    void record_gpu_zone(const char *name, uint64_t begin_ns, uint64_t end_ns);
+
+    //copy of everything still in the rings, sorted by begin time
+    //safe while other threads record, but it can miss their oldest zones: a full ring loses its oldest
+    //1/8, and zones overwritten during the copy are dropped (join the threads first for a complete trace)
+    std::vector<ZoneEvent> collect();
+    //Chrome trace / Perfetto JSON (open in chrome://tracing or ui.perfetto.dev)
+    bool write_chrome_trace(const std::string &path);
+
+    class ScopedZone
+    {
+    public:
+        explicit ScopedZone(const char *name) : _name(name), _begin_ticks(now_ticks()) {}
+        ~ScopedZone() { record_zone(_name, _begin_ticks, now_ticks()); }
+
+        ScopedZone(const ScopedZone&) = delete;
+        ScopedZone& operator=(const ScopedZone&) = delete;
+
+    private:
+        const char *_name;
+        uint64_t _begin_ticks;
+    };
+}
+
+#if ENABLE_PROFILER
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) profiler::ScopedZone PROFILE_CONCAT(_profile_zone_, __LINE__){name}
+#define PROFILE_GPU_ZONE(name, begin_ns, end_ns) profiler::record_gpu_zone(name, begin_ns, end_ns)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name, begin_ns, end_ns)
+#endif
@@ -0,0 +1,128 @@
+#include "render_queue.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <bit>
+#include <thread>
+
+namespace
+{
+    constexpr uint32_t RADIX_BITS = 8;
+    constexpr uint32_t RADIX_BUCKETS = 1u << RADIX_BITS;
+    //below it thread start up costs more than the sort
+    constexpr size_t PARALLEL_SORT_MIN_ITEMS = 16384;
+    constexpr uint32_t MAX_SORT_THREADS = 8;
+
+    //float to uint32 with the same order (negative floats have the sign bit set and reversed magnitude)
+    uint32_t sortable_float(float value)
+    {
+        const uint32_t bits = std::bit_cast<uint32_t>(value);
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+}
+
+void radix_sort(std::vector<SortItem> &items, std::vector<SortItem> &scratch, uint32_t max_threads)
+{
+    const size_t count = items.size();
+    scratch.resize(count);
+    if(count < 2)
+        return;
+
+    const uint32_t threads = count < PARALLEL_SORT_MIN_ITEMS ? 1u : std::clamp(max_threads, 1u, MAX_SORT_THREADS);
+    const size_t chunk = (count + threads - 1) / threads;
+
+    //histogram of the thread chunk, turned into its write positions
+    std::vector<std::array<size_t, RADIX_BUCKETS>> offsets(threads);
+    SortItem *src = items.data();
+    SortItem *dst = scratch.data();
+    uint32_t shift = 0;
+    bool skip_pass = false;
+
+    //digit d of thread t goes after all smaller digits and after digit d of threads before t
+    auto prefix_sums = [&]() noexcept
+    {
+        skip_pass = false;
+        size_t total = 0;
+        for(uint32_t digit = 0; digit < RADIX_BUCKETS; ++digit)
+        {
+            size_t digit_count = 0;
+            for(uint32_t t = 0; t < threads; ++t)
+            {
+                const size_t thread_count = offsets[t][digit];
+                offsets[t][digit] = total;
+                total += thread_count;
+                digit_count += thread_count;
+            }
+            //every key has the same digit, the pass wouldn`t change the order
+            if(digit_count == count)
+                skip_pass = true;
+        }
+    };
+    auto next_pass = [&]() noexcept
+    {
+        if(!skip_pass)
+            std::swap(src, dst);
+        shift += RADIX_BITS;
+    };
+    std::barrier counted(threads, prefix_sums);
+    std::barrier scattered(threads, next_pass);
+
+    auto sort_chunk = [&](uint32_t t)
+    {
+        const size_t begin = std::min(count, t * chunk);
+        const size_t end = std::min(count, begin + chunk);
+        for(uint32_t pass = 0; pass < 32 / RADIX_BITS; ++pass)
+        {
+            std::array<size_t, RADIX_BUCKETS> &histogram = offsets[t];
+            histogram.fill(0);
+            for(size_t i = begin; i < end; ++i)
+                histogram[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+            counted.arrive_and_wait();
+
+            if(!skip_pass)
+                for(size_t i = begin; i < end; ++i)
+                    dst[histogram[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+            scattered.arrive_and_wait();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(uint32_t t = 1; t < threads; ++t)
+        workers.emplace_back(sort_chunk, t);
+    sort_chunk(0);
+    for(std::thread &worker : workers)
+        worker.join();
+
+    //odd number of scatters: result is in scratch
+    if(src != items.data())
+        items.swap(scratch);
+}
+
+void RenderQueues::build(std::vector<Mesh> &meshes, const glm::mat4 &view)
+{
+    PROFILE_ZONE("build render queues");
+
+    if(_max_threads == 0)
+        _max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    _opaque.clear();
+    _transparent.clear();
+    //distance along the view direction: -z of the object origin in view space
+    const glm::vec4 view_z{view[0][2], view[1][2], view[2][2], view[3][2]};
+    for(uint32_t i = 0; i < meshes.size(); ++i)
+    {
+        const glm::mat4 &model = meshes[i].get_model().model;
+        const float depth = -glm::dot(view_z, model[3]);
+        const uint32_t key = sortable_float(depth);
+        if(meshes[i].is_transparent())
+            //far first
+            _transparent.push_back({~key, i});
+        else
+            _opaque.push_back({key, i});
+    }
+
+    radix_sort(_opaque, _scratch, _max_threads);
+    radix_sort(_transparent, _scratch, _max_threads);
+}
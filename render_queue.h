@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vk_mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+//mesh with its position in the draw order
+struct SortItem
+{
+    uint32_t key;
+    uint32_t mesh;
+};
+
+//LSD radix sort by key (8 bits per pass, stable), scratch is resized to items
+//big inputs are split between threads: per thread histograms, then every thread scatters its own chunk
+void radix_sort(std::vector<SortItem> &items, std::vector<SortItem> &scratch, uint32_t max_threads);
+
+//Per frame draw lists of the scene
+//opaque: front-to-back, so early depth test rejects hidden fragments
+//transparent: back-to-front, so blending composes in the right order
+class RenderQueues
+{
+public:
+    //one pass over the meshes splits and keys them, then both lists are sorted
+    void build(std::vector<Mesh> &meshes, const glm::mat4 &view);
+
+    const std::vector<SortItem>& get_opaque() const { return _opaque; }
+    const std::vector<SortItem>& get_transparent() const { return _transparent; }
+
+private:
+    std::vector<SortItem> _opaque;
+    std::vector<SortItem> _transparent;
+    std::vector<SortItem> _scratch;
+    uint32_t _max_threads = 0;
+};
@@ -0,0 +1,70 @@
+//Clustered forward lighting for fragment shaders (lists from light_cluster.comp)
+//set 0: binding 2 -- light data, binding 3 -- cluster lists
+
+//LightClusters::MAX_LIGHTS_PER_CLUSTER
+const uint MAX_LIGHTS_PER_CLUSTER = 127;
+
+struct Light
+{
+	vec4 position_radius; //view space
+	vec4 color_intensity;
+	vec4 direction_cos_outer; //cos_outer -1 -- point light
+	vec4 cos_inner;
+};
+
+layout(set = 0, binding = 2) readonly buffer LightBuffer
+{
+	uvec4 grid; //clusters x, y, z, light count
+	vec4 z_params; //slice = log(depth) * x + y, near, far
+	vec4 tile; //tile size in pixels, 1 / rendered size
+	vec4 ambient;
+	mat4 inverse_projection;
+	Light lights[];
+} light_data;
+
+layout(set = 0, binding = 3) readonly buffer ClusterBuffer
+{
+	uint items[];
+} clusters;
+
+//light reaching a view space point (multiplies the surface colour)
+vec3 cluster_lighting(vec3 view_position)
+{
+	//vertices have no normals: flat normal of the triangle, towards the camera
+	//(derivatives before any branch)
+	vec3 normal = normalize(cross(dFdx(view_position), dFdy(view_position)));
+	if(dot(normal, view_position) > 0.0)
+		normal = -normal;
+
+	vec3 result = light_data.ambient.rgb;
+	if(light_data.grid.w == 0)
+		return result;
+
+	//cluster of the fragment: screen tile + exponential depth slice
+	uvec3 grid = light_data.grid.xyz;
+	float slice = log(-view_position.z) * light_data.z_params.x + light_data.z_params.y;
+	uvec3 cluster = uvec3(min(uvec2(gl_FragCoord.xy / light_data.tile.xy), grid.xy - 1u),
+	                            uint(clamp(slice, 0.0, float(grid.z - 1u))));
+	uint base = (cluster.x + grid.x * (cluster.y + grid.y * cluster.z)) * (MAX_LIGHTS_PER_CLUSTER + 1);
+
+	uint count = clusters.items[base];
+	for(uint i = 0; i < count; ++i)
+	{
+		Light light = light_data.lights[clusters.items[base + 1 + i]];
+		vec3 to_light = light.position_radius.xyz - view_position;
+		float distance_sq = dot(to_light, to_light);
+		vec3 l = to_light * inversesqrt(max(distance_sq, 1e-8));
+
+		//inverse square, windowed to reach 0 at the radius (nothing is lit outside the binned clusters)
+		float ratio = distance_sq / (light.position_radius.w * light.position_radius.w);
+		float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+		float attenuation = window * window / (distance_sq + 1.0);
+
+		//spot cone
+		if(light.direction_cos_outer.w > -1.0)
+			attenuation *= smoothstep(light.direction_cos_outer.w, light.cos_inner.x, dot(-l, light.direction_cos_outer.xyz));
+
+		result += light.color_intensity.rgb * light.color_intensity.w * attenuation * max(dot(normal, l), 0.0);
+	}
+	return result;
+}
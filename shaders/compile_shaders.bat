@@ -1,3 +1,12 @@
 C:/gprojects/vulkanSDK/1.2.176.1/Bin32/glslangValidator.exe -V shader.vert 
 C:/gprojects/vulkanSDK/1.2.176.1/Bin32/glslangValidator.exe -V shader.frag
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/glslangValidator.exe -V --target-env vulkan1.2 shader_bindless.frag -o frag_bindless.spv
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/glslangValidator.exe -V shader_depth.vert -o depth.spv
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/glslangValidator.exe -V light_cluster.comp -o light_cluster.spv
+rem everything the renderer loads has to pass the validator
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/spirv-val.exe --target-env vulkan1.2 vert.spv
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/spirv-val.exe --target-env vulkan1.2 frag.spv
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/spirv-val.exe --target-env vulkan1.2 frag_bindless.spv
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/spirv-val.exe --target-env vulkan1.2 depth.spv
+C:/gprojects/vulkanSDK/1.2.176.1/Bin32/spirv-val.exe --target-env vulkan1.2 light_cluster.spv
 pause
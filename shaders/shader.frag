@@ -1,11 +1,18 @@
 #version 450 //use GLSL 4.5
+#extension GL_GOOGLE_include_directive : require
 //go through all pixel
 
+#include "clustered_lighting.glsl"
+
 layout(location = 0) in vec3 fragment_color;
+layout(location = 1) in vec3 view_position;
 
 layout(location = 0) out vec4 outColour;
 
+//specialization constant: set per pipeline variant (PipelineDesc::specialization[0])
+layout(constant_id = 0) const float ALPHA = 1.0;
+
 void main()
 {
-	outColour = vec4(fragment_color, 1.0);
+	outColour = vec4(fragment_color * cluster_lighting(view_position), ALPHA);
 }
\ No newline at end of file
@@ -10,22 +10,22 @@ layout(binding = 0) uniform UBOViewProjection
 	mat4 view;
 } ubo_vp;
 
-//LEGACY
-//layout(binding = 1) uniform UBOModel
-//{
-//	mat4 model;
-//} ubo_model;
-
-//one push constant per shader
-layout(push_constant) uniform PushModel
+//dynamic uniform buffer, offset of the draw is given on bind
+layout(binding = 1) uniform UBOModel
 {
 	mat4 model;
-} push_model;
+} ubo_model;
 
 layout(location = 0) out vec3 fragment_color;
+//lights and clusters are in view space
+layout(location = 1) out vec3 view_position;
+
+//depth prepass computes the same position (shader_depth.vert), EQUAL test needs bit exact depth
+invariant gl_Position;
 
 void main()
 {
-	gl_Position = ubo_vp.projection * ubo_vp.view * push_model.model * vec4(position, 1.0);
+	gl_Position = ubo_vp.projection * ubo_vp.view * ubo_model.model * vec4(position, 1.0);
 	fragment_color = color;
+	view_position = vec3(ubo_vp.view * ubo_model.model * vec4(position, 1.0));
 }
\ No newline at end of file
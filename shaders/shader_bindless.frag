@@ -0,0 +1,34 @@
+#version 450 //use GLSL 4.5
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+//same as shader.frag, colour is tinted by a material from the bindless heap
+
+#include "clustered_lighting.glsl"
+
+layout(location = 0) in vec3 fragment_color;
+layout(location = 1) in vec3 view_position;
+
+layout(location = 0) out vec4 outColour;
+
+//bindless handles of the draw
+layout(push_constant) uniform PushHandles
+{
+	uint material_buffer;
+	uint material;
+	uint texture_id;
+	uint sampler_id;
+} push_handles;
+
+//bindless heap (set 1), indexed with handles
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+layout(set = 1, binding = 2) readonly buffer MaterialBuffer
+{
+	vec4 tint[];
+} storage_buffers[];
+
+void main()
+{
+	vec4 tint = storage_buffers[nonuniformEXT(push_handles.material_buffer)].tint[push_handles.material];
+	outColour = vec4(fragment_color * cluster_lighting(view_position), 1.0) * tint;
+}
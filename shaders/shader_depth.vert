@@ -0,0 +1,23 @@
+#version 450 //use GLSL 4.5
+//depth prepass: position only, pipeline has no fragment shader
+
+layout(location = 0) in vec3 position;
+
+layout(binding = 0) uniform UBOViewProjection
+{
+	mat4 projection;
+	mat4 view;
+} ubo_vp;
+
+layout(binding = 1) uniform UBOModel
+{
+	mat4 model;
+} ubo_model;
+
+//same math as shader.vert, colour pass tests against this depth with EQUAL
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = ubo_vp.projection * ubo_vp.view * ubo_model.model * vec4(position, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "vk_bindless.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    //wanted array sizes, clamped to device limits
+    constexpr uint32_t MAX_SAMPLED_IMAGES = 16384;
+    constexpr uint32_t MAX_SAMPLERS = 256;
+    constexpr uint32_t MAX_STORAGE_BUFFERS = 4096;
+
+    constexpr VkDescriptorType binding_types[BindlessHeap::BINDING_COUNT]
+    {
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        VK_DESCRIPTOR_TYPE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+    };
+}
+
+bool BindlessHeap::is_supported(const VkPhysicalDeviceDescriptorIndexingFeatures &features)
+{
+    return features.runtimeDescriptorArray
+        && features.descriptorBindingPartiallyBound
+        && features.descriptorBindingUpdateUnusedWhilePending
+        && features.descriptorBindingSampledImageUpdateAfterBind
+        && features.descriptorBindingStorageBufferUpdateAfterBind
+        && features.shaderSampledImageArrayNonUniformIndexing
+        && features.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+void BindlessHeap::enable_features(VkPhysicalDeviceDescriptorIndexingFeatures &features)
+{
+    //only what the heap needs, everything else stays off
+    void *next = features.pNext;
+    features = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES, .pNext = next};
+    features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.runtimeDescriptorArray = VK_TRUE;
+}
+
+void BindlessHeap::create(VkPhysicalDevice p_device, VkDevice l_device, uint32_t frames_in_flight)
+{
+    _logical_device = l_device;
+    _frames_in_flight = frames_in_flight;
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexing_properties
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES
+    };
+    VkPhysicalDeviceProperties2 properties2
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &indexing_properties
+    };
+    vkGetPhysicalDeviceProperties2(p_device, &properties2);
+
+    //per stage limits are the tighter ones on most GPUs
+    _slots[SAMPLED_IMAGES].capacity = std::min({MAX_SAMPLED_IMAGES,
+                                                indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                                indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    _slots[SAMPLERS].capacity = std::min({MAX_SAMPLERS,
+                                          indexing_properties.maxDescriptorSetUpdateAfterBindSamplers,
+                                          indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers});
+    _slots[STORAGE_BUFFERS].capacity = std::min({MAX_STORAGE_BUFFERS,
+                                                 indexing_properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                                 indexing_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+    std::array<VkDescriptorSetLayoutBinding, BINDING_COUNT> bindings;
+    std::array<VkDescriptorBindingFlags, BINDING_COUNT> binding_flags;
+    std::array<VkDescriptorPoolSize, BINDING_COUNT> pool_sizes;
+    for(uint32_t i = 0; i < BINDING_COUNT; ++i)
+    {
+        bindings[i] =
+        {
+            .binding = i,
+            .descriptorType = binding_types[i],
+            .descriptorCount = _slots[i].capacity,
+            .stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr
+        };
+        //unused slots may stay empty, slots can be written while the set is bound
+        binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                         | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                         | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        pool_sizes[i] = {.type = binding_types[i], .descriptorCount = _slots[i].capacity};
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(binding_flags.size()),
+        .pBindingFlags = binding_flags.data()
+    };
+    VkDescriptorSetLayoutCreateInfo layout_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &binding_flags_createinfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data()
+    };
+    VkResult res = vkCreateDescriptorSetLayout(_logical_device, &layout_createinfo, nullptr, &_layout);
+    if(res != VK_SUCCESS)
+        throw std::runtime_error("Failed to create bindless Descriptor Set Layout!");
+
+    VkDescriptorPoolCreateInfo pool_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+        .pPoolSizes = pool_sizes.data()
+    };
+    res = vkCreateDescriptorPool(_logical_device, &pool_createinfo, nullptr, &_pool);
+    if(res != VK_SUCCESS)
+        throw std::runtime_error("Failed to create bindless Descriptor Pool!");
+
+    VkDescriptorSetAllocateInfo allocate_info
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = _pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &_layout
+    };
+    res = vkAllocateDescriptorSets(_logical_device, &allocate_info, &_set);
+    if(res != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate bindless Descriptor Set!");
+
+    std::cout << "Bindless heap: " << _slots[SAMPLED_IMAGES].capacity << " images, "
+              << _slots[SAMPLERS].capacity << " samplers, "
+              << _slots[STORAGE_BUFFERS].capacity << " storage buffers\n";
+}
+
+void BindlessHeap::destroy()
+{
+    if(_pool == VK_NULL_HANDLE)
+        return;
+
+    //set is freed with the pool
+    vkDestroyDescriptorPool(_logical_device, _pool, nullptr);
+    vkDestroyDescriptorSetLayout(_logical_device, _layout, nullptr);
+    _pool = VK_NULL_HANDLE;
+    _layout = VK_NULL_HANDLE;
+    _set = VK_NULL_HANDLE;
+    _slots = {};
+    _pending_free.clear();
+}
+
+uint32_t BindlessHeap::allocate(Binding binding)
+{
+    Slots &slots = _slots[binding];
+    if(!slots.free.empty())
+    {
+        const uint32_t handle = slots.free.back();
+        slots.free.pop_back();
+        return handle;
+    }
+    if(slots.next == slots.capacity)
+        throw std::runtime_error("Bindless heap is full!");
+    return slots.next++;
+}
+
+uint32_t BindlessHeap::add_image(VkImageView image_view, VkImageLayout layout)
+{
+    const uint32_t handle = allocate(SAMPLED_IMAGES);
+    VkDescriptorImageInfo image_info
+    {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = image_view,
+        .imageLayout = layout
+    };
+    VkWriteDescriptorSet write
+    {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = _set,
+        .dstBinding = SAMPLED_IMAGES,
+        .dstArrayElement = handle,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo = &image_info
+    };
+    vkUpdateDescriptorSets(_logical_device, 1, &write, 0, nullptr);
+    return handle;
+}
+
+uint32_t BindlessHeap::add_sampler(VkSampler sampler)
+{
+    const uint32_t handle = allocate(SAMPLERS);
+    VkDescriptorImageInfo sampler_info
+    {
+        .sampler = sampler
+    };
+    VkWriteDescriptorSet write
+    {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = _set,
+        .dstBinding = SAMPLERS,
+        .dstArrayElement = handle,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+        .pImageInfo = &sampler_info
+    };
+    vkUpdateDescriptorSets(_logical_device, 1, &write, 0, nullptr);
+    return handle;
+}
+
+uint32_t BindlessHeap::add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    const uint32_t handle = allocate(STORAGE_BUFFERS);
+    VkDescriptorBufferInfo buffer_info
+    {
+        .buffer = buffer,
+        .offset = offset,
+        .range = range
+    };
+    VkWriteDescriptorSet write
+    {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = _set,
+        .dstBinding = STORAGE_BUFFERS,
+        .dstArrayElement = handle,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_info
+    };
+    vkUpdateDescriptorSets(_logical_device, 1, &write, 0, nullptr);
+    return handle;
+}
+
+void BindlessHeap::remove(Binding binding, uint32_t handle)
+{
+    if(handle == INVALID_HANDLE)
+        return;
+
+    _pending_free.push_back({binding, handle, _frame_number});
+    _slots[binding].pending_count++;
+}
+
+void BindlessHeap::begin_frame(uint64_t frame_number)
+{
+    _frame_number = frame_number;
+
+    //frames that could have used the slot have finished (their fences were waited)
+    auto released = std::partition(begin(_pending_free), end(_pending_free), [&](const PendingFree &pending)
+    {
+        return pending.frame_number + _frames_in_flight > frame_number;
+    });
+    for(auto it = released; it != end(_pending_free); ++it)
+    {
+        _slots[it->binding].free.push_back(it->handle);
+        _slots[it->binding].pending_count--;
+    }
+    _pending_free.erase(released, end(_pending_free));
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "vk_utils.h"
+
+#include <array>
+#include <vector>
+
+//One global descriptor set with big arrays of images, samplers and storage buffers (descriptor indexing)
+//Resources are registered once and referred to by their slot (handle), shaders index the arrays
+//with handles from push constants, so a single set bind covers every draw of the frame
+class BindlessHeap
+{
+public:
+    enum Binding : uint32_t
+    {
+        SAMPLED_IMAGES = 0,
+        SAMPLERS = 1,
+        STORAGE_BUFFERS = 2,
+        BINDING_COUNT
+    };
+    static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+
+    BindlessHeap() = default;
+
+    //device must support descriptor indexing (see is_supported)
+    //frames_in_flight: freed slots are reused only after that many frames
+    void create(VkPhysicalDevice p_device, VkDevice l_device, uint32_t frames_in_flight);
+    void destroy();
+
+    //features create_logical_device has to enable (chained into VkPhysicalDeviceFeatures2)
+    static bool is_supported(const VkPhysicalDeviceDescriptorIndexingFeatures &features);
+    static void enable_features(VkPhysicalDeviceDescriptorIndexingFeatures &features);
+
+    VkDescriptorSetLayout get_layout() const { return _layout; }
+    VkDescriptorSet get_set() const { return _set; }
+    bool is_created() const { return _set != VK_NULL_HANDLE; }
+
+    //written right away (update after bind), even while the set is bound in recorded command buffers
+    uint32_t add_image(VkImageView image_view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t add_sampler(VkSampler sampler);
+    uint32_t add_storage_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    //slot is reused frames_in_flight frames later, GPU may still read it until then
+    void remove(Binding binding, uint32_t handle);
+
+    //once per frame: slots freed long enough ago go back to the free lists
+    void begin_frame(uint64_t frame_number);
+
+    uint32_t get_capacity(Binding binding) const { return _slots[binding].capacity; }
+    uint32_t get_used(Binding binding) const
+    {
+        return _slots[binding].next - static_cast<uint32_t>(_slots[binding].free.size()) - _slots[binding].pending_count;
+    }
+
+private:
+    struct Slots
+    {
+        uint32_t capacity = 0;
+        //slots [next, capacity) were never used
+        uint32_t next = 0;
+        std::vector<uint32_t> free;
+        uint32_t pending_count = 0;
+    };
+    struct PendingFree
+    {
+        Binding binding;
+        uint32_t handle;
+        uint64_t frame_number;
+    };
+
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
+    VkDescriptorPool _pool = VK_NULL_HANDLE;
+    VkDescriptorSet _set = VK_NULL_HANDLE;
+    uint32_t _frames_in_flight = 0;
+    uint64_t _frame_number = 0;
+
+    std::array<Slots, BINDING_COUNT> _slots;
+    std::vector<PendingFree> _pending_free;
+
+    uint32_t allocate(Binding binding);
+};
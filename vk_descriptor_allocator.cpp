@@ -0,0 +1,195 @@
+#include "vk_descriptor_allocator.h"
+#include "hash_utils.h"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+    constexpr uint32_t FIRST_POOL_SETS = 64;
+    constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    //descriptors of each type per set in a pool, a rough guess what a set needs
+    constexpr std::array<std::pair<VkDescriptorType, float>, 6> POOL_RATIOS
+    {{
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f}
+    }};
+
+    uint64_t hash_writes(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite> &writes)
+    {
+        //field by field: Vulkan structs have padding
+        uint64_t h = hash_value(layout);
+        for(const DescriptorWrite &write : writes)
+        {
+            h = hash_combine(h, write.binding);
+            h = hash_combine(h, write.type);
+            h = hash_combine(h, hash_value(write.buffer_info.buffer));
+            h = hash_combine(h, write.buffer_info.offset);
+            h = hash_combine(h, write.buffer_info.range);
+            h = hash_combine(h, hash_value(write.image_info.sampler));
+            h = hash_combine(h, hash_value(write.image_info.imageView));
+            h = hash_combine(h, write.image_info.imageLayout);
+        }
+        return h;
+    }
+}
+
+bool DescriptorWrite::operator==(const DescriptorWrite &other) const
+{
+    return binding == other.binding && type == other.type
+        && buffer_info.buffer == other.buffer_info.buffer
+        && buffer_info.offset == other.buffer_info.offset
+        && buffer_info.range == other.buffer_info.range
+        && image_info.sampler == other.image_info.sampler
+        && image_info.imageView == other.image_info.imageView
+        && image_info.imageLayout == other.image_info.imageLayout;
+}
+
+void DescriptorAllocator::create(VkDevice l_device, uint32_t frames_in_flight)
+{
+    _logical_device = l_device;
+    _next_pool_sets = FIRST_POOL_SETS;
+    _chains.resize(frames_in_flight + 1);
+    _stats = {};
+}
+
+void DescriptorAllocator::destroy()
+{
+    for(PoolChain &chain : _chains)
+        for(VkDescriptorPool pool : chain.pools)
+            vkDestroyDescriptorPool(_logical_device, pool, nullptr);
+    _chains.clear();
+}
+
+VkDescriptorSet DescriptorAllocator::get_persistent(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite> &writes)
+{
+    return get(_chains.back(), layout, writes);
+}
+
+VkDescriptorSet DescriptorAllocator::get_transient(uint32_t frame, VkDescriptorSetLayout layout,
+                                                   const std::vector<DescriptorWrite> &writes)
+{
+    return get(_chains[frame], layout, writes);
+}
+
+void DescriptorAllocator::reset_frame(uint32_t frame)
+{
+    PoolChain &chain = _chains[frame];
+    if(chain.cache.empty())
+        return;
+
+    //all sets back at once, much cheaper than freeing them one by one
+    //pools are kept, so a steady frame allocates nothing new
+    for(size_t i = 0; i <= chain.current && i < chain.pools.size(); ++i)
+        vkResetDescriptorPool(_logical_device, chain.pools[i], 0);
+    chain.current = 0;
+    chain.cache.clear();
+    _stats.frame_resets++;
+}
+
+VkDescriptorSet DescriptorAllocator::get(PoolChain &chain, VkDescriptorSetLayout layout,
+                                         const std::vector<DescriptorWrite> &writes)
+{
+    _stats.requests++;
+
+    const uint64_t key = hash_writes(layout, writes);
+    std::vector<CachedSet> &bucket = chain.cache[key];
+    for(const CachedSet &cached : bucket)
+    {
+        if(cached.layout == layout && cached.writes == writes)
+        {
+            _stats.cache_hits++;
+            return cached.set;
+        }
+    }
+
+    VkDescriptorSet set = allocate(chain, layout);
+
+    std::vector<VkWriteDescriptorSet> set_writes;
+    set_writes.reserve(writes.size());
+    for(const DescriptorWrite &write : writes)
+    {
+        const bool is_image = write.image_info.imageView != VK_NULL_HANDLE || write.image_info.sampler != VK_NULL_HANDLE;
+        set_writes.push_back(
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = write.binding,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = write.type,
+            .pImageInfo = is_image ? &write.image_info : nullptr,
+            .pBufferInfo = is_image ? nullptr : &write.buffer_info
+        });
+    }
+    vkUpdateDescriptorSets(_logical_device, static_cast<uint32_t>(set_writes.size()), set_writes.data(), 0, nullptr);
+
+    bucket.push_back({layout, writes, set});
+    return set;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(PoolChain &chain, VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo allocate_info
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout
+    };
+
+    //try the current pool, when it is full move on to the next (new one if there is none)
+    for(;;)
+    {
+        const bool fresh_pool = chain.current == chain.pools.size();
+        if(fresh_pool)
+            chain.pools.push_back(create_pool());
+
+        allocate_info.descriptorPool = chain.pools[chain.current];
+        VkDescriptorSet set;
+        VkResult res = vkAllocateDescriptorSets(_logical_device, &allocate_info, &set);
+        if(res == VK_SUCCESS)
+        {
+            _stats.allocations++;
+            return set;
+        }
+        if(res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL)
+            throw std::runtime_error("Failed to allocate Descriptor Set!");
+
+        //an empty pool that can`t fit one set, next ones won`t either
+        if(fresh_pool)
+            throw std::runtime_error("Descriptor set doesn`t fit into a descriptor pool!");
+        chain.current++;
+    }
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool()
+{
+    const uint32_t max_sets = _next_pool_sets;
+    _next_pool_sets = std::min(_next_pool_sets * 2, MAX_SETS_PER_POOL);
+
+    std::vector<VkDescriptorPoolSize> pool_sizes;
+    for(const auto &[type, ratio] : POOL_RATIOS)
+        pool_sizes.push_back({type, std::max(1u, uint32_t(ratio * float(max_sets)))});
+
+    VkDescriptorPoolCreateInfo create_info
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = max_sets,
+        .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+        .pPoolSizes = pool_sizes.data(),
+    };
+
+    VkDescriptorPool pool;
+    VkResult res = vkCreateDescriptorPool(_logical_device, &create_info, nullptr, &pool);
+    if(res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create Descriptor Pool!");
+    }
+    _stats.pools++;
+    return pool;
+}
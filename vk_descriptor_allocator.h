@@ -0,0 +1,89 @@
+#pragma once
+
+#include "vk_utils.h"
+
+#include <unordered_map>
+#include <vector>
+
+//One binding of a descriptor set write (buffer or image)
+struct DescriptorWrite
+{
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    VkDescriptorBufferInfo buffer_info{};
+    VkDescriptorImageInfo image_info{};
+
+    static DescriptorWrite buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+                                  VkDeviceSize offset, VkDeviceSize range)
+    {
+        return {.binding = binding, .type = type, .buffer_info = {buffer, offset, range}};
+    }
+    static DescriptorWrite image(uint32_t binding, VkDescriptorType type, VkImageView view,
+                                 VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+    {
+        return {.binding = binding, .type = type, .image_info = {sampler, view, layout}};
+    }
+
+    bool operator==(const DescriptorWrite &other) const;
+};
+
+//Descriptor sets from chains of pools that grow when they run out
+//Transient sets live for one frame in flight: their pools are reset (vkResetDescriptorPool) once the frame fence
+//is waited. Sets with the same layout + writes are reused instead of being allocated and written again
+class DescriptorAllocator
+{
+public:
+    struct Stats
+    {
+        //sets handed out (including reused ones)
+        uint64_t requests = 0;
+        //vkAllocateDescriptorSets + vkUpdateDescriptorSets skipped
+        uint64_t cache_hits = 0;
+        uint64_t allocations = 0;
+        uint32_t pools = 0;
+        uint64_t frame_resets = 0;
+    };
+
+    DescriptorAllocator() = default;
+
+    void create(VkDevice l_device, uint32_t frames_in_flight);
+    void destroy();
+
+    //sets that live until destroy
+    VkDescriptorSet get_persistent(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite> &writes);
+    //sets valid until reset_frame(frame)
+    VkDescriptorSet get_transient(uint32_t frame, VkDescriptorSetLayout layout, const std::vector<DescriptorWrite> &writes);
+
+    //fence of the frame has signaled: its sets are not used by the GPU anymore
+    void reset_frame(uint32_t frame);
+
+    const Stats& get_stats() const { return _stats; }
+
+private:
+    struct CachedSet
+    {
+        VkDescriptorSetLayout layout;
+        std::vector<DescriptorWrite> writes;
+        VkDescriptorSet set;
+    };
+
+    //pools of one frame (or the persistent ones)
+    struct PoolChain
+    {
+        //pool new sets come from, full pools are before it
+        std::vector<VkDescriptorPool> pools;
+        size_t current = 0;
+        std::unordered_map<uint64_t, std::vector<CachedSet>> cache;
+    };
+
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    //frames in flight + the persistent chain at the back
+    std::vector<PoolChain> _chains;
+    //every new pool is bigger, up to MAX_SETS_PER_POOL
+    uint32_t _next_pool_sets = 0;
+    Stats _stats;
+
+    VkDescriptorSet get(PoolChain &chain, VkDescriptorSetLayout layout, const std::vector<DescriptorWrite> &writes);
+    VkDescriptorSet allocate(PoolChain &chain, VkDescriptorSetLayout layout);
+    VkDescriptorPool create_pool();
+};
@@ -0,0 +1,94 @@
+#include "vk_geometry_registry.h"
+#include "hash_utils.h"
+#include "profiler.h"
+
+#include <cstring>
+
+void GeometryRegistry::create(VkPhysicalDevice p_device, VkDevice l_device, VkQueue queue, VkCommandPool command_pool)
+{
+    _physical_device = p_device;
+    _logical_device = l_device;
+    _queue = queue;
+    _command_pool = command_pool;
+}
+
+void GeometryRegistry::destroy()
+{
+    for(auto &[hash, entry] : _by_content)
+    {
+        vkDestroyBuffer(_logical_device, entry.buffer, nullptr);
+        vkFreeMemory(_logical_device, entry.memory, nullptr);
+    }
+    _by_content.clear();
+    _by_buffer.clear();
+    _stats = {};
+}
+
+VkBuffer GeometryRegistry::acquire(const void *data, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    PROFILE_ZONE("geometry acquire");
+    ++_stats.requests;
+
+    //XXH64 runs at memory speed, far cheaper than the upload it can save, even twice
+    //a mesh drawn with another mesh`s geometry is worse than a missed share, so a hit has to match
+    //the second hash too (128 bits in total)
+    const uint64_t check = hash_bytes(data, size_t(size), CHECK_SEED);
+    uint64_t hash = hash_bytes(data, size_t(size));
+    hash = hash_combine(hash_combine(hash, size), usage);
+    for(auto it = _by_content.find(hash); it != _by_content.end(); it = _by_content.find(hash))
+    {
+        Entry &entry = it->second;
+        if(entry.size == size && entry.usage == usage && entry.check == check)
+        {
+#ifndef NDEBUG
+            if(size > 0 && std::memcmp(entry.content.data(), data, size_t(size)) != 0)
+                throw std::runtime_error("Geometry registry: different streams have the same 128 bit hash!");
+#endif
+            ++entry.references;
+            ++_stats.shared;
+            _stats.deduplicated_bytes += size;
+            return entry.buffer;
+        }
+        //another stream has this key: probe the next one
+        //(after a release opens a gap in the chain, a later equal stream may just not be shared)
+        hash = hash_combine(hash, 1);
+    }
+
+    //empty streams still get a (minimal) buffer, so every mesh has one to bind
+    Entry entry{.size = size, .usage = usage, .check = check, .references = 1};
+#ifndef NDEBUG
+    entry.content.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+#endif
+    create_buffer(_physical_device, _logical_device, std::max<VkDeviceSize>(size, 4),
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  &entry.buffer, &entry.memory);
+    if(size > 0)
+        upload_to_buffer(_physical_device, _logical_device, _queue, _command_pool, data, size, entry.buffer);
+
+    const VkBuffer buffer = entry.buffer;
+    _by_buffer.emplace(buffer, hash);
+    _by_content.emplace(hash, std::move(entry));
+    ++_stats.buffers;
+    _stats.buffer_bytes += size;
+    _stats.uploaded_bytes += size;
+    return buffer;
+}
+
+void GeometryRegistry::release(VkBuffer buffer)
+{
+    auto found = _by_buffer.find(buffer);
+    if(found == _by_buffer.end())
+        throw std::runtime_error("Failed to release a geometry buffer: it isn`t in the registry!");
+
+    auto it = _by_content.find(found->second);
+    Entry &entry = it->second;
+    if(--entry.references > 0)
+        return;
+
+    vkDestroyBuffer(_logical_device, entry.buffer, nullptr);
+    vkFreeMemory(_logical_device, entry.memory, nullptr);
+    --_stats.buffers;
+    _stats.buffer_bytes -= entry.size;
+    _by_content.erase(it);
+    _by_buffer.erase(found);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vk_utils.h"
+
+#include <unordered_map>
+#include <vector>
+
+//Device buffers of vertex / index streams, shared by content
+//Streams are keyed by a hash of their bytes (with size and usage), so meshes built from the same data
+//(instanced props, kitbashed parts, quads with the same indices) use one allocation and it is uploaded once.
+//A hit is shared only if size, usage and a second hash of the bytes match too (debug builds compare the bytes).
+//Buffers are refcounted: every acquire is matched by a release, the last one frees the buffer.
+class GeometryRegistry
+{
+public:
+    struct Stats
+    {
+        //acquire calls, and how many of them got an existing buffer
+        uint64_t requests = 0;
+        uint64_t shared = 0;
+        uint32_t buffers = 0;
+        //device memory of all buffers, bytes uploaded since create
+        uint64_t buffer_bytes = 0;
+        uint64_t uploaded_bytes = 0;
+        //bytes acquired but not uploaded or allocated again (served by an existing buffer)
+        uint64_t deduplicated_bytes = 0;
+    };
+
+    GeometryRegistry() = default;
+
+    //uploads go through queue with one time commands of command_pool
+    void create(VkPhysicalDevice p_device, VkDevice l_device, VkQueue queue, VkCommandPool command_pool);
+    //frees all buffers, acquired ones too (device has to be idle)
+    void destroy();
+
+    //device local buffer with this content: an existing one (one more reference) or a new upload
+    //usage -- VERTEX_BUFFER / INDEX_BUFFER, TRANSFER_DST is added
+    VkBuffer acquire(const void *data, VkDeviceSize size, VkBufferUsageFlags usage);
+    //one reference less, the buffer is freed with the last one (the GPU must be done with it)
+    void release(VkBuffer buffer);
+
+    const Stats& get_stats() const { return _stats; }
+
+private:
+    //seed of the second hash, with the key it makes a 128 bit fingerprint
+    static constexpr uint64_t CHECK_SEED = 0x9E3779B97F4A7C15ull;
+
+    struct Entry
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkBufferUsageFlags usage = 0;
+        uint64_t check = 0;
+        uint32_t references = 0;
+#ifndef NDEBUG
+        std::vector<uint8_t> content;
+#endif
+    };
+
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    VkCommandPool _command_pool = VK_NULL_HANDLE;
+
+    //content hash -> buffer, buffer -> content hash (for release)
+    //a stream colliding with another one is stored under the next free key (see acquire)
+    std::unordered_map<uint64_t, Entry> _by_content;
+    std::unordered_map<VkBuffer, uint64_t> _by_buffer;
+    Stats _stats;
+};
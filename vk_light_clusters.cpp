@@ -0,0 +1,208 @@
+#include "vk_light_clusters.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+void LightClusters::create(VkPhysicalDevice p_device, VkDevice l_device, VkPipelineCache pipeline_cache,
+                           uint32_t frames_in_flight, bool binning_supported)
+{
+    _logical_device = l_device;
+
+    //light data is rewritten every frame: device local + host visible if there is such memory (like UniformRing)
+    VkMemoryPropertyFlags light_memory_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if(is_memory_type_supported(p_device, light_memory_flags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+        light_memory_flags |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    _frames.resize(frames_in_flight);
+    for(Frame &frame : _frames)
+    {
+        create_buffer(p_device, l_device, get_light_buffer_size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      light_memory_flags, &frame.light_buffer, &frame.light_memory);
+        vkMapMemory(l_device, frame.light_memory, 0, get_light_buffer_size(), 0,
+                    reinterpret_cast<void**>(&frame.light_mapped));
+        //header with no lights until the first update: shaders read only the ambient term
+        LightHeader header{};
+        header.ambient = glm::vec4(1.f);
+        std::memcpy(frame.light_mapped, &header, sizeof(header));
+
+        //written and read only by the GPU
+        create_buffer(p_device, l_device, get_cluster_buffer_size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame.cluster_buffer, &frame.cluster_memory);
+    }
+
+    if(binning_supported)
+        create_pipeline(pipeline_cache);
+}
+
+void LightClusters::destroy()
+{
+    for(Frame &frame : _frames)
+    {
+        vkUnmapMemory(_logical_device, frame.light_memory);
+        vkDestroyBuffer(_logical_device, frame.light_buffer, nullptr);
+        vkFreeMemory(_logical_device, frame.light_memory, nullptr);
+        vkDestroyBuffer(_logical_device, frame.cluster_buffer, nullptr);
+        vkFreeMemory(_logical_device, frame.cluster_memory, nullptr);
+    }
+    _frames.clear();
+
+    if(_pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(_logical_device, _pipeline, nullptr);
+    if(_pipeline_layout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(_logical_device, _pipeline_layout, nullptr);
+    if(_set_layout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(_logical_device, _set_layout, nullptr);
+    _pipeline = VK_NULL_HANDLE;
+    _pipeline_layout = VK_NULL_HANDLE;
+    _set_layout = VK_NULL_HANDLE;
+}
+
+void LightClusters::update(uint32_t frame, const std::vector<Light> &lights, glm::vec3 ambient,
+                           const glm::mat4 &view, const glm::mat4 &projection, VkExtent2D render_extent)
+{
+    //without binning the lists are never written, lights are ignored
+    _light_count = is_binning_supported() ? uint32_t(std::min<size_t>(lights.size(), MAX_LIGHTS)) : 0;
+
+    //near / far from the perspective projection (depth zero to one, right handed)
+    const float z_near = projection[3][2] / projection[2][2];
+    const float z_far = projection[3][2] / (projection[2][2] + 1.f);
+    //exponential slices: slice k starts at near * (far / near)^(k / GRID_Z)
+    const float log_range = std::log(z_far / z_near);
+
+    LightHeader header
+    {
+        .grid = {GRID_X, GRID_Y, GRID_Z, _light_count},
+        .z_params = {float(GRID_Z) / log_range, -float(GRID_Z) * std::log(z_near) / log_range, z_near, z_far},
+        .tile = {std::ceil(float(render_extent.width) / float(GRID_X)), std::ceil(float(render_extent.height) / float(GRID_Y)),
+                 1.f / float(render_extent.width), 1.f / float(render_extent.height)},
+        .ambient = glm::vec4(ambient, 1.f),
+        .inverse_projection = glm::inverse(projection)
+    };
+    uint8_t *mapped = _frames[frame].light_mapped;
+    std::memcpy(mapped, &header, sizeof(header));
+
+    //clusters are in view space, so are the lights (once here instead of in every workgroup)
+    GpuLight *gpu_lights = reinterpret_cast<GpuLight*>(mapped + LIGHT_HEADER_SIZE);
+    for(uint32_t i = 0; i < _light_count; ++i)
+    {
+        const Light &light = lights[i];
+        const glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.f));
+        const glm::vec3 direction = glm::normalize(glm::vec3(view * glm::vec4(light.direction, 0.f)));
+        gpu_lights[i] =
+        {
+            .position_radius = glm::vec4(position, light.radius),
+            .color_intensity = glm::vec4(light.color, light.intensity),
+            .direction_cos_outer = glm::vec4(direction, light.spot_cos_outer),
+            //smoothstep needs inner > outer
+            .cos_inner = glm::vec4(std::max(light.spot_cos_inner, light.spot_cos_outer + 1e-4f), 0.f, 0.f, 0.f)
+        };
+    }
+}
+
+void LightClusters::record_binning(VkCommandBuffer command_buffer, uint32_t frame, DescriptorAllocator &descriptors)
+{
+    //no lights -- lists aren`t read
+    if(_light_count == 0)
+        return;
+
+    //same buffers every time the frame comes around, so the set is a cache hit
+    VkDescriptorSet set = descriptors.get_transient(frame, _set_layout,
+    {
+        DescriptorWrite::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[frame].light_buffer, 0, get_light_buffer_size()),
+        DescriptorWrite::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[frame].cluster_buffer, 0, get_cluster_buffer_size())
+    });
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline_layout, 0, 1, &set, 0, nullptr);
+    //one workgroup per cluster
+    vkCmdDispatch(command_buffer, GRID_X, GRID_Y, GRID_Z);
+
+    //lists are complete before any fragment reads them
+    //(previous reads of this frame`s lists finished with its fence)
+    VkBufferMemoryBarrier lists_ready
+    {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = _frames[frame].cluster_buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 1, &lists_ready, 0, nullptr);
+}
+
+void LightClusters::create_pipeline(VkPipelineCache pipeline_cache)
+{
+    //0 -- light data, 1 -- cluster lists
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    for(uint32_t i = 0; i < bindings.size(); ++i)
+        bindings[i] =
+        {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        };
+
+    VkDescriptorSetLayoutCreateInfo set_layout_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data()
+    };
+    VkResult res = vkCreateDescriptorSetLayout(_logical_device, &set_layout_createinfo, nullptr, &_set_layout);
+    if(res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create a light cluster descriptor set layout!");
+    }
+
+    VkPipelineLayoutCreateInfo layout_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &_set_layout
+    };
+    res = vkCreatePipelineLayout(_logical_device, &layout_createinfo, nullptr, &_pipeline_layout);
+    if(res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create a light cluster pipeline layout!");
+    }
+
+    //a missing or broken shader isn`t fatal: _pipeline stays null and lighting falls back to ambient only
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+    try
+    {
+        shader_module = load_shader_module(_logical_device, "shaders/light_cluster.spv");
+    }
+    catch(std::runtime_error &e)
+    {
+        std::cerr << e.what() << "\n";
+        std::cerr << "Light binning disabled, only ambient light is applied\n";
+        return;
+    }
+
+    VkComputePipelineCreateInfo pipeline_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage =
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module,
+            .pName = "main"
+        },
+        .layout = _pipeline_layout
+    };
+    res = vkCreateComputePipelines(_logical_device, pipeline_cache, 1, &pipeline_createinfo, nullptr, &_pipeline);
+    vkDestroyShaderModule(_logical_device, shader_module, nullptr);
+    if(res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create the light cluster pipeline!");
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "vk_utils.h"
+#include "vk_descriptor_allocator.h"
+
+#include <vector>
+
+//Dynamic point / spot light (world space)
+struct Light
+{
+    glm::vec3 position{0.f};
+    //no light beyond it (the clusters it is binned into)
+    float radius = 1.f;
+    glm::vec3 color{1.f};
+    float intensity = 1.f;
+    //spot lights: where the cone points, cosines of the cone angles
+    //spot_cos_outer -1 -- point light
+    glm::vec3 direction{0.f, 0.f, -1.f};
+    float spot_cos_outer = -1.f;
+    float spot_cos_inner = -1.f;
+};
+
+//Clustered forward lighting
+//The view frustum is split into a GRID_X * GRID_Y * GRID_Z grid (screen tiles, exponential depth slices);
+//a compute pass bins lights into the clusters their sphere touches, and the fragment shader loops only over
+//the list of its cluster. Per fragment cost follows lights per cluster, not lights in the scene.
+//Light data and lists are per frame in flight, light data is written by the CPU every frame (view space).
+class LightClusters
+{
+public:
+    static constexpr uint32_t GRID_X = 16;
+    static constexpr uint32_t GRID_Y = 9;
+    static constexpr uint32_t GRID_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    //lights past it are dropped from the cluster (shaders/light_cluster.comp and clustered_lighting.glsl match)
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 127;
+    static constexpr uint32_t MAX_LIGHTS = 16384;
+
+    LightClusters() = default;
+
+    //binning_supported -- the graphics queue can run compute, otherwise only ambient light is applied
+    //(same without shaders/light_cluster.spv, see is_binning_supported)
+    void create(VkPhysicalDevice p_device, VkDevice l_device, VkPipelineCache pipeline_cache,
+                uint32_t frames_in_flight, bool binning_supported);
+    void destroy();
+
+    //light data of the frame for the camera and the rendered size (after its fence was waited)
+    void update(uint32_t frame, const std::vector<Light> &lights, glm::vec3 ambient,
+                const glm::mat4 &view, const glm::mat4 &projection, VkExtent2D render_extent);
+    //compute pass filling the cluster lists, outside of the render pass that reads them
+    void record_binning(VkCommandBuffer command_buffer, uint32_t frame, DescriptorAllocator &descriptors);
+
+    VkBuffer get_light_buffer(uint32_t frame) const { return _frames[frame].light_buffer; }
+    VkBuffer get_cluster_buffer(uint32_t frame) const { return _frames[frame].cluster_buffer; }
+    VkDeviceSize get_light_buffer_size() const { return LIGHT_HEADER_SIZE + sizeof(GpuLight) * MAX_LIGHTS; }
+    VkDeviceSize get_cluster_buffer_size() const { return sizeof(uint32_t) * (MAX_LIGHTS_PER_CLUSTER + 1) * CLUSTER_COUNT; }
+    //lights binned in the last updated frame
+    uint32_t get_light_count() const { return _light_count; }
+    bool is_binning_supported() const { return _pipeline != VK_NULL_HANDLE; }
+
+private:
+    //std430 layouts of the shaders
+    struct LightHeader
+    {
+        //GRID_X, GRID_Y, GRID_Z, light count
+        glm::uvec4 grid;
+        //slice = log(depth) * x + y, near, far
+        glm::vec4 z_params;
+        //tile size in pixels, 1 / rendered size
+        glm::vec4 tile;
+        glm::vec4 ambient;
+        glm::mat4 inverse_projection;
+    };
+    static constexpr VkDeviceSize LIGHT_HEADER_SIZE = sizeof(LightHeader);
+    struct GpuLight
+    {
+        //view space
+        glm::vec4 position_radius;
+        glm::vec4 color_intensity;
+        glm::vec4 direction_cos_outer;
+        glm::vec4 cos_inner;
+    };
+    static_assert(sizeof(LightHeader) == 128 && sizeof(GpuLight) == 64, "Must match the shader light buffer");
+
+    struct Frame
+    {
+        VkBuffer light_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory light_memory = VK_NULL_HANDLE;
+        uint8_t *light_mapped = nullptr;
+        VkBuffer cluster_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory cluster_memory = VK_NULL_HANDLE;
+    };
+
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    std::vector<Frame> _frames;
+    uint32_t _light_count = 0;
+
+    //binning compute pipeline, VK_NULL_HANDLE if not supported
+    VkDescriptorSetLayout _set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout _pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline _pipeline = VK_NULL_HANDLE;
+
+    void create_pipeline(VkPipelineCache pipeline_cache);
+};
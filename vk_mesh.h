@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vk_utils.h"
+#include "vk_geometry_registry.h"
 
 struct Model
 {
@@ -8,45 +9,104 @@ struct Model
 	glm::mat4 model;
 };
 
+//BindlessHeap slots a draw reads from (indices into the heap arrays)
+struct DrawHandles
+{
+	uint32_t material_buffer = UINT32_MAX;
+	uint32_t material = 0;
+	uint32_t texture = UINT32_MAX;
+	uint32_t sampler = UINT32_MAX;
+};
+
+//push constant block: bindless handles for the fragment stage
+//(model is a dynamic uniform, see UniformRing)
+struct PushConstants
+{
+	DrawHandles handles;
+};
+
 class Mesh
 {
 public:
 	Mesh() = default;
+	//vertex and index buffers come from the registry: streams some other mesh already has are shared, not uploaded
+	Mesh(VkPhysicalDevice p_device, VkDevice l_device, GeometryRegistry &geometry,
+		 const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+	//draw of a range of buffers owned by someone else (e.g. all geometry of a mesh file in one buffer)
 	Mesh(VkPhysicalDevice p_device, VkDevice l_device,
-		 VkQueue transfer_queue, VkCommandPool command_pool,
-		 std::vector<Vertex> &vertices, std::vector<uint32_t> indices);
+		 VkBuffer vertex_buffer, int32_t vertex_offset, uint32_t vertex_count,
+		 VkBuffer index_buffer, uint32_t first_index, uint32_t index_count);
+	//another draw of the same geometry: shares GPU buffers, has its own model
+	Mesh make_instance() const
+	{
+		Mesh instance = *this;
+		instance._owns_buffers = false;
+		return instance;
+	}
+
 	void destroy_buffers()
 	{
-		vkDestroyBuffer(_logical_device, _vertex_buffer, nullptr);
-		vkFreeMemory(_logical_device, _vertex_buffer_memory, nullptr);
-		vkDestroyBuffer(_logical_device, _index_buffer, nullptr);
-		vkFreeMemory(_logical_device, _index_buffer_memory, nullptr);
+		//buffers belong to the mesh the instance was made from
+		if(!_owns_buffers)
+			return;
+
+		//registry frees them once no other mesh uses the same data
+		_geometry->release(_vertex_buffer);
+		_geometry->release(_index_buffer);
+	}
+
+	//points a mesh that doesn`t own its buffers at other geometry (e.g. streamed data replacing a coarser LOD)
+	void set_geometry(VkBuffer vertex_buffer, int32_t vertex_offset, uint32_t vertex_count,
+					  VkBuffer index_buffer, uint32_t first_index, uint32_t index_count)
+	{
+		_vertex_buffer = vertex_buffer;
+		_vertex_offset = vertex_offset;
+		_vertex_count = vertex_count;
+		_index_buffer = index_buffer;
+		_first_index = first_index;
+		_index_count = index_count;
 	}
 
 	uint32_t get_vertex_count() { return _vertex_count; }
 	VkBuffer get_vertex_buffer() { return _vertex_buffer; }
 	uint32_t get_index_count() { return _index_count; }
 	VkBuffer get_index_buffer() { return _index_buffer; }
+	//vertexOffset and firstIndex of the indexed draw
+	int32_t get_vertex_offset() const { return _vertex_offset; }
+	uint32_t get_first_index() const { return _first_index; }
 
 	void set_model(glm::mat4 m) { _model.model = m; }
 	const Model& get_model() { return _model; }
 
+	void set_draw_handles(const DrawHandles &handles) { _handles = handles; }
+	const DrawHandles& get_draw_handles() const { return _handles; }
+
+	//PipelineLibrary key, 0 -- default pipeline
+	void set_pipeline_key(uint64_t key) { _pipeline_key = key; }
+	uint64_t get_pipeline_key() const { return _pipeline_key; }
+	//render queue of the mesh (from PipelineDesc::transparent of its variant)
+	void set_transparent(bool transparent) { _transparent = transparent; }
+	bool is_transparent() const { return _transparent; }
+
 
 private:
 	//each mesh holds its position in the world
 	Model _model;
+	DrawHandles _handles;
+	uint64_t _pipeline_key = 0;
+	bool _transparent = false;
 
 	VkPhysicalDevice _physical_device;
 	VkDevice _logical_device;
+	//holds a reference to both buffers in _geometry
+	bool _owns_buffers = true;
+	GeometryRegistry *_geometry = nullptr;
 
 	uint32_t _vertex_count;
+	int32_t _vertex_offset = 0;
 	VkBuffer _vertex_buffer;
-	VkDeviceMemory _vertex_buffer_memory;
 	uint32_t _index_count;
+	uint32_t _first_index = 0;
 	VkBuffer _index_buffer;
-	VkDeviceMemory _index_buffer_memory;
-
-	void create_vertex_buffer(std::vector<Vertex> &vertices, VkQueue transfer_queue, VkCommandPool command_pool);
-	void create_index_buffer(std::vector<uint32_t> &indices, VkQueue transfer_queue, VkCommandPool command_pool);
 };
 
@@ -0,0 +1,465 @@
+#include "vk_mesh_streamer.h"
+#include "geometry_codec.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+void MeshStreamer::create(VkPhysicalDevice p_device, VkDevice l_device, uint32_t frames_in_flight,
+                          VkDeviceSize budget_per_frame, VkDeviceSize staging_size, uint32_t io_threads)
+{
+    _physical_device = p_device;
+    _logical_device = l_device;
+    _frames_in_flight = frames_in_flight;
+    _staging_size = staging_size;
+    set_budget(budget_per_frame);
+
+    //written by the CPU while the frame is recorded, stays mapped
+    //(a frame`s staging is reused once its fence was waited)
+    _staging.resize(frames_in_flight);
+    for(StagingBuffer &staging : _staging)
+    {
+        create_buffer(p_device, l_device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      &staging.buffer, &staging.memory);
+        vkMapMemory(l_device, staging.memory, 0, staging_size, 0, reinterpret_cast<void**>(&staging.mapped));
+    }
+    //first block now, not in the frame the first mesh arrives
+    add_block(BLOCK_SIZE);
+
+    _stopping = false;
+    for(uint32_t i = 0; i < std::max(io_threads, 1u); ++i)
+        _io_threads.emplace_back(&MeshStreamer::io_thread, this);
+}
+
+void MeshStreamer::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _work_ready.notify_all();
+    for(std::thread &thread : _io_threads)
+        thread.join();
+    _io_threads.clear();
+    _loads.clear();
+    _ready.clear();
+    _priorities.clear();
+    _ready_bytes = 0;
+
+    for(Result &upload : _uploads)
+        free_geometry(upload.geometry);
+    _uploads.clear();
+    for(Retired &retired : _retired)
+        free_geometry(retired.geometry);
+    _retired.clear();
+    for(Entry &entry : _entries)
+        free_geometry(entry.geometry);
+    _entries.clear();
+    _entry_by_model.clear();
+    _files.clear();
+    for(Block &block : _blocks)
+    {
+        vkDestroyBuffer(_logical_device, block.buffer, nullptr);
+        vkFreeMemory(_logical_device, block.memory, nullptr);
+    }
+    _blocks.clear();
+
+    for(StagingBuffer &staging : _staging)
+    {
+        vkUnmapMemory(_logical_device, staging.memory);
+        vkDestroyBuffer(_logical_device, staging.buffer, nullptr);
+        vkFreeMemory(_logical_device, staging.memory, nullptr);
+    }
+    _staging.clear();
+    _stats = {};
+}
+
+uint32_t MeshStreamer::open(const std::string &path)
+{
+    auto found = _files.find(path);
+    if(found == _files.end())
+    {
+        auto file = std::make_unique<StreamFile>();
+        //meshes are read in priority order, not front to back
+        file->file = MappedFile(path, MappedFile::Access::Random);
+        std::string error;
+        if(!parse_mesh_file(file->file.data(), file->file.size(), file->view, error))
+            throw std::runtime_error("Failed to stream the mesh file " + path + ": " + error);
+        if(file->view.vertex_stride != sizeof(Vertex))
+            throw std::runtime_error("Failed to stream the mesh file " + path + ": it was built for another vertex layout");
+        found = _files.emplace(path, std::move(file)).first;
+    }
+    return uint32_t(found->second->view.meshes.size());
+}
+
+void MeshStreamer::add(const std::string &path, uint32_t mesh_index, uint32_t model_id)
+{
+    if(mesh_index >= open(path))
+        throw std::runtime_error("Failed to stream the mesh file " + path + ": there is no mesh " + std::to_string(mesh_index));
+    const StreamFile *file = _files[path].get();
+    const mesh_file::MeshRecord &mesh = file->view.meshes[mesh_index];
+
+    const uint32_t entry = uint32_t(_entries.size());
+    _entries.push_back({file, mesh_index, model_id, {}, NOT_RESIDENT, {}});
+    _entry_by_model[model_id] = entry;
+    ++_stats.meshes;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        //unknown until the first update: everything is equally important
+        _priorities.push_back(0.f);
+        //nothing to draw
+        if(mesh.lod_count == 0)
+            return;
+        //coarsest LOD first, something is on screen soon without waiting for the full meshes
+        if(mesh.lod_count > 1)
+            _loads.push_back({entry, mesh.lod_count - 1, file, mesh_index});
+        _loads.push_back({entry, 0, file, mesh_index});
+    }
+    _work_ready.notify_all();
+}
+
+bool MeshStreamer::add_instance(uint32_t model_id, uint32_t instance_id)
+{
+    auto found = _entry_by_model.find(model_id);
+    if(found == _entry_by_model.end())
+        return false;
+
+    //instance of an instance belongs to the same entry
+    const uint32_t entry = found->second;
+    _entries[entry].instances.push_back(instance_id);
+    _entry_by_model[instance_id] = entry;
+    return true;
+}
+
+void MeshStreamer::update(VkCommandBuffer command_buffer, uint32_t frame, uint64_t frame_number, std::vector<Mesh> &meshes,
+                          const glm::mat4 &view, const glm::mat4 &projection, VkExtent2D render_extent)
+{
+    PROFILE_ZONE("mesh streaming");
+
+    //replaced frames_in_flight frames ago -- no frame the GPU may still run uses it
+    std::erase_if(_retired, [&](Retired &retired)
+    {
+        if(frame_number < retired.frame_number + _frames_in_flight)
+            return false;
+        free_geometry(retired.geometry);
+        return true;
+    });
+
+    //priority: radius of the bounding sphere on screen in pixels (camera inside it -- before everything else)
+    //of the biggest instance
+    const float pixels_per_unit = projection[1][1] * 0.5f * float(render_extent.height);
+    auto screen_radius = [&](const float *sphere, uint32_t model_id)
+    {
+        const glm::mat4 &model = meshes[model_id].get_model().model;
+        const glm::vec3 center = glm::vec3(view * model * glm::vec4(sphere[0], sphere[1], sphere[2], 1.f));
+        const float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+                                      glm::length(glm::vec3(model[2]))});
+        const float radius = sphere[3] * scale;
+        const float distance = glm::length(center);
+        return distance <= radius ? std::numeric_limits<float>::max() : radius / distance * pixels_per_unit;
+    };
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(uint32_t i = 0; i < _priorities.size(); ++i)
+        {
+            const Entry &entry = _entries[i];
+            if(entry.resident_level == 0)
+                continue;
+            const float *sphere = entry.file->view.meshes[entry.mesh_index].sphere;
+            _priorities[i] = screen_radius(sphere, entry.model_id);
+            for(uint32_t instance : entry.instances)
+                _priorities[i] = std::max(_priorities[i], screen_radius(sphere, instance));
+        }
+
+        for(Result &result : _ready)
+            _uploads.push_back(std::move(result));
+        _ready.clear();
+        _stats.pending_loads = uint32_t(_loads.size() + _uploads.size());
+    }
+    _stats.frame_uploaded_bytes = 0;
+    if(_uploads.empty())
+        return;
+
+    //same order as the loads: placeholders first, then what is biggest on screen
+    std::sort(_uploads.begin(), _uploads.end(), [&](const Result &a, const Result &b)
+    {
+        if((a.level != 0) != (b.level != 0))
+            return a.level != 0;
+        return _priorities[a.entry] > _priorities[b.entry];
+    });
+
+    //budget of copies per frame, the rest continues in the next frames
+    const StagingBuffer &staging = _staging[frame];
+    VkDeviceSize staged = 0;
+    for(Result &upload : _uploads)
+    {
+        if(staged >= _budget)
+            break;
+        //empty mesh, complete as it is
+        if(upload.data.empty())
+            continue;
+
+        if(upload.geometry.block == NO_BLOCK)
+            upload.geometry = allocate_geometry(upload.data.size());
+
+        const VkDeviceSize size = std::min(upload.data.size() - upload.uploaded, _budget - staged);
+        std::memcpy(staging.mapped + staged, upload.data.data() + upload.uploaded, size);
+        VkBufferCopy region
+        {
+            .srcOffset = staged,
+            .dstOffset = upload.geometry.offset + upload.uploaded,
+            .size = size
+        };
+        vkCmdCopyBuffer(command_buffer, staging.buffer, _blocks[upload.geometry.block].buffer, 1, &region);
+        upload.uploaded += size;
+        //16 byte aligned copies are the fast path on most GPUs
+        staged = (staged + size + 15) & ~VkDeviceSize(15);
+    }
+    _stats.frame_uploaded_bytes = std::min(staged, _budget);
+    _stats.uploaded_bytes += _stats.frame_uploaded_bytes;
+
+    //copies are done before any draw of this frame reads the geometry
+    if(staged > 0)
+    {
+        VkMemoryBarrier copied
+        {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                             0, 1, &copied, 0, nullptr, 0, nullptr);
+    }
+
+    //complete ones are drawn from this frame on
+    uint64_t released_bytes = 0;
+    std::erase_if(_uploads, [&](Result &upload)
+    {
+        if(upload.uploaded < upload.data.size())
+            return false;
+
+        released_bytes += upload.data.size();
+        Entry &entry = _entries[upload.entry];
+        //finer LOD is already there (full mesh loaded before the coarse one)
+        if(upload.level >= entry.resident_level)
+        {
+            _retired.push_back({frame_number, upload.geometry});
+            return true;
+        }
+
+        if(entry.resident_level == NOT_RESIDENT)
+            ++(upload.level == 0 ? _stats.full_resident : _stats.coarse_resident);
+        else
+        {
+            --_stats.coarse_resident;
+            ++_stats.full_resident;
+        }
+        _stats.resident_bytes += upload.geometry.size - entry.geometry.size;
+        if(entry.geometry.block != NO_BLOCK)
+            _retired.push_back({frame_number, entry.geometry});
+        entry.geometry = upload.geometry;
+        entry.resident_level = upload.level;
+
+        //indices follow the vertices in the same range of the block
+        const VkBuffer buffer = _blocks[entry.geometry.block].buffer;
+        const int32_t vertex_offset = int32_t(entry.geometry.offset / sizeof(Vertex));
+        const uint32_t first_index = uint32_t((entry.geometry.offset + VkDeviceSize(upload.vertex_count) * sizeof(Vertex)) /
+                                              sizeof(uint32_t));
+        meshes[entry.model_id].set_geometry(buffer, vertex_offset, upload.vertex_count, buffer, first_index, upload.index_count);
+        for(uint32_t instance : entry.instances)
+            meshes[instance].set_geometry(buffer, vertex_offset, upload.vertex_count, buffer, first_index, upload.index_count);
+        return true;
+    });
+
+    if(released_bytes > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ready_bytes -= released_bytes;
+        }
+        _work_ready.notify_all();
+    }
+}
+
+void MeshStreamer::io_thread()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true)
+    {
+        _work_ready.wait(lock, [this] { return _stopping || (!_loads.empty() && _ready_bytes < MAX_READY_BYTES); });
+        if(_stopping)
+            return;
+
+        //most important load right now (priorities change as the camera moves)
+        auto best = std::min_element(_loads.begin(), _loads.end(), [this](const Load &a, const Load &b)
+        {
+            if((a.level != 0) != (b.level != 0))
+                return a.level != 0;
+            return _priorities[a.entry] > _priorities[b.entry];
+        });
+        const Load job = *best;
+        *best = _loads.back();
+        _loads.pop_back();
+
+        lock.unlock();
+        Result result;
+        bool loaded = false;
+        try
+        {
+            result = load(job);
+            loaded = true;
+        }
+        catch(const std::exception &e)
+        {
+            //mesh stays as it is (coarse or not drawn)
+            std::cout << "Failed to stream mesh " << job.mesh_index << ": " << e.what() << std::endl;
+        }
+        lock.lock();
+
+        if(loaded)
+        {
+            _ready_bytes += result.data.size();
+            _ready.push_back(std::move(result));
+        }
+    }
+}
+
+MeshStreamer::Result MeshStreamer::load(const Load &job) const
+{
+    PROFILE_ZONE("mesh stream load");
+    const MeshFileView &view = job.file->view;
+    const mesh_file::MeshRecord &mesh = view.meshes[job.mesh_index];
+    const mesh_file::LodRecord &lod = view.lods[mesh.first_lod + job.level];
+    const size_t vertex_bytes = size_t(mesh.vertex_count) * sizeof(Vertex);
+    const size_t index_bytes = size_t(lod.index_count) * sizeof(uint32_t);
+
+    Result result
+    {
+        .entry = job.entry,
+        .level = job.level,
+        .vertex_count = mesh.vertex_count,
+        .index_count = lod.index_count
+    };
+
+    //full mesh: vertices and indices as they are in the file (decoded by this thread, others keep loading)
+    if(job.level == 0)
+    {
+        result.data.resize(vertex_bytes + index_bytes);
+        if(view.compressed)
+        {
+            decode_stream(view.vertex_stream, result.data.data(), uint64_t(mesh.vertex_offset) * sizeof(Vertex), vertex_bytes, 1);
+            decode_stream(view.index_stream, result.data.data() + vertex_bytes, uint64_t(lod.first_index) * sizeof(uint32_t),
+                          index_bytes, 1);
+        }
+        else
+        {
+            std::memcpy(result.data.data(), view.vertices.data() + size_t(mesh.vertex_offset) * sizeof(Vertex), vertex_bytes);
+            std::memcpy(result.data.data() + vertex_bytes, view.indices.data() + lod.first_index, index_bytes);
+        }
+        return result;
+    }
+
+    //coarse LOD: only the vertices its triangles use, in the order they are first used
+    std::vector<uint8_t> decoded_vertices;
+    std::vector<uint32_t> decoded_indices;
+    const uint8_t *vertices;
+    const uint32_t *indices;
+    if(view.compressed)
+    {
+        decoded_vertices.resize(vertex_bytes);
+        decoded_indices.resize(lod.index_count);
+        decode_stream(view.vertex_stream, decoded_vertices.data(), uint64_t(mesh.vertex_offset) * sizeof(Vertex), vertex_bytes, 1);
+        decode_stream(view.index_stream, reinterpret_cast<uint8_t*>(decoded_indices.data()),
+                      uint64_t(lod.first_index) * sizeof(uint32_t), index_bytes, 1);
+        vertices = decoded_vertices.data();
+        indices = decoded_indices.data();
+    }
+    else
+    {
+        vertices = view.vertices.data() + size_t(mesh.vertex_offset) * sizeof(Vertex);
+        indices = view.indices.data() + lod.first_index;
+    }
+
+    std::vector<uint32_t> remap(mesh.vertex_count, UINT32_MAX);
+    uint32_t used = 0;
+    for(uint32_t i = 0; i < lod.index_count; ++i)
+    {
+        //indices index the compacted vertices here, a bad one can`t be left to the GPU
+        if(indices[i] >= mesh.vertex_count)
+            throw std::runtime_error("index out of range");
+        if(remap[indices[i]] == UINT32_MAX)
+            remap[indices[i]] = used++;
+    }
+
+    result.vertex_count = used;
+    result.data.resize(size_t(used) * sizeof(Vertex) + index_bytes);
+    for(uint32_t v = 0; v < mesh.vertex_count; ++v)
+        if(remap[v] != UINT32_MAX)
+            std::memcpy(result.data.data() + size_t(remap[v]) * sizeof(Vertex), vertices + size_t(v) * sizeof(Vertex), sizeof(Vertex));
+    uint32_t *compact_indices = reinterpret_cast<uint32_t*>(result.data.data() + size_t(used) * sizeof(Vertex));
+    for(uint32_t i = 0; i < lod.index_count; ++i)
+        compact_indices[i] = remap[indices[i]];
+    return result;
+}
+
+void MeshStreamer::add_block(VkDeviceSize size)
+{
+    Block block;
+    create_buffer(_physical_device, _logical_device, size,
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &block.buffer, &block.memory);
+    block.free.push_back({0, size});
+    _blocks.push_back(std::move(block));
+    _stats.blocks = uint32_t(_blocks.size());
+}
+
+MeshStreamer::Geometry MeshStreamer::allocate_geometry(VkDeviceSize size)
+{
+    size = (size + GEOMETRY_ALIGNMENT - 1) / GEOMETRY_ALIGNMENT * GEOMETRY_ALIGNMENT;
+    //first fit, a new block only when no block has room (rarely, not once per mesh)
+    for(uint32_t b = 0; b <= _blocks.size(); ++b)
+    {
+        if(b == _blocks.size())
+            add_block(std::max(BLOCK_SIZE, size));
+
+        std::vector<Range> &free = _blocks[b].free;
+        auto range = std::find_if(free.begin(), free.end(), [size](const Range &range) { return range.size >= size; });
+        if(range == free.end())
+            continue;
+
+        Geometry geometry{b, range->offset, size};
+        range->offset += size;
+        range->size -= size;
+        if(range->size == 0)
+            free.erase(range);
+        return geometry;
+    }
+    return {};
+}
+
+void MeshStreamer::free_geometry(Geometry &geometry)
+{
+    if(geometry.block == NO_BLOCK)
+        return;
+
+    //back into the free list, merged with the ranges right before and after it
+    std::vector<Range> &free = _blocks[geometry.block].free;
+    auto next = std::lower_bound(free.begin(), free.end(), geometry.offset,
+                                 [](const Range &range, VkDeviceSize offset) { return range.offset < offset; });
+    auto range = free.insert(next, {geometry.offset, geometry.size});
+    if(range + 1 != free.end() && range->offset + range->size == (range + 1)->offset)
+    {
+        range->size += (range + 1)->size;
+        free.erase(range + 1);
+    }
+    if(range != free.begin() && (range - 1)->offset + (range - 1)->size == range->offset)
+    {
+        (range - 1)->size += range->size;
+        free.erase(range);
+    }
+    geometry = {};
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "vk_utils.h"
+#include "vk_mesh.h"
+#include "mapped_file.h"
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//Background streaming of mesh file geometry (see mesh_file.h)
+//Streamed meshes exist from the start but have no geometry (not drawn). I/O threads load their coarsest LOD
+//(only the vertices it uses) and then the full mesh, most important first: coarse LODs of everything before
+//any full mesh, then by the size of the mesh on screen. Loaded data is copied to the GPU in the command buffer
+//of a frame, no more than the budget per frame, so frame time stays flat while the world streams in.
+//Geometry is suballocated from a few large device-local blocks, a mesh becoming resident doesn`t allocate memory.
+class MeshStreamer
+{
+public:
+    struct Stats
+    {
+        //streamed meshes, meshes drawn at full detail / at a coarse LOD
+        uint32_t meshes = 0;
+        uint32_t full_resident = 0;
+        uint32_t coarse_resident = 0;
+        //loads waiting for an I/O thread or for upload budget
+        uint32_t pending_loads = 0;
+        //copied in the last updated frame, since create
+        uint64_t frame_uploaded_bytes = 0;
+        uint64_t uploaded_bytes = 0;
+        //device memory of resident geometry, blocks it is suballocated from
+        uint64_t resident_bytes = 0;
+        uint32_t blocks = 0;
+    };
+
+    MeshStreamer() = default;
+
+    //staging_size -- per frame in flight, the budget can`t be larger
+    void create(VkPhysicalDevice p_device, VkDevice l_device, uint32_t frames_in_flight,
+                VkDeviceSize budget_per_frame, VkDeviceSize staging_size, uint32_t io_threads = 2);
+    //stops the I/O threads and frees all geometry (device has to be idle)
+    void destroy();
+
+    //maps and checks a mesh file (once per path), returns how many meshes it has, throws if it can`t be used
+    uint32_t open(const std::string &path);
+    //stream mesh `mesh_index` of the file into the Mesh model_id (a mesh without geometry until then)
+    void add(const std::string &path, uint32_t mesh_index, uint32_t model_id);
+    //Mesh instance_id is an instance of model_id: it gets the same geometry on every LOD change
+    //returns false if model_id isn`t streamed (nothing to track)
+    bool add_instance(uint32_t model_id, uint32_t instance_id);
+
+    void set_budget(VkDeviceSize bytes_per_frame) { _budget = std::min(bytes_per_frame, _staging_size); }
+    VkDeviceSize get_budget() const { return _budget; }
+
+    //priorities for the camera, copies of loaded geometry within the budget (before the render pass),
+    //meshes whose data is complete are pointed at it, replaced data is freed frames_in_flight frames later
+    //call after the fence of `frame` was waited
+    void update(VkCommandBuffer command_buffer, uint32_t frame, uint64_t frame_number, std::vector<Mesh> &meshes,
+                const glm::mat4 &view, const glm::mat4 &projection, VkExtent2D render_extent);
+
+    const Stats& get_stats() const { return _stats; }
+
+private:
+    //loaded results held in memory before they are uploaded, I/O threads wait above it
+    static constexpr uint64_t MAX_READY_BYTES = 256ull << 20;
+    static constexpr uint32_t NOT_RESIDENT = UINT32_MAX;
+    //device memory allocation geometry is suballocated from (a bigger mesh gets a block of its own size)
+    static constexpr VkDeviceSize BLOCK_SIZE = 64ull << 20;
+    //offsets are whole vertices (vertexOffset of the draw) and 16 bytes (fast copies)
+    static constexpr VkDeviceSize GEOMETRY_ALIGNMENT = std::lcm(VkDeviceSize(sizeof(Vertex)), VkDeviceSize(16));
+    static constexpr uint32_t NO_BLOCK = UINT32_MAX;
+
+    struct StreamFile
+    {
+        MappedFile file;
+        MeshFileView view;
+    };
+
+    //vertices then indices in one range of a block
+    struct Geometry
+    {
+        uint32_t block = NO_BLOCK;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+    };
+
+    struct Range
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Block
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        //sorted by offset, neighbours are merged
+        std::vector<Range> free;
+    };
+
+    struct Entry
+    {
+        const StreamFile *file;
+        uint32_t mesh_index;
+        uint32_t model_id;
+        //instances of model_id, drawn with the same geometry
+        std::vector<uint32_t> instances;
+        //LOD drawn now (0 -- full detail), NOT_RESIDENT before the first one
+        uint32_t resident_level = NOT_RESIDENT;
+        Geometry geometry;
+    };
+
+    struct Load
+    {
+        uint32_t entry;
+        uint32_t level;
+        const StreamFile *file;
+        uint32_t mesh_index;
+    };
+
+    //loaded by an I/O thread, uploaded by update() over one or more frames
+    struct Result
+    {
+        uint32_t entry;
+        uint32_t level;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        std::vector<uint8_t> data;
+        Geometry geometry;
+        VkDeviceSize uploaded = 0;
+    };
+
+    struct Retired
+    {
+        uint64_t frame_number;
+        Geometry geometry;
+    };
+
+    struct StagingBuffer
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint8_t *mapped = nullptr;
+    };
+
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    uint32_t _frames_in_flight = 0;
+    VkDeviceSize _budget = 0;
+    VkDeviceSize _staging_size = 0;
+    std::vector<StagingBuffer> _staging;
+    std::vector<Block> _blocks;
+
+    std::unordered_map<std::string, std::unique_ptr<StreamFile>> _files;
+    //render thread only (I/O threads get the file and mesh of an entry with its Load)
+    std::vector<Entry> _entries;
+    //streamed meshes and their instances -> entry
+    std::unordered_map<uint32_t, uint32_t> _entry_by_model;
+    std::vector<Result> _uploads;
+    std::vector<Retired> _retired;
+    Stats _stats;
+
+    //shared with the I/O threads
+    std::mutex _mutex;
+    std::condition_variable _work_ready;
+    std::vector<Load> _loads;
+    std::vector<Result> _ready;
+    //per entry, written by update()
+    std::vector<float> _priorities;
+    uint64_t _ready_bytes = 0;
+    bool _stopping = false;
+    std::vector<std::thread> _io_threads;
+
+    void io_thread();
+    Result load(const Load &job) const;
+    void add_block(VkDeviceSize size);
+    Geometry allocate_geometry(VkDeviceSize size);
+    void free_geometry(Geometry &geometry);
+};
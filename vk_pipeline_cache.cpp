@@ -0,0 +1,235 @@
+#include "vk_pipeline_cache.h"
+#include "hash_utils.h"
+#include "mapped_file.h"
+#include "profiler.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+    //our own header in front of the driver blob:
+    //catches truncated / half written files before the driver sees them
+    struct CacheFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t data_size;
+        uint64_t data_hash;
+    };
+
+    constexpr uint32_t CACHE_FILE_MAGIC = 0x43504B56; //"VKPC"
+    constexpr uint32_t CACHE_FILE_VERSION = 1;
+
+    std::string cache_file_name(const VkPhysicalDeviceProperties &properties)
+    {
+        std::ostringstream name;
+        name << std::hex << std::setfill('0')
+             << std::setw(4) << properties.vendorID << "_"
+             << std::setw(4) << properties.deviceID << "_"
+             << std::setw(8) << properties.driverVersion << "_";
+        for(uint8_t byte : properties.pipelineCacheUUID)
+            name << std::setw(2) << uint32_t(byte);
+        name << ".bin";
+        return name.str();
+    }
+}
+
+void PipelineCacheStore::create(VkPhysicalDevice p_device, VkDevice l_device, const std::string &directory)
+{
+    _logical_device = l_device;
+    vkGetPhysicalDeviceProperties(p_device, &_device_properties);
+    _path = (std::filesystem::path(directory) / cache_file_name(_device_properties)).string();
+
+    std::vector<char> data;
+    _warm = load(data);
+    if(!_warm)
+        data.clear();
+
+    VkPipelineCacheCreateInfo cache_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.empty() ? nullptr : data.data()
+    };
+    VkResult res = vkCreatePipelineCache(_logical_device, &cache_createinfo, nullptr, &_cache);
+    if(res != VK_SUCCESS && _warm)
+    {
+        //driver still didn`t like it, start cold
+        std::cerr << "Pipeline cache " << _path << " rejected by the driver\n";
+        _warm = false;
+        cache_createinfo.initialDataSize = 0;
+        cache_createinfo.pInitialData = nullptr;
+        res = vkCreatePipelineCache(_logical_device, &cache_createinfo, nullptr, &_cache);
+    }
+    if(res != VK_SUCCESS)
+        throw std::runtime_error("Failed to create a pipeline cache!");
+
+    _saved_size = _warm ? data.size() : 0;
+    _last_save = std::chrono::steady_clock::now();
+}
+
+void PipelineCacheStore::destroy()
+{
+    if(_cache == VK_NULL_HANDLE)
+        return;
+
+    save();
+    vkDestroyPipelineCache(_logical_device, _cache, nullptr);
+    _cache = VK_NULL_HANDLE;
+}
+
+void PipelineCacheStore::save_periodically()
+{
+    const auto now = std::chrono::steady_clock::now();
+    //last one is still being written, next interval
+    if(now - _last_save < SAVE_INTERVAL || _writing)
+        return;
+    _last_save = now;
+    if(_writer.joinable())
+        _writer.join();
+
+    //only the size is queried here, data is fetched when there is something new
+    size_t size = 0;
+    if(vkGetPipelineCacheData(_logical_device, _cache, &size, nullptr) != VK_SUCCESS || size == _saved_size)
+        return;
+
+    //the driver copies its data out on this thread, hashing and file I/O don`t stall the frame
+    std::vector<char> data;
+    if(!fetch(data))
+        return;
+    _writing = true;
+    _writer = std::thread([this, data = std::move(data)]
+    {
+        write(data);
+        _writing = false;
+    });
+}
+
+bool PipelineCacheStore::save()
+{
+    PROFILE_ZONE("pipeline cache save");
+
+    if(_writer.joinable())
+        _writer.join();
+    std::vector<char> data;
+    return fetch(data) && write(data);
+}
+
+bool PipelineCacheStore::fetch(std::vector<char> &data) const
+{
+    size_t size = 0;
+    if(vkGetPipelineCacheData(_logical_device, _cache, &size, nullptr) != VK_SUCCESS || size == 0)
+        return false;
+    data.resize(size);
+    if(vkGetPipelineCacheData(_logical_device, _cache, &size, data.data()) != VK_SUCCESS)
+        return false;
+    data.resize(size);
+    return true;
+}
+
+bool PipelineCacheStore::write(const std::vector<char> &data)
+{
+    PROFILE_ZONE("pipeline cache write");
+
+    const CacheFileHeader header
+    {
+        .magic = CACHE_FILE_MAGIC,
+        .version = CACHE_FILE_VERSION,
+        .data_size = data.size(),
+        .data_hash = hash_bytes(data.data(), data.size())
+    };
+
+    std::error_code error;
+    const std::filesystem::path path(_path);
+    if(path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), error);
+
+    //unique per process: several render nodes may share the directory
+    const std::filesystem::path tmp_path = _path + ".tmp" + std::to_string(profiler::now_ns());
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), std::streamsize(data.size()));
+        if(!file.good())
+        {
+            file.close();
+            std::filesystem::remove(tmp_path, error);
+            std::cerr << "Failed to write pipeline cache " << tmp_path.string() << "\n";
+            return false;
+        }
+    }
+
+    //rename replaces the old file in one step
+    std::filesystem::rename(tmp_path, path, error);
+    if(error)
+    {
+        std::filesystem::remove(tmp_path, error);
+        std::cerr << "Failed to replace pipeline cache " << _path << "\n";
+        return false;
+    }
+
+    _saved_size = data.size();
+    return true;
+}
+
+bool PipelineCacheStore::load(std::vector<char> &data)
+{
+    //no cache yet is the normal cold start, not an error
+    MappedFile file;
+    try
+    {
+        file = MappedFile(_path);
+    }
+    catch(const std::exception&)
+    {
+        return false;
+    }
+
+    CacheFileHeader header{};
+    if(file.size() < sizeof(header))
+        return false;
+
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION
+       || header.data_size != uint64_t(file.size()) - sizeof(header))
+    {
+        std::cerr << "Pipeline cache " << _path << " is damaged, ignoring it\n";
+        return false;
+    }
+
+    //hashed where it is mapped, copied only once it is known to be good
+    const uint8_t *cache_data = file.data() + sizeof(header);
+    if(hash_bytes(cache_data, size_t(header.data_size)) != header.data_hash)
+    {
+        std::cerr << "Pipeline cache " << _path << " is damaged, ignoring it\n";
+        return false;
+    }
+    data.assign(cache_data, cache_data + header.data_size);
+
+    if(!is_valid_cache_data(data))
+    {
+        std::cerr << "Pipeline cache " << _path << " belongs to another device or driver, ignoring it\n";
+        return false;
+    }
+    return true;
+}
+
+bool PipelineCacheStore::is_valid_cache_data(const std::vector<char> &data) const
+{
+    VkPipelineCacheHeaderVersionOne cache_header;
+    if(data.size() < sizeof(cache_header))
+        return false;
+    std::memcpy(&cache_header, data.data(), sizeof(cache_header));
+
+    return cache_header.headerSize >= sizeof(cache_header)
+        && cache_header.headerSize <= data.size()
+        && cache_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && cache_header.vendorID == _device_properties.vendorID
+        && cache_header.deviceID == _device_properties.deviceID
+        && std::memcmp(cache_header.pipelineCacheUUID, _device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
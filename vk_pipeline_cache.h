@@ -0,0 +1,55 @@
+#pragma once
+
+#include "vk_utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+//VkPipelineCache that survives restarts
+//Stored in one file per GPU + driver (vendor, device id, driver version, cache UUID in the name),
+//so a driver update or another GPU starts cold instead of feeding the driver foreign data
+class PipelineCacheStore
+{
+public:
+    PipelineCacheStore() = default;
+
+    //loads <directory>/<key>.bin if it is there and valid, otherwise creates an empty cache
+    void create(VkPhysicalDevice p_device, VkDevice l_device, const std::string &directory = "pipeline_cache");
+    //saves and destroys the cache
+    void destroy();
+
+    VkPipelineCache get() const { return _cache; }
+    //cache was seeded from disk (warm start)
+    bool is_warm() const { return _warm; }
+
+    //cheap to call every frame: once SAVE_INTERVAL passed and the cache has grown, fetches the data
+    //and leaves hashing and writing the file to a background thread
+    void save_periodically();
+    //saves now on the calling thread (waits for a background save first)
+    //write to a temporary file and rename it over the old one, so a crash never leaves a torn file
+    bool save();
+
+private:
+    static constexpr std::chrono::seconds SAVE_INTERVAL{30};
+
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties _device_properties{};
+    VkPipelineCache _cache = VK_NULL_HANDLE;
+    std::string _path;
+    bool _warm = false;
+    //size of the data last written, no point in writing the same cache again
+    //(set by the writer thread before _writing is cleared)
+    size_t _saved_size = 0;
+    std::chrono::steady_clock::time_point _last_save;
+    std::thread _writer;
+    std::atomic<bool> _writing = false;
+
+    bool load(std::vector<char> &data);
+    bool fetch(std::vector<char> &data) const;
+    bool write(const std::vector<char> &data);
+    //header the driver puts at the start of the data must match this device
+    bool is_valid_cache_data(const std::vector<char> &data) const;
+};
@@ -0,0 +1,596 @@
+#include "vk_pipeline_library.h"
+#include "hash_utils.h"
+#include "profiler.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <iostream>
+
+std::vector<VkVertexInputAttributeDescription> PipelineDesc::default_vertex_attributes()
+{
+    //How data within a vertex is defined
+    return
+    {
+        //Position description
+        VkVertexInputAttributeDescription
+        {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT, //data format
+            .offset = offsetof(Vertex, position)
+        },
+        //ColorDescription
+        VkVertexInputAttributeDescription
+        {
+            .location = 1,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = offsetof(Vertex, color)
+        }
+    };
+}
+
+std::vector<VkVertexInputAttributeDescription> PipelineDesc::position_vertex_attributes()
+{
+    //same stream and stride as the full vertex, color is just skipped
+    return {default_vertex_attributes().front()};
+}
+
+PipelineDynamicState PipelineDesc::dynamic_state() const
+{
+    return
+    {
+        .cull_mode = cull_mode,
+        .front_face = front_face,
+        .depth_test = depth_test ? VK_TRUE : VK_FALSE,
+        .depth_write = depth_write ? VK_TRUE : VK_FALSE,
+        .depth_compare = depth_compare
+    };
+}
+
+uint64_t PipelineDesc::hash(bool without_dynamic_state) const
+{
+    uint64_t h = hash_bytes(vertex_shader.data(), vertex_shader.size());
+    h = hash_combine(h, hash_bytes(fragment_shader.data(), fragment_shader.size()));
+    h = hash_combine(h, vertex_stride);
+    for(const VkVertexInputAttributeDescription &attribute : vertex_attributes)
+        h = hash_combine(h, hash_value(attribute));
+    h = hash_combine(h, topology);
+    h = hash_combine(h, polygon_mode);
+    h = hash_combine(h, blend);
+    if(!without_dynamic_state)
+    {
+        //variants only, one pipeline serves both
+        h = hash_combine(h, transparent);
+        h = hash_combine(h, cull_mode);
+        h = hash_combine(h, front_face);
+        h = hash_combine(h, (uint64_t(depth_test) << 1) | uint64_t(depth_write));
+        h = hash_combine(h, depth_compare);
+    }
+    h = hash_combine(h, reinterpret_cast<uint64_t>(render_pass));
+    h = hash_combine(h, subpass);
+    if(render_pass == VK_NULL_HANDLE)
+        h = hash_combine(h, (uint64_t(color_format) << 32) | uint64_t(depth_format));
+    h = hash_combine(h, specialization.size());
+    if(!specialization.empty())
+        h = hash_combine(h, hash_bytes(specialization.data(), specialization.size() * sizeof(uint32_t)));
+    return h;
+}
+
+bool PipelineDesc::same_as(const PipelineDesc &other, bool without_dynamic_state) const
+{
+    auto same_attribute = [](const VkVertexInputAttributeDescription &a, const VkVertexInputAttributeDescription &b)
+    {
+        return a.location == b.location && a.binding == b.binding && a.format == b.format && a.offset == b.offset;
+    };
+    if(vertex_shader != other.vertex_shader || fragment_shader != other.fragment_shader || vertex_stride != other.vertex_stride
+       || !std::equal(vertex_attributes.begin(), vertex_attributes.end(),
+                      other.vertex_attributes.begin(), other.vertex_attributes.end(), same_attribute)
+       || topology != other.topology || polygon_mode != other.polygon_mode || blend != other.blend
+       || render_pass != other.render_pass || subpass != other.subpass || specialization != other.specialization)
+        return false;
+    if(render_pass == VK_NULL_HANDLE && (color_format != other.color_format || depth_format != other.depth_format))
+        return false;
+    return without_dynamic_state || (transparent == other.transparent && dynamic_state() == other.dynamic_state());
+}
+
+void PipelineLibrary::create(VkDevice l_device, VkPipelineLayout layout, VkPipelineCache cache, bool dynamic_raster_state,
+                             uint32_t worker_count)
+{
+    _logical_device = l_device;
+    _layout = layout;
+    _cache = cache;
+    _dynamic_raster_state = dynamic_raster_state;
+    _stop = false;
+
+    //pipeline creation and the cache are thread safe, workers need no extra locking around them
+    for(uint32_t i = 0; i < worker_count; ++i)
+        _workers.emplace_back(&PipelineLibrary::worker_loop, this);
+}
+
+void PipelineLibrary::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(_queue_mutex);
+        _stop = true;
+        _queue.clear();
+    }
+    _queue_cv.notify_all();
+    for(std::thread &worker : _workers)
+        worker.join();
+    _workers.clear();
+
+    for(auto &[key, entry] : _pipelines)
+        if(entry->pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(_logical_device, entry->pipeline, nullptr);
+    _pipelines.clear();
+    _variants.clear();
+
+    for(VkPipeline pipeline : _built)
+        vkDestroyPipeline(_logical_device, pipeline, nullptr);
+    _built.clear();
+    _fallback = VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineLibrary::build(const PipelineDesc &desc)
+{
+    double compile_ms = 0.0;
+    VkPipeline pipeline = compile(desc, compile_ms);
+    if(pipeline == VK_NULL_HANDLE)
+        throw std::runtime_error("Failed to create a graphics pipeline!");
+
+    std::cout << "Pipeline " << (desc.name.empty() ? "<unnamed>" : desc.name)
+              << " created in " << compile_ms << " ms\n";
+    _built.push_back(pipeline);
+    return pipeline;
+}
+
+uint64_t PipelineLibrary::add(const PipelineDesc &desc)
+{
+    //paths alone would keep a stale pipeline for a shader rebuilt under the same name
+    const uint64_t shaders_hash = hash_combine(hash_shader_file(desc.vertex_shader), hash_shader_file(desc.fragment_shader));
+
+    //a hit has to be the same description too, another one under the key (collision) moves on to the next key
+    uint64_t key = hash_combine(desc.hash(), shaders_hash);
+    for(auto it = _variants.find(key); it != _variants.end(); it = _variants.find(key))
+    {
+        if(it->second.shaders_hash == shaders_hash && it->second.desc.same_as(desc))
+            return key;
+        key = hash_combine(key, 1);
+    }
+
+    //with dynamic raster state e.g. two-sided and back-face culled variants are one pipeline
+    uint64_t pipeline_key = hash_combine(desc.hash(_dynamic_raster_state), shaders_hash);
+    for(auto it = _pipelines.find(pipeline_key); it != _pipelines.end(); it = _pipelines.find(pipeline_key))
+    {
+        if(it->second->shaders_hash == shaders_hash && it->second->desc.same_as(desc, _dynamic_raster_state))
+            break;
+        pipeline_key = hash_combine(pipeline_key, 1);
+    }
+    std::unique_ptr<Entry> &entry = _pipelines[pipeline_key];
+    if(!entry)
+    {
+        entry = std::make_unique<Entry>();
+        entry->desc = desc;
+        entry->shaders_hash = shaders_hash;
+    }
+    _variants[key] = {entry.get(), desc.dynamic_state(), desc, shaders_hash};
+    return key;
+}
+
+uint64_t PipelineLibrary::hash_shader_file(const std::string &path)
+{
+    if(path.empty())
+        return 0;
+
+    std::error_code error;
+    const std::filesystem::file_time_type write_time = std::filesystem::last_write_time(path, error);
+    const uintmax_t size = error ? 0 : std::filesystem::file_size(path, error);
+    if(error)
+        return 0;
+
+    auto it = _shader_hashes.find(path);
+    if(it != _shader_hashes.end() && it->second.write_time == write_time && it->second.size == size)
+        return it->second.hash;
+
+    uint64_t hash = 0;
+    try
+    {
+        MappedFile file(path, MappedFile::Access::WholeFile);
+        hash = hash_bytes(file.data(), file.size());
+    }
+    catch(std::runtime_error&)
+    {
+        return 0;
+    }
+    _shader_hashes[path] = {write_time, size, hash};
+    return hash;
+}
+
+VkPipeline PipelineLibrary::get(uint64_t key)
+{
+    VkPipeline pipeline = try_get(key);
+    return pipeline != VK_NULL_HANDLE ? pipeline : _fallback;
+}
+
+VkPipeline PipelineLibrary::try_get(uint64_t key)
+{
+    auto it = _variants.find(key);
+    if(it == _variants.end())
+        return _fallback;
+
+    Entry &entry = *it->second.entry;
+    switch(entry.state.load(std::memory_order_acquire))
+    {
+    case State::Ready:
+        return entry.pipeline.load(std::memory_order_relaxed);
+    case State::Idle:
+        {
+            entry.state = State::Queued;
+            std::lock_guard<std::mutex> lock(_queue_mutex);
+            _queue.push_back(&entry);
+        }
+        _queue_cv.notify_one();
+        return VK_NULL_HANDLE;
+    default:
+        //still compiling, or failed
+        return VK_NULL_HANDLE;
+    }
+}
+
+bool PipelineLibrary::has_failed(uint64_t key) const
+{
+    auto it = _variants.find(key);
+    return it != _variants.end() && it->second.entry->state.load(std::memory_order_acquire) == State::Failed;
+}
+
+const PipelineDynamicState& PipelineLibrary::get_dynamic_state(uint64_t key) const
+{
+    auto it = _variants.find(key);
+    return it == _variants.end() ? _fallback_dynamic_state : it->second.dynamic_state;
+}
+
+const PipelineDesc& PipelineLibrary::get_desc(uint64_t key) const
+{
+    auto it = _variants.find(key);
+    return it == _variants.end() ? _fallback_desc : it->second.desc;
+}
+
+std::vector<PipelineLibrary::VariantStats> PipelineLibrary::get_variant_stats() const
+{
+    std::vector<VariantStats> stats;
+    stats.reserve(_variants.size());
+    for(const auto &[key, variant] : _variants)
+        stats.push_back({key, variant.desc.name, variant.entry->state == State::Ready, variant.entry->compile_ms});
+    return stats;
+}
+
+void PipelineLibrary::worker_loop()
+{
+    for(;;)
+    {
+        Entry *entry = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(_queue_mutex);
+            _queue_cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+            if(_stop)
+                return;
+            entry = _queue.front();
+            _queue.pop_front();
+        }
+
+        double compile_ms = 0.0;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        try
+        {
+            pipeline = compile(entry->desc, compile_ms);
+        }
+        catch(std::runtime_error &e)
+        {
+            //missing shader file etc. must not take the worker down
+            std::cerr << e.what() << "\n";
+        }
+        entry->compile_ms = compile_ms;
+        entry->pipeline.store(pipeline, std::memory_order_relaxed);
+        //release: main thread sees the pipeline once it sees Ready
+        entry->state.store(pipeline != VK_NULL_HANDLE ? State::Ready : State::Failed, std::memory_order_release);
+        if(pipeline == VK_NULL_HANDLE)
+            std::cerr << "Failed to compile pipeline variant " << entry->desc.name << "\n";
+    }
+}
+
+VkPipeline PipelineLibrary::compile(const PipelineDesc &desc, double &compile_ms)
+{
+    PROFILE_ZONE("pipeline compile");
+    const uint64_t begin_ns = profiler::now_ns();
+
+    //no fragment stage: only depth is written (prepass)
+    const bool depth_only = desc.fragment_shader.empty();
+
+    //Build shader modules to link to the Graphics pipeline
+    VkShaderModule vertex_shader_module = load_shader_module(_logical_device, desc.vertex_shader);
+    VkShaderModule fragment_shader_module = VK_NULL_HANDLE;
+    if(!depth_only)
+    {
+        try
+        {
+            fragment_shader_module = load_shader_module(_logical_device, desc.fragment_shader);
+        }
+        catch(std::runtime_error&)
+        {
+            vkDestroyShaderModule(_logical_device, vertex_shader_module, nullptr);
+            throw;
+        }
+    }
+
+    //SPECIALIZATION CONSTANTS
+    //values baked in at pipeline creation, compiler can fold them like #defines
+    //(ids the shader doesn`t declare are ignored)
+    std::vector<VkSpecializationMapEntry> specialization_entries(desc.specialization.size());
+    for(uint32_t i = 0; i < specialization_entries.size(); ++i)
+        specialization_entries[i] = {.constantID = i, .offset = i * uint32_t(sizeof(uint32_t)), .size = sizeof(uint32_t)};
+
+    VkSpecializationInfo specialization_info
+    {
+        .mapEntryCount = static_cast<uint32_t>(specialization_entries.size()),
+        .pMapEntries = specialization_entries.data(),
+        .dataSize = desc.specialization.size() * sizeof(uint32_t),
+        .pData = desc.specialization.data()
+    };
+    const VkSpecializationInfo *specialization = desc.specialization.empty() ? nullptr : &specialization_info;
+
+    // SHADER STAGE CREATION INFO
+    VkPipelineShaderStageCreateInfo vertex_shader_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_VERTEX_BIT,
+        .module = vertex_shader_module,
+        //function to run in GLSL
+        .pName = "main",
+        .pSpecializationInfo = specialization
+    };
+
+    VkPipelineShaderStageCreateInfo fragment_shader_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .module = fragment_shader_module,
+        //function to run in GLSL
+        .pName = "main",
+        .pSpecializationInfo = specialization
+    };
+
+    //Graphics Pipeline requires array of shader info
+    VkPipelineShaderStageCreateInfo shader_stages[] =
+    {
+        vertex_shader_createinfo,
+        fragment_shader_createinfo
+    };
+
+    //VERTEX INPUT
+    //How a data for any 1 vertex (pos, color, texture, normals...) is layout
+    VkVertexInputBindingDescription binding_description
+    {
+        //can bind multiple streams of data, define which one
+        //which IN parameter in the vertex shader 
+        .binding = 0,
+        //size of the individual vertex
+        .stride = desc.vertex_stride,
+        //How to move the data after each vertex
+        //if we draw multiple instances:
+        // draw all 1st vertices and thend draw all 2nd...
+        // or draw all 1st object vertices, then 2nd...
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        //list of vertex binding desc (data spacing, stride informantion)
+        .pVertexBindingDescriptions = &binding_description,
+        .vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertex_attributes.size()),
+        //(data format and where to bind it)
+        .pVertexAttributeDescriptions = desc.vertex_attributes.data()
+    };
+
+    //INPUT ASSEMBLY
+    //(where we assembly input into primitives)
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        //type of primitive to assemble verticies as (triangles, lines) 
+        .topology = desc.topology,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    //VIEWPORT AND SCISSOR
+    // viewport -- how the transforming image into screen
+    // from top-left to buttom (different for splitscreen for example)
+    //scissor - is basicly which part of the image we cut
+    //both are dynamic: set in the command buffer, so pipelines don`t depend on the output resolution
+    VkPipelineViewportStateCreateInfo viewport_state_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .pViewports = nullptr,
+        .scissorCount = 1,
+        .pScissors = nullptr
+    };
+
+    // DYNAMIC STATE
+    // something is not backed but configurable at runtime
+    // we define what parts of pipeline is is dynamic(issued in command buffer)
+    std::vector<VkDynamicState> dynamic_states
+    {
+        //can be resized like this vkCmdSetViewport(commandbuffer, 0, 1, &viewport)
+        VK_DYNAMIC_STATE_VIEWPORT,
+        // can be also resized in command buffer with vkCmdSetScissor(commandbuffer, 0, 1, &scissor)
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    if(_dynamic_raster_state)
+    {
+        //VK_EXT_extended_dynamic_state: values below in the create infos are ignored
+        dynamic_states.insert(dynamic_states.end(),
+        {
+            VK_DYNAMIC_STATE_CULL_MODE_EXT,
+            VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT
+        });
+    }
+
+    //Dynamic state creation info
+    VkPipelineDynamicStateCreateInfo dynamic_state_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+        .pDynamicStates = dynamic_states.data()
+    };
+
+    //RASTERIZER - convert the primitives(triangles) into fragments
+    VkPipelineRasterizationStateCreateInfo rasterization_state_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        // when somehing is far away (far plane) do not render them
+        // flat everything when it is far: false, GPU feature
+        .depthClampEnable = VK_FALSE,
+        // if we want to discard data
+        // you compute stuff and do not draw
+        .rasterizerDiscardEnable = VK_FALSE,
+        // how we want to handle poligons
+        // other then fill -- you need GPU feature
+        .polygonMode = desc.polygon_mode,
+        // do not draw the back of tri
+        .cullMode = desc.cull_mode,
+        //define what side is the face (if we draw the 3 point in the counter-clockwize)
+        .frontFace = desc.front_face,
+        //to fix "shadow acne"? add a little bit to depth for shadow calculation to fragmenths
+        .depthBiasEnable = VK_FALSE,
+        // how thick lines would be
+        .lineWidth = 1.f,
+
+    };
+
+    // MULTISAMPLING -- form of antialiasing
+    // not for textures, fix "stairs" of the sides of triangles
+    VkPipelineMultisampleStateCreateInfo multisampling_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        //num of samples to use per fragment
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        //disable the whole feature for now
+        .sampleShadingEnable = VK_FALSE,
+    };
+
+    // BLENDING - of two fragments together
+    // (you draw an object and another object on top of it)
+    // how to blend new color of fragment with the existing one
+
+    // Blend attachment state -- how blending is handled
+    //Blending equasion: (srcColorBlendFactor * newCOLOR) colorBlendOp (dstColorBlendFactor * oldCOLOR)
+    //Our Case: (VK_BLEND_FACTOR_SRC_ALPHA * newCOLOR) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * oldCOLOR)
+    //Or: (newCOLOR-ALPHA * newCOLOR) + ((1-newCOLOR-ALPHA) * oldCOLOR)
+    //in short: use alpha of the new color!
+    VkPipelineColorBlendAttachmentState how_to_blend_colors
+    {
+        .blendEnable = desc.blend && !depth_only ? VK_TRUE : VK_FALSE,
+        //how to blend colors
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        //math op to do
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        //how to blend alpha:
+        //take new alpha
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        //get rid of the old alpha
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        //same equasion as color 
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        //what colors to be changed by blending (none without a fragment shader)
+        .colorWriteMask = depth_only ? VkColorComponentFlags(0) :
+            (VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT)
+    };
+    
+    VkPipelineColorBlendStateCreateInfo color_blending_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        //logic operation instead of calculation of blended color
+        .logicOpEnable = VK_FALSE,
+        //color blend attachment state to multiply colors together
+        .attachmentCount = 1,
+        .pAttachments = &how_to_blend_colors
+        
+    };
+
+    //set up depth stencil testing
+    VkPipelineDepthStencilStateCreateInfo depth_satencil_create_info
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        //when false - by default depth is 1 (as far away as possible
+        //when true - test every pixel depth with existing pixel(fragment) before drawing it
+        .depthTestEnable = desc.depth_test ? VK_TRUE : VK_FALSE,
+        //when we put a new pixel we update the depth buffer with relevant info
+        .depthWriteEnable = desc.depth_write ? VK_TRUE : VK_FALSE,
+        //if new_value < old ==> overwrite fragment
+        .depthCompareOp = desc.depth_compare,
+        //check if depth value in between two values
+        .depthBoundsTestEnable = VK_FALSE,
+        //we don`t want to enable a stencil test
+        .stencilTestEnable = VK_FALSE
+    };
+
+    //PIPLINE
+    //Create pipline
+    VkGraphicsPipelineCreateInfo pipline_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .stageCount = depth_only ? 1u : 2u,
+        .pStages = shader_stages,
+        .pVertexInputState = &vertex_input_createinfo,
+        .pInputAssemblyState = &input_assembly_createinfo,
+        .pViewportState = &viewport_state_createinfo,
+        .pRasterizationState = &rasterization_state_createinfo,
+        .pMultisampleState = &multisampling_createinfo,
+        .pDepthStencilState = &depth_satencil_create_info,
+        .pColorBlendState = &color_blending_createinfo,
+        .pDynamicState = &dynamic_state_createinfo,
+        .layout = _layout,
+        .renderPass = desc.render_pass, //render pass that will be used by the pipline
+        .subpass = desc.subpass,
+        .basePipelineHandle = VK_NULL_HANDLE, //if you want to base new pipline on the old one 
+        .basePipelineIndex = -1 // index of the base pipline if you create multiple piplines
+    };
+
+#ifdef VK_KHR_dynamic_rendering
+    //no render pass: pipeline is told the attachment formats instead
+    VkPipelineRenderingCreateInfoKHR rendering_createinfo
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &desc.color_format,
+        .depthAttachmentFormat = desc.depth_format,
+        //stencil isn`t used, no stencil attachment is bound
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+    };
+    if(desc.render_pass == VK_NULL_HANDLE)
+        pipline_createinfo.pNext = &rendering_createinfo;
+#endif
+
+    //with a warm cache driver skips compiling SPIR-V to GPU code
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult res = vkCreateGraphicsPipelines(_logical_device, _cache, 1, &pipline_createinfo, nullptr, &pipeline);
+    if(res != VK_SUCCESS)
+        pipeline = VK_NULL_HANDLE;
+
+    //Clean up of the not needed shader modules after we create pipeline
+    if(fragment_shader_module != VK_NULL_HANDLE)
+        vkDestroyShaderModule(_logical_device, fragment_shader_module, nullptr);
+    vkDestroyShaderModule(_logical_device, vertex_shader_module, nullptr);
+
+    compile_ms = double(profiler::now_ns() - begin_ns) / 1e6;
+    return pipeline;
+}
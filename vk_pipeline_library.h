@@ -0,0 +1,188 @@
+#pragma once
+
+#include "vk_utils.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+//Part of PipelineDesc that is set in the command buffer (vkCmdSet*EXT) when VK_EXT_extended_dynamic_state is there
+//variants that differ only here then share one VkPipeline
+struct PipelineDynamicState
+{
+    VkCullModeFlags cull_mode;
+    VkFrontFace front_face;
+    VkBool32 depth_test;
+    VkBool32 depth_write;
+    VkCompareOp depth_compare;
+
+    bool operator==(const PipelineDynamicState &other) const = default;
+};
+
+//Everything that makes one pipeline different from another
+//(layout and cache are shared by the whole library, viewport and scissor are always dynamic)
+struct PipelineDesc
+{
+    std::string vertex_shader = "shaders/vert.spv";
+    //empty -- depth only pipeline (no colour writes)
+    std::string fragment_shader = "shaders/frag.spv";
+
+    //vertex layout, one interleaved stream
+    uint32_t vertex_stride = sizeof(Vertex);
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    bool depth_test = true;
+    bool depth_write = true;
+    VkCompareOp depth_compare = VK_COMPARE_OP_LESS;
+
+    //SRC_ALPHA / ONE_MINUS_SRC_ALPHA, for transparent variants
+    //(off for opaque: no destination reads, early depth and ROP fast paths stay on)
+    bool blend = false;
+
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    //attachment formats, used instead of render_pass when it is VK_NULL_HANDLE (dynamic rendering)
+    VkFormat color_format = VK_FORMAT_UNDEFINED;
+    VkFormat depth_format = VK_FORMAT_UNDEFINED;
+
+    //value i goes to constant_id = i, in both stages (floats bit casted)
+    std::vector<uint32_t> specialization;
+
+    //draw order only, not pipeline state: drawn after opaque meshes and left out of the depth prepass
+    bool transparent = false;
+
+    //for reports only, not part of the key
+    std::string name;
+
+    //position + color of Vertex
+    static std::vector<VkVertexInputAttributeDescription> default_vertex_attributes();
+    //position of Vertex (depth only passes)
+    static std::vector<VkVertexInputAttributeDescription> position_vertex_attributes();
+
+    PipelineDynamicState dynamic_state() const;
+    //without_dynamic_state: key of the VkPipeline when PipelineDynamicState is set at record time
+    uint64_t hash(bool without_dynamic_state = false) const;
+    //same fields as hash compares (a hash hit is checked with it)
+    bool same_as(const PipelineDesc &other, bool without_dynamic_state = false) const;
+};
+
+//Pipelines by hash of their PipelineDesc and the SPIR-V it points at (a rebuilt shader is a new variant)
+//Variants are compiled lazily on worker threads, until a variant is ready the fallback pipeline is used,
+//so a new material never stalls a frame on the driver compiler
+class PipelineLibrary
+{
+public:
+    struct VariantStats
+    {
+        uint64_t key;
+        std::string name;
+        bool ready;
+        //time spent in vkCreateGraphicsPipelines (+ shader modules)
+        double compile_ms;
+    };
+
+    PipelineLibrary() = default;
+
+    //dynamic_raster_state: cull mode / depth state are set by the caller with vkCmdSet*EXT
+    void create(VkDevice l_device, VkPipelineLayout layout, VkPipelineCache cache, bool dynamic_raster_state,
+                uint32_t worker_count = 2);
+    //waits for running compiles and destroys every pipeline
+    void destroy();
+
+    //compiles right now on this thread (fallback / pipelines needed for the first frame)
+    VkPipeline build(const PipelineDesc &desc);
+    void set_fallback(VkPipeline pipeline, const PipelineDesc &desc)
+    {
+        _fallback = pipeline;
+        _fallback_desc = desc;
+        _fallback_dynamic_state = desc.dynamic_state();
+    }
+
+    //registers a variant without compiling it, returns its key
+    //(same description gives the same key)
+    uint64_t add(const PipelineDesc &desc);
+    //ready pipeline of the variant, or the fallback while it is compiling (key 0 -- fallback)
+    //first call for a variant queues the compile, main thread only
+    VkPipeline get(uint64_t key);
+    //same as get, but VK_NULL_HANDLE instead of the fallback while the variant isn`t ready
+    VkPipeline try_get(uint64_t key);
+    //compile of the variant was tried and failed (it stays VK_NULL_HANDLE for try_get)
+    bool has_failed(uint64_t key) const;
+    //state to set before drawing with the variant (only when dynamic_raster_state)
+    const PipelineDynamicState& get_dynamic_state(uint64_t key) const;
+    //description the variant was added with (fallback description for unknown keys)
+    const PipelineDesc& get_desc(uint64_t key) const;
+
+    bool has_dynamic_raster_state() const { return _dynamic_raster_state; }
+    //VkPipelines behind the variants, fewer than variants with dynamic raster state
+    size_t get_pipeline_count() const { return _pipelines.size(); }
+    std::vector<VariantStats> get_variant_stats() const;
+
+private:
+    enum class State { Idle, Queued, Ready, Failed };
+
+    //one VkPipeline
+    struct Entry
+    {
+        PipelineDesc desc;
+        uint64_t shaders_hash = 0;
+        std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+        std::atomic<State> state{State::Idle};
+        std::atomic<double> compile_ms{0.0};
+    };
+
+    //what a mesh refers to: pipeline + state set at record time
+    struct Variant
+    {
+        Entry *entry;
+        PipelineDynamicState dynamic_state;
+        PipelineDesc desc;
+        uint64_t shaders_hash;
+    };
+
+    //content hash of a .spv, rehashed when the file changes
+    struct ShaderFileHash
+    {
+        std::filesystem::file_time_type write_time;
+        uintmax_t size;
+        uint64_t hash;
+    };
+
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    VkPipelineLayout _layout = VK_NULL_HANDLE;
+    VkPipelineCache _cache = VK_NULL_HANDLE;
+    bool _dynamic_raster_state = false;
+    VkPipeline _fallback = VK_NULL_HANDLE;
+    PipelineDesc _fallback_desc;
+    PipelineDynamicState _fallback_dynamic_state{};
+
+    //only the main thread adds to the maps, workers get Entry pointers (stable)
+    std::unordered_map<uint64_t, std::unique_ptr<Entry>> _pipelines;
+    std::unordered_map<uint64_t, Variant> _variants;
+    //pipelines made by build()
+    std::vector<VkPipeline> _built;
+    //by path, main thread only
+    std::unordered_map<std::string, ShaderFileHash> _shader_hashes;
+
+    std::vector<std::thread> _workers;
+    std::mutex _queue_mutex;
+    std::condition_variable _queue_cv;
+    std::deque<Entry*> _queue;
+    bool _stop = false;
+
+    void worker_loop();
+    //0 for no / unreadable file (its compile fails and says why)
+    uint64_t hash_shader_file(const std::string &path);
+    VkPipeline compile(const PipelineDesc &desc, double &compile_ms);
+};
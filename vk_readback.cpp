@@ -0,0 +1,175 @@
+#include "vk_readback.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+void FrameReadback::create(VkPhysicalDevice p_device, VkDevice l_device,
+                           VkExtent2D extent, VkFormat format, uint32_t ring_size, Callback callback)
+{
+    _logical_device = l_device;
+    _extent = extent;
+    _format = format;
+    _callback = std::move(callback);
+    //4 bytes per pixel (R8G8B8A8 / B8G8R8A8)
+    _size = VkDeviceSize(extent.width) * extent.height * 4;
+
+    //CPU reads from uncached (write-combined) memory are very slow, prefer cached
+    VkMemoryPropertyFlags memory_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    if(is_memory_type_supported(p_device, memory_flags | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        memory_flags |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        _is_coherent = true;
+    }
+    else if(is_memory_type_supported(p_device, memory_flags))
+    {
+        _is_coherent = false;
+    }
+    else
+    {
+        memory_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        _is_coherent = true;
+    }
+
+    _slots.resize(ring_size);
+    for(Slot &slot : _slots)
+    {
+        create_buffer(p_device, _logical_device, _size,
+                      VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_flags,
+                      &slot.buffer, &slot.memory);
+        //keep it mapped for the whole life, no map/unmap per frame
+        vkMapMemory(_logical_device, slot.memory, 0, _size, 0, &slot.mapped);
+        slot.pending = false;
+        slot.frame_number = 0;
+    }
+}
+
+void FrameReadback::destroy()
+{
+    for(Slot &slot : _slots)
+    {
+        vkUnmapMemory(_logical_device, slot.memory);
+        vkDestroyBuffer(_logical_device, slot.buffer, nullptr);
+        vkFreeMemory(_logical_device, slot.memory, nullptr);
+    }
+    _slots.clear();
+}
+
+void FrameReadback::record_copy(VkCommandBuffer command_buffer, uint32_t slot, VkImage image, VkImageLayout image_layout,
+                                VkPipelineStageFlags src_stage, VkAccessFlags src_access, uint64_t frame_number)
+{
+    const VkImageSubresourceRange color_range
+    {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1
+    };
+
+    //wait for the last write of the image, then make it a copy source
+    VkImageMemoryBarrier to_transfer
+    {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = image_layout,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = color_range
+    };
+    vkCmdPipelineBarrier(command_buffer, src_stage, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+    VkBufferImageCopy copy_region
+    {
+        .bufferOffset = 0,
+        //0 -- tightly packed rows
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource =
+        {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {.width = _extent.width, .height = _extent.height, .depth = 1}
+    };
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           _slots[slot].buffer, 1, &copy_region);
+
+    //give image back in the layout presentation (or next frame) expects
+    if(image_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+    {
+        VkImageMemoryBarrier to_final = to_transfer;
+        to_final.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        to_final.dstAccessMask = 0;
+        to_final.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        to_final.newLayout = image_layout;
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &to_final);
+    }
+
+    //copied data must be visible to the host once the fence signals
+    VkBufferMemoryBarrier to_host
+    {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = _slots[slot].buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, nullptr, 1, &to_host, 0, nullptr);
+
+    _slots[slot].pending = true;
+    _slots[slot].frame_number = frame_number;
+}
+
+void FrameReadback::deliver(uint32_t slot)
+{
+    Slot &s = _slots[slot];
+    if(!s.pending)
+        return;
+
+    PROFILE_ZONE("readback deliver");
+
+    if(!_is_coherent)
+    {
+        VkMappedMemoryRange range
+        {
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = s.memory,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+        };
+        vkInvalidateMappedMemoryRanges(_logical_device, 1, &range);
+    }
+
+    s.pending = false;
+    if(_callback)
+        _callback(s.mapped, _extent, _format, s.frame_number);
+}
+
+void FrameReadback::flush()
+{
+    std::vector<uint32_t> pending;
+    for(uint32_t i = 0; i < _slots.size(); ++i)
+        if(_slots[i].pending)
+            pending.push_back(i);
+
+    std::sort(begin(pending), end(pending), [this](uint32_t a, uint32_t b)
+    {
+        return _slots[a].frame_number < _slots[b].frame_number;
+    });
+    for(uint32_t slot : pending)
+        deliver(slot);
+}
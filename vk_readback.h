@@ -0,0 +1,53 @@
+#pragma once
+
+#include "vk_utils.h"
+
+#include <functional>
+
+//Copies the final colour image of a frame into host memory without stalling the GPU
+//Every frame in flight has its own host visible buffer, the copy is recorded into the frame command buffer
+//and the data is handed out after the frame fence signals (MAX_FRAME_DRAWS frames later)
+class FrameReadback
+{
+public:
+    //pixels point straight into mapped GPU memory: valid only until the callback returns
+    //rows are tightly packed, 4 bytes per pixel in the colour attachment format
+    using Callback = std::function<void(const void *pixels, VkExtent2D extent, VkFormat format, uint64_t frame_number)>;
+
+    FrameReadback() = default;
+
+    void create(VkPhysicalDevice p_device, VkDevice l_device,
+                VkExtent2D extent, VkFormat format, uint32_t ring_size, Callback callback);
+    void destroy();
+
+    bool is_created() const { return !_slots.empty(); }
+
+    //image is expected in image_layout (final layout of the render pass) and is returned to it
+    //src_stage / src_access -- last write of the image (render pass, or the upscale blit)
+    void record_copy(VkCommandBuffer command_buffer, uint32_t slot, VkImage image, VkImageLayout image_layout,
+                     VkPipelineStageFlags src_stage, VkAccessFlags src_access, uint64_t frame_number);
+    //fence of the frame that used the slot has signaled
+    void deliver(uint32_t slot);
+    //device is idle: hand out everything still pending (in frame order)
+    void flush();
+
+private:
+    struct Slot
+    {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        //persistently mapped
+        void *mapped;
+        bool pending;
+        uint64_t frame_number;
+    };
+
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    VkExtent2D _extent{};
+    VkFormat _format = VK_FORMAT_UNDEFINED;
+    VkDeviceSize _size = 0;
+    //cached memory is fast to read on CPU, but may need an invalidate
+    bool _is_coherent = true;
+    Callback _callback;
+    std::vector<Slot> _slots;
+};
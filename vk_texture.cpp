@@ -0,0 +1,603 @@
+#include "vk_texture.h"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <thread>
+
+#include "block_decode.h"
+#include "hash_utils.h"
+#include "image_file.h"
+#include "ktx2_file.h"
+#include "mapped_file.h"
+#include "profiler.h"
+
+namespace
+{
+    //2x2 box filtered chain, level 0 included (formats without linear blits)
+    //sRGB texels are averaged as linear values
+    std::vector<std::vector<uint8_t>> build_mip_chain(const uint8_t *pixels, uint32_t width, uint32_t height,
+                                                      uint32_t mip_levels, bool srgb)
+    {
+        std::array<float, 256> to_linear;
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            const float c = float(i) / 255.f;
+            to_linear[i] = srgb ? (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f)) : c;
+        }
+        auto from_linear = [srgb](float c)
+        {
+            if(srgb)
+                c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            return uint8_t(std::clamp(c, 0.f, 1.f) * 255.f + 0.5f);
+        };
+
+        std::vector<std::vector<uint8_t>> levels;
+        levels.emplace_back(pixels, pixels + size_t(width) * height * 4);
+        for(uint32_t level = 1; level < mip_levels; ++level)
+        {
+            const uint32_t next_width = std::max(width / 2, 1u);
+            const uint32_t next_height = std::max(height / 2, 1u);
+            const std::vector<uint8_t> &src = levels.back();
+            std::vector<uint8_t> dst(size_t(next_width) * next_height * 4);
+            //source texels of a 1 pixel wide/high level are used twice
+            for(uint32_t y = 0; y < next_height; ++y)
+                for(uint32_t x = 0; x < next_width; ++x)
+                {
+                    const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                    const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                    for(uint32_t c = 0; c < 4; ++c)
+                    {
+                        auto texel = [&](uint32_t sx, uint32_t sy) { return src[(size_t(sy) * width + sx) * 4 + c]; };
+                        uint8_t &out = dst[(size_t(y) * next_width + x) * 4 + c];
+                        //alpha is never sRGB encoded
+                        if(c == 3)
+                            out = uint8_t((texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1) + 2) / 4);
+                        else
+                            out = from_linear((to_linear[texel(x0, y0)] + to_linear[texel(x1, y0)]
+                                             + to_linear[texel(x0, y1)] + to_linear[texel(x1, y1)]) * 0.25f);
+                    }
+                }
+            levels.push_back(std::move(dst));
+            width = next_width;
+            height = next_height;
+        }
+        return levels;
+    }
+
+    //texel blocks of the formats KTX2 files can have
+    struct FormatInfo
+    {
+        uint32_t block_bytes;
+        uint32_t block_width;
+        uint32_t block_height;
+        bool srgb;
+        //software decoder when the device can`t sample the format
+        std::optional<BlockFormat> decoder;
+    };
+
+    std::optional<FormatInfo> get_format_info(VkFormat format)
+    {
+        switch(format)
+        {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_UNORM:          return FormatInfo{4, 1, 1, false};
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_SRGB:           return FormatInfo{4, 1, 1, true};
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:     return FormatInfo{8, 4, 4, false, BlockFormat::BC1_RGB};
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:      return FormatInfo{8, 4, 4, true, BlockFormat::BC1_RGB};
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:    return FormatInfo{8, 4, 4, false, BlockFormat::BC1_RGBA};
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:     return FormatInfo{8, 4, 4, true, BlockFormat::BC1_RGBA};
+        case VK_FORMAT_BC2_UNORM_BLOCK:         return FormatInfo{16, 4, 4, false, BlockFormat::BC2};
+        case VK_FORMAT_BC2_SRGB_BLOCK:          return FormatInfo{16, 4, 4, true, BlockFormat::BC2};
+        case VK_FORMAT_BC3_UNORM_BLOCK:         return FormatInfo{16, 4, 4, false, BlockFormat::BC3};
+        case VK_FORMAT_BC3_SRGB_BLOCK:          return FormatInfo{16, 4, 4, true, BlockFormat::BC3};
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:         return FormatInfo{8, 4, 4, false};
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:         return FormatInfo{16, 4, 4, false};
+        case VK_FORMAT_BC7_SRGB_BLOCK:          return FormatInfo{16, 4, 4, true};
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK: return FormatInfo{8, 4, 4, false};
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:  return FormatInfo{8, 4, 4, true};
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK: return FormatInfo{16, 4, 4, false};
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:  return FormatInfo{16, 4, 4, true};
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:    return FormatInfo{16, 4, 4, false};
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:     return FormatInfo{16, 4, 4, true};
+        case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:    return FormatInfo{16, 5, 5, false};
+        case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:     return FormatInfo{16, 5, 5, true};
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:    return FormatInfo{16, 6, 6, false};
+        case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:     return FormatInfo{16, 6, 6, true};
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:    return FormatInfo{16, 8, 8, false};
+        case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:     return FormatInfo{16, 8, 8, true};
+        default:                                return std::nullopt;
+        }
+    }
+
+    //block rows of every level are split into chunks, worker threads take them until none is left
+    std::vector<std::vector<uint8_t>> decode_levels(BlockFormat format, const Ktx2Image &image)
+    {
+        PROFILE_ZONE("decode texture blocks");
+
+        constexpr uint32_t ROWS_PER_TASK = 16;
+        struct Task
+        {
+            uint32_t level;
+            uint32_t first_row;
+            uint32_t last_row;
+        };
+        std::vector<Task> tasks;
+        std::vector<std::vector<uint8_t>> levels(image.levels.size());
+        for(uint32_t level = 0; level < image.levels.size(); ++level)
+        {
+            const Ktx2Image::Level &src = image.levels[level];
+            levels[level].resize(size_t(src.width) * src.height * 4);
+            const uint32_t block_rows = (src.height + 3) / 4;
+            for(uint32_t row = 0; row < block_rows; row += ROWS_PER_TASK)
+                tasks.push_back({level, row, std::min(row + ROWS_PER_TASK, block_rows)});
+        }
+
+        std::atomic<size_t> next_task = 0;
+        auto worker = [&]()
+        {
+            for(size_t i = next_task++; i < tasks.size(); i = next_task++)
+            {
+                const Task &task = tasks[i];
+                const Ktx2Image::Level &src = image.levels[task.level];
+                decode_block_rows(format, src.data, src.width, src.height, task.first_row, task.last_row,
+                                  levels[task.level].data());
+            }
+        };
+
+        const size_t thread_count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), tasks.size());
+        std::vector<std::thread> threads;
+        for(size_t i = 1; i < thread_count; ++i)
+            threads.emplace_back(worker);
+        worker();
+        for(std::thread &thread : threads)
+            thread.join();
+        return levels;
+    }
+}
+
+void TextureCache::create(VkPhysicalDevice p_device, VkDevice l_device, VkQueue queue, VkCommandPool command_pool,
+                          BindlessHeap *heap, float max_anisotropy)
+{
+    _physical_device = p_device;
+    _logical_device = l_device;
+    _queue = queue;
+    _command_pool = command_pool;
+    _heap = heap;
+    _max_anisotropy = max_anisotropy;
+}
+
+void TextureCache::destroy()
+{
+    //bindless slots go with the heap
+    for(Texture &texture : _textures)
+    {
+        vkDestroyImageView(_logical_device, texture.image_view, nullptr);
+        vkDestroyImage(_logical_device, texture.image, nullptr);
+        vkFreeMemory(_logical_device, texture.memory, nullptr);
+    }
+    _textures.clear();
+    _by_file.clear();
+    _by_pixels.clear();
+    _by_path.clear();
+
+    for(auto &[hash, entries] : _samplers)
+        for(SamplerEntry &entry : entries)
+            vkDestroySampler(_logical_device, entry.sampler, nullptr);
+    _samplers.clear();
+}
+
+uint32_t TextureCache::load(const std::string &path, bool srgb)
+{
+    _stats.requests++;
+    const std::string key = path + (srgb ? "|srgb" : "|unorm");
+    if(auto it = _by_path.find(key); it != _by_path.end())
+    {
+        _stats.cache_hits++;
+        return it->second;
+    }
+
+    //mapped: hashed, parsed and copied to staging without a copy on the heap
+    MappedFile file(path);
+    //same bytes under another path are the same texture
+    uint64_t hash = hash_combine(hash_bytes(file.data(), file.size()), srgb);
+    ContentEntry content
+    {
+        .size = file.size(),
+        .srgb = srgb,
+        .check = hash_bytes(file.data(), file.size(), CHECK_SEED)
+    };
+    if(const uint32_t found = find_content(_by_file, hash, content, file.data()); found != UINT32_MAX)
+    {
+        _stats.cache_hits++;
+        _by_path[key] = found;
+        return found;
+    }
+
+    uint32_t texture_id;
+    if(is_ktx2(file.data(), file.size()))
+    {
+        texture_id = load_ktx2(file.data(), file.size(), path);
+    }
+    else
+    {
+        ImageData image;
+        {
+            PROFILE_ZONE("decode image");
+            if(!decode_image(file.data(), file.size(), image))
+                throw std::runtime_error("Failed to decode the image: " + path);
+        }
+        texture_id = upload(image.pixels.data(), image.width, image.height,
+                            srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
+    }
+
+    content.texture_id = texture_id;
+    add_content(_by_file, hash, std::move(content), file.data());
+    _by_path[key] = texture_id;
+    return texture_id;
+}
+
+uint32_t TextureCache::add_rgba8(const uint8_t *pixels, uint32_t width, uint32_t height, bool srgb)
+{
+    _stats.requests++;
+    const size_t size = size_t(width) * height * 4;
+    uint64_t hash = hash_bytes(pixels, size);
+    hash = hash_combine(hash_combine(hash_combine(hash, width), height), srgb);
+    ContentEntry content
+    {
+        .size = size,
+        .width = width,
+        .height = height,
+        .srgb = srgb,
+        .check = hash_bytes(pixels, size, CHECK_SEED)
+    };
+    if(const uint32_t found = find_content(_by_pixels, hash, content, pixels); found != UINT32_MAX)
+    {
+        _stats.cache_hits++;
+        return found;
+    }
+
+    content.texture_id = upload(pixels, width, height, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
+    const uint32_t texture_id = content.texture_id;
+    add_content(_by_pixels, hash, std::move(content), pixels);
+    return texture_id;
+}
+
+uint32_t TextureCache::find_content(const ContentMap &map, uint64_t &key, const ContentEntry &wanted, const uint8_t *data) const
+{
+    //a material drawn with another image is worse than a texture loaded twice, so a hit has to match
+    //the second hash too (128 bits in total)
+    for(auto it = map.find(key); it != map.end(); it = map.find(key))
+    {
+        const ContentEntry &entry = it->second;
+        if(entry.size == wanted.size && entry.width == wanted.width && entry.height == wanted.height
+           && entry.srgb == wanted.srgb && entry.check == wanted.check)
+        {
+#ifndef NDEBUG
+            if(wanted.size > 0 && std::memcmp(entry.content.data(), data, wanted.size) != 0)
+                throw std::runtime_error("Texture cache: different images have the same 128 bit hash!");
+#endif
+            return entry.texture_id;
+        }
+        //other content has this key: probe the next one
+        key = hash_combine(key, 1);
+    }
+    return UINT32_MAX;
+}
+
+void TextureCache::add_content(ContentMap &map, uint64_t key, ContentEntry entry, const uint8_t *data)
+{
+#ifndef NDEBUG
+    entry.content.assign(data, data + entry.size);
+#endif
+    map.emplace(key, std::move(entry));
+}
+
+uint32_t TextureCache::upload(const uint8_t *pixels, uint32_t width, uint32_t height, VkFormat format)
+{
+    //box filter averages each byte of a texel alone, RGBA and BGRA are the same to it
+    const bool srgb = get_format_info(format)->srgb;
+    //minified surfaces read a level of about their size instead of thrashing the cache with level 0
+    const uint32_t mip_levels = get_mip_level_count(width, height);
+    const size_t level0_size = size_t(width) * height * 4;
+
+    if(can_blit_mips(format))
+        return create_texture(format, width, height, mip_levels, {std::span<const uint8_t>(pixels, level0_size)}, true);
+
+    std::vector<std::vector<uint8_t>> chain;
+    {
+        PROFILE_ZONE("cpu mips");
+        chain = build_mip_chain(pixels, width, height, mip_levels, srgb);
+    }
+    return create_texture(format, width, height, mip_levels, {chain.begin(), chain.end()}, false);
+}
+
+uint32_t TextureCache::load_ktx2(const uint8_t *data, size_t size, const std::string &path)
+{
+    Ktx2Image image;
+    std::string error;
+    if(!parse_ktx2(data, size, image, error))
+        throw std::runtime_error("Failed to load the KTX2 file " + path + ": " + error);
+
+    const VkFormat file_format = static_cast<VkFormat>(image.vk_format);
+    const std::optional<FormatInfo> info = get_format_info(file_format);
+    if(!info)
+        throw std::runtime_error("Failed to load the KTX2 file " + path + ": unsupported format " + std::to_string(image.vk_format));
+
+    //every level has to be complete
+    for(const Ktx2Image::Level &level : image.levels)
+    {
+        const size_t blocks = size_t((level.width + info->block_width - 1) / info->block_width)
+                            * ((level.height + info->block_height - 1) / info->block_height);
+        if(level.size < blocks * info->block_bytes)
+            throw std::runtime_error("Failed to load the KTX2 file " + path + ": level data is too small");
+    }
+
+    //the file format if the device can sample it, otherwise RGBA8 it can be decoded to
+    std::vector<VkFormat> candidates{file_format};
+    if(info->decoder)
+        candidates.push_back(info->srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
+    const VkFormat format = chooseSupportedFormat(_physical_device, candidates, VK_IMAGE_TILING_OPTIMAL,
+                                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+    const uint32_t mip_levels = static_cast<uint32_t>(image.levels.size());
+
+    //only level 0 in the file: the rest is generated like for image files, from 4 byte texels
+    //(KTX2 doesn`t allow it for block compressed formats, they get mips only when decoded to RGBA8)
+    const bool generate_mips = image.generate_mips && (info->block_width == 1 || format != file_format);
+    if(image.generate_mips && !generate_mips)
+        std::cerr << "Texture " << path << ": can`t generate mips of a block compressed format, one level is used\n";
+
+    uint32_t texture_id;
+    if(format == file_format)
+    {
+        //level data goes from the mapped file to staging as is
+        std::vector<std::span<const uint8_t>> levels;
+        for(const Ktx2Image::Level &level : image.levels)
+            levels.emplace_back(level.data, level.size);
+        texture_id = generate_mips ? upload(levels[0].data(), image.width, image.height, format)
+                                   : create_texture(format, image.width, image.height, mip_levels, levels, false);
+    }
+    else
+    {
+        std::vector<std::vector<uint8_t>> decoded = decode_levels(*info->decoder, image);
+        texture_id = generate_mips ? upload(decoded[0].data(), image.width, image.height, format)
+                                   : create_texture(format, image.width, image.height, mip_levels, {decoded.begin(), decoded.end()}, false);
+    }
+
+    const Texture &texture = _textures[texture_id];
+    const VkDeviceSize saved = texture.rgba8_bytes - std::min(texture.data_bytes, texture.rgba8_bytes);
+    _stats.vram_saved_bytes += saved;
+    std::cout << "Texture " << path << ": " << texture.width << "x" << texture.height << ", " << texture.mip_levels
+              << " mips, " << texture.data_bytes / 1024 << " KiB"
+              << (format == file_format ? "" : " (decoded, the device can`t sample its format)")
+              << ", " << saved / 1024 << " KiB saved vs RGBA8\n";
+    return texture_id;
+}
+
+uint32_t TextureCache::create_texture(VkFormat format, uint32_t width, uint32_t height, uint32_t mip_levels,
+                                      const std::vector<std::span<const uint8_t>> &levels, bool blit_mips)
+{
+    PROFILE_ZONE("texture upload");
+
+    Texture texture
+    {
+        .format = format,
+        .width = width,
+        .height = height,
+        .mip_levels = mip_levels
+    };
+
+    //given levels one after another in staging (offsets keep the 16 byte alignment of texel blocks)
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize staging_size = 0;
+    for(uint32_t level = 0; level < levels.size(); ++level)
+    {
+        regions.push_back(
+        {
+            .bufferOffset = staging_size,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+            .imageExtent = {std::max(width >> level, 1u), std::max(height >> level, 1u), 1}
+        });
+        staging_size += (levels[level].size() + 15) & ~VkDeviceSize(15);
+    }
+    for(uint32_t level = 0; level < mip_levels; ++level)
+    {
+        texture.rgba8_bytes += VkDeviceSize(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4;
+        texture.data_bytes += level < levels.size() && !blit_mips ? levels[level].size()
+                                                                   : VkDeviceSize(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4;
+    }
+
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_buffer_memory;
+    create_buffer(_physical_device, _logical_device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  &staging_buffer, &staging_buffer_memory);
+    uint8_t *data = nullptr;
+    vkMapMemory(_logical_device, staging_buffer_memory, 0, staging_size, 0, reinterpret_cast<void**>(&data));
+    for(uint32_t level = 0; level < levels.size(); ++level)
+        std::memcpy(data + regions[level].bufferOffset, levels[level].data(), levels[level].size());
+    vkUnmapMemory(_logical_device, staging_buffer_memory);
+
+    //levels are blitted from each other, so the image is a transfer source too
+    const VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                                  | (blit_mips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+    _stats.texture_bytes += create_image(_physical_device, _logical_device, width, height, format,
+                                         VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         texture.memory, texture.image, mip_levels);
+
+    VkCommandBuffer command_buffer = begin_one_time_commands(_logical_device, _command_pool);
+    {
+        VkImageMemoryBarrier to_transfer
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = texture.image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1}
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+        vkCmdCopyBufferToImage(command_buffer, staging_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()), regions.data());
+
+        if(blit_mips)
+        {
+            record_blit_mips(command_buffer, texture);
+        }
+        else
+        {
+            VkImageMemoryBarrier to_shader = to_transfer;
+            to_shader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            to_shader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            to_shader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            to_shader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &to_shader);
+        }
+    }
+    end_one_time_commands(_logical_device, _queue, _command_pool, command_buffer);
+
+    vkDestroyBuffer(_logical_device, staging_buffer, nullptr);
+    vkFreeMemory(_logical_device, staging_buffer_memory, nullptr);
+    _stats.uploaded_bytes += staging_size;
+
+    texture.image_view = create_image_view(_logical_device, texture.image, format, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels);
+    if(_heap)
+        texture.handle = _heap->add_image(texture.image_view);
+
+    _textures.push_back(texture);
+    _stats.textures = static_cast<uint32_t>(_textures.size());
+    return static_cast<uint32_t>(_textures.size() - 1);
+}
+
+bool TextureCache::can_blit_mips(VkFormat format) const
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(_physical_device, format, &properties);
+    const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+                                      | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & needed) == needed;
+}
+
+void TextureCache::record_blit_mips(VkCommandBuffer command_buffer, const Texture &texture)
+{
+    //every level is downsampled from the one above: it becomes a blit source once written,
+    //and is ready for shaders once the next level is done
+    VkImageMemoryBarrier barrier
+    {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = texture.image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+    };
+
+    int32_t width = int32_t(texture.width);
+    int32_t height = int32_t(texture.height);
+    for(uint32_t level = 1; level < texture.mip_levels; ++level)
+    {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        const int32_t next_width = std::max(width / 2, 1);
+        const int32_t next_height = std::max(height / 2, 1);
+        VkImageBlit blit
+        {
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+            .srcOffsets = {{0, 0, 0}, {width, height, 1}},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+            .dstOffsets = {{0, 0, 0}, {next_width, next_height, 1}}
+        };
+        //sRGB texels are filtered as linear values
+        vkCmdBlitImage(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        width = next_width;
+        height = next_height;
+    }
+
+    //last level is only written
+    barrier.subresourceRange.baseMipLevel = texture.mip_levels - 1;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+TextureCache::SamplerEntry& TextureCache::get_sampler_entry(const SamplerDesc &desc)
+{
+    uint64_t hash = hash_value(desc.filter);
+    hash = hash_combine(hash, desc.mipmap_mode);
+    hash = hash_combine(hash, desc.address_mode);
+    hash = hash_combine(hash, hash_value(desc.max_anisotropy));
+
+    std::vector<SamplerEntry> &entries = _samplers[hash];
+    for(SamplerEntry &entry : entries)
+        if(entry.desc == desc)
+            return entry;
+
+    const float anisotropy = std::min(desc.max_anisotropy, _max_anisotropy);
+    VkSamplerCreateInfo create_info
+    {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = desc.filter,
+        .minFilter = desc.filter,
+        .mipmapMode = desc.mipmap_mode,
+        .addressModeU = desc.address_mode,
+        .addressModeV = desc.address_mode,
+        .addressModeW = desc.address_mode,
+        .mipLodBias = 0.f,
+        .anisotropyEnable = anisotropy > 1.f ? VK_TRUE : VK_FALSE,
+        .maxAnisotropy = std::max(anisotropy, 1.f),
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.f,
+        //whole chain
+        .maxLod = VK_LOD_CLAMP_NONE,
+        .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+
+    SamplerEntry entry{.desc = desc, .handle = BindlessHeap::INVALID_HANDLE};
+    VkResult res = vkCreateSampler(_logical_device, &create_info, nullptr, &entry.sampler);
+    if(res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create a sampler!");
+    }
+    if(_heap)
+        entry.handle = _heap->add_sampler(entry.sampler);
+
+    entries.push_back(entry);
+    _stats.samplers++;
+    return entries.back();
+}
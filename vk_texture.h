@@ -0,0 +1,144 @@
+#pragma once
+
+#include "vk_utils.h"
+#include "vk_bindless.h"
+
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Sampled 2D image with its whole mip chain
+struct Texture
+{
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView image_view = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mip_levels = 1;
+    //texel data of all levels, and what it would be as RGBA8 (block compression saves the difference)
+    VkDeviceSize data_bytes = 0;
+    VkDeviceSize rgba8_bytes = 0;
+    //slot in the bindless heap (DrawHandles::texture), INVALID_HANDLE without the heap
+    uint32_t handle = BindlessHeap::INVALID_HANDLE;
+};
+
+struct SamplerDesc
+{
+    VkFilter filter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmap_mode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    //clamped to the device limit, 1 -- off
+    float max_anisotropy = 8.f;
+
+    bool operator==(const SamplerDesc &other) const = default;
+};
+
+//Textures and samplers, each created once
+//Textures are keyed by a hash of their content (file bytes or pixels, in separate maps), so the same image
+//is uploaded once however many paths or materials refer to it. A hit is shared only if size (and width, height,
+//srgb) and a second hash of the bytes match too (debug builds compare the bytes). Uploads go through a staging buffer, the mip chain is generated
+//on the GPU with linear blits (or on the CPU for formats that can`t be blitted with a linear filter).
+//KTX2 files keep their (block compressed) format and mips: level data is copied from the mapped file
+//into staging as is. Devices without the format get it decoded to RGBA8 on worker threads (BC1-3).
+//Equal sampler descs share one VkSampler (and bindless slot).
+class TextureCache
+{
+public:
+    struct Stats
+    {
+        //load / add calls
+        uint64_t requests = 0;
+        //served from the cache, nothing decoded or uploaded
+        uint64_t cache_hits = 0;
+        uint32_t textures = 0;
+        uint32_t samplers = 0;
+        //device memory of all textures (with mips)
+        uint64_t texture_bytes = 0;
+        uint64_t uploaded_bytes = 0;
+        //RGBA8 size - texel data size of block compressed textures
+        uint64_t vram_saved_bytes = 0;
+    };
+
+    TextureCache() = default;
+
+    //max_anisotropy 0 -- samplerAnisotropy is not enabled, heap can be nullptr (no bindless registration)
+    void create(VkPhysicalDevice p_device, VkDevice l_device, VkQueue queue, VkCommandPool command_pool,
+                BindlessHeap *heap, float max_anisotropy);
+    void destroy();
+
+    //KTX2 or an image file (see decode_image), returns texture_id
+    //srgb is for image files, KTX2 has it in its format
+    //throws if the file can`t be read or decoded, or its format can`t be sampled
+    uint32_t load(const std::string &path, bool srgb = true);
+    //8 bit RGBA pixels, rows top to bottom
+    uint32_t add_rgba8(const uint8_t *pixels, uint32_t width, uint32_t height, bool srgb = true);
+
+    const Texture& get(uint32_t texture_id) const { return _textures[texture_id]; }
+    VkSampler get_sampler(const SamplerDesc &desc) { return get_sampler_entry(desc).sampler; }
+    //slot in the bindless heap (DrawHandles::sampler)
+    uint32_t get_sampler_handle(const SamplerDesc &desc) { return get_sampler_entry(desc).handle; }
+
+    const Stats& get_stats() const { return _stats; }
+
+private:
+    //seed of the second hash, with the key it makes a 128 bit fingerprint
+    static constexpr uint64_t CHECK_SEED = 0x9E3779B97F4A7C15ull;
+
+    struct SamplerEntry
+    {
+        SamplerDesc desc;
+        VkSampler sampler;
+        uint32_t handle;
+    };
+
+    //what the content key was made of, all of it has to match on a hit
+    struct ContentEntry
+    {
+        uint32_t texture_id = UINT32_MAX;
+        size_t size = 0;
+        //pixels only (0 for files)
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool srgb = false;
+        uint64_t check = 0;
+#ifndef NDEBUG
+        std::vector<uint8_t> content;
+#endif
+    };
+    using ContentMap = std::unordered_map<uint64_t, ContentEntry>;
+
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    VkCommandPool _command_pool = VK_NULL_HANDLE;
+    BindlessHeap *_heap = nullptr;
+    float _max_anisotropy = 0.f;
+
+    std::vector<Texture> _textures;
+    //hash of the file bytes / of RGBA8 pixels -> texture
+    //content colliding with other content is stored under the next free key (see find_content)
+    ContentMap _by_file;
+    ContentMap _by_pixels;
+    //path -> texture_id, a file loaded before isn`t even read again
+    std::unordered_map<std::string, uint32_t> _by_path;
+    //by hash of the desc
+    std::unordered_map<uint64_t, std::vector<SamplerEntry>> _samplers;
+    Stats _stats;
+
+    //texture_id of this content, UINT32_MAX if there is none (key is left at the free slot for add_content)
+    uint32_t find_content(const ContentMap &map, uint64_t &key, const ContentEntry &wanted, const uint8_t *data) const;
+    void add_content(ContentMap &map, uint64_t key, ContentEntry entry, const uint8_t *data);
+    //4 byte texels (RGBA8 / BGRA8 format), mips are generated
+    uint32_t upload(const uint8_t *pixels, uint32_t width, uint32_t height, VkFormat format);
+    uint32_t load_ktx2(const uint8_t *data, size_t size, const std::string &path);
+    //image with the given levels (largest first), blit_mips -- only level 0 is given, the rest is blitted
+    uint32_t create_texture(VkFormat format, uint32_t width, uint32_t height, uint32_t mip_levels,
+                            const std::vector<std::span<const uint8_t>> &levels, bool blit_mips);
+    //mip chain with linear blits, false if the format can`t do it
+    bool can_blit_mips(VkFormat format) const;
+    void record_blit_mips(VkCommandBuffer command_buffer, const Texture &texture);
+    SamplerEntry& get_sampler_entry(const SamplerDesc &desc);
+};
@@ -0,0 +1,92 @@
+#include "vk_uniform_ring.h"
+
+#include <algorithm>
+
+void UniformRing::create(VkPhysicalDevice p_device, VkDevice l_device, uint32_t frames_in_flight, VkDeviceSize chunk_size)
+{
+    _physical_device = p_device;
+    _logical_device = l_device;
+
+    VkPhysicalDeviceProperties device_props;
+    vkGetPhysicalDeviceProperties(p_device, &device_props);
+    //dynamic offsets must be multiples of it (power of 2)
+    _alignment = std::max<VkDeviceSize>(device_props.limits.minUniformBufferOffsetAlignment, 16);
+    _max_range = device_props.limits.maxUniformBufferRange;
+    _chunk_size = chunk_size;
+
+    //written by CPU every frame, read once by GPU: device local + host visible (resizable BAR) if there is such memory
+    _memory_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if(is_memory_type_supported(p_device, _memory_flags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+        _memory_flags |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    _frames.resize(frames_in_flight);
+    for(Frame &frame : _frames)
+        frame.chunks.push_back(create_chunk(_chunk_size));
+    _frame = 0;
+}
+
+void UniformRing::destroy()
+{
+    for(Frame &frame : _frames)
+        for(Chunk &chunk : frame.chunks)
+        {
+            vkUnmapMemory(_logical_device, chunk.memory);
+            vkDestroyBuffer(_logical_device, chunk.buffer, nullptr);
+            vkFreeMemory(_logical_device, chunk.memory, nullptr);
+        }
+    _frames.clear();
+}
+
+void UniformRing::begin_frame(uint32_t frame)
+{
+    _frame = frame;
+    _frames[frame].current = 0;
+    _frames[frame].offset = 0;
+    _frame_bytes = 0;
+}
+
+UniformRing::Allocation UniformRing::allocate(VkDeviceSize size)
+{
+    if(size > _max_range)
+        throw std::runtime_error("Uniform data is bigger than maxUniformBufferRange!");
+
+    Frame &frame = _frames[_frame];
+    //end of the last allocation, padding up to the new one counts as handed out
+    VkDeviceSize start = frame.offset;
+    //align up (alignment is a power of 2)
+    VkDeviceSize offset = (frame.offset + _alignment - 1) & ~(_alignment - 1);
+    if(offset + size > frame.chunks[frame.current].size)
+    {
+        //next chunk of this frame, new one if the frame never needed that much
+        //or the next one is too small for this allocation (the small one is kept, it comes after)
+        frame.current++;
+        if(frame.current == frame.chunks.size() || frame.chunks[frame.current].size < size)
+            frame.chunks.insert(frame.chunks.begin() + frame.current, create_chunk(std::max(_chunk_size, size)));
+        start = 0;
+        offset = 0;
+    }
+
+    Chunk &chunk = frame.chunks[frame.current];
+    frame.offset = offset + size;
+    _frame_bytes += offset + size - start;
+    return {chunk.buffer, static_cast<uint32_t>(offset), chunk.mapped + offset};
+}
+
+size_t UniformRing::get_chunk_count() const
+{
+    size_t count = 0;
+    for(const Frame &frame : _frames)
+        count += frame.chunks.size();
+    return count;
+}
+
+UniformRing::Chunk UniformRing::create_chunk(VkDeviceSize size)
+{
+    Chunk chunk{};
+    chunk.size = size;
+    create_buffer(_physical_device, _logical_device, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, _memory_flags,
+                  &chunk.buffer, &chunk.memory);
+    //mapped for the whole life, coherent so no flushes
+    vkMapMemory(_logical_device, chunk.memory, 0, size, 0, reinterpret_cast<void**>(&chunk.mapped));
+    return chunk;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vk_utils.h"
+
+#include <cstring>
+#include <vector>
+
+//Per-frame ring of uniform buffer space for VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC bindings
+//Constants of any size are bump allocated (aligned to minUniformBufferOffsetAlignment) from persistently mapped
+//chunks of the current frame; a frame gets more chunks when it runs out, so there is no object limit.
+//Chunks of a frame are rewound once its fence is waited, a steady frame allocates no memory.
+class UniformRing
+{
+public:
+    struct Allocation
+    {
+        VkBuffer buffer;
+        //dynamic offset for vkCmdBindDescriptorSets
+        uint32_t offset;
+        void *data;
+    };
+
+    UniformRing() = default;
+
+    void create(VkPhysicalDevice p_device, VkDevice l_device, uint32_t frames_in_flight,
+                VkDeviceSize chunk_size = 256 * 1024);
+    void destroy();
+
+    //fence of the frame has signaled, its space can be written again
+    void begin_frame(uint32_t frame);
+
+    Allocation allocate(VkDeviceSize size);
+    template<typename T>
+    Allocation push(const T &value)
+    {
+        Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    VkDeviceSize get_alignment() const { return _alignment; }
+    //bytes handed out in the current frame (with the alignment padding in front of each allocation,
+    //not the unused end of a chunk the frame moved on from)
+    VkDeviceSize get_frame_bytes() const { return _frame_bytes; }
+    size_t get_chunk_count() const;
+
+private:
+    struct Chunk
+    {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        uint8_t *mapped;
+        VkDeviceSize size;
+    };
+    struct Frame
+    {
+        std::vector<Chunk> chunks;
+        size_t current = 0;
+        VkDeviceSize offset = 0;
+    };
+
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkDevice _logical_device = VK_NULL_HANDLE;
+    VkMemoryPropertyFlags _memory_flags = 0;
+    VkDeviceSize _alignment = 256;
+    VkDeviceSize _max_range = 16384;
+    VkDeviceSize _chunk_size = 0;
+
+    std::vector<Frame> _frames;
+    uint32_t _frame = 0;
+    VkDeviceSize _frame_bytes = 0;
+
+    Chunk create_chunk(VkDeviceSize size);
+};
@@ -1,5 +1,8 @@
+#include <cstring>
 #include <iostream>
 #include "vk_utils.h"
+#include "mapped_file.h"
+#include "profiler.h"
 
 static uint32_t find_memory_type_index(const VkPhysicalDevice p_device, uint32_t allowed_types/*defined by buffer*/, VkMemoryPropertyFlags properties/*defined by ourselfs*/)
 {
@@ -17,8 +20,22 @@ static uint32_t find_memory_type_index(const VkPhysicalDevice p_device, uint32_t
         if(is_type_allowed && is_type_flags_match)
             return i;
     }
+
+    throw std::runtime_error("Failed to find a suitable memory type!");
 };
 
+bool is_memory_type_supported(const VkPhysicalDevice p_device, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties physical_properties;
+    vkGetPhysicalDeviceMemoryProperties(p_device, &physical_properties);
+
+    for(uint32_t i = 0; i < physical_properties.memoryTypeCount; ++i)
+        if((physical_properties.memoryTypes[i].propertyFlags & properties) == properties)
+            return true;
+
+    return false;
+}
+
 void create_buffer(const VkPhysicalDevice p_device, VkDevice l_device, VkDeviceSize buffer_size,
                    VkBufferUsageFlags buffer_usage_falgs, VkMemoryPropertyFlags buffer_property_falgs,
                    VkBuffer *vertex_buffer, VkDeviceMemory *vertex_buffer_memory)
@@ -66,16 +83,83 @@ void create_buffer(const VkPhysicalDevice p_device, VkDevice l_device, VkDeviceS
 void copy_buffer(VkDevice l_device, VkQueue transfer_queue, VkCommandPool transfer_command_pool,
                  VkBuffer src, VkBuffer dst, VkDeviceSize buffer_size)
 {
+    PROFILE_ZONE("copy_buffer");
+
     //buffer to hold transfer commands
-    VkCommandBuffer transfer_command_buffer;
-    VkCommandBufferAllocateInfo  transfer_command_buffer_alloc_info
+    VkCommandBuffer transfer_command_buffer = begin_one_time_commands(l_device, transfer_command_pool);
+
+    //Details of what to copy where
+    VkBufferCopy buffer_copy_region
+    {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = buffer_size
+    };
+    vkCmdCopyBuffer(transfer_command_buffer, src, dst, 1, &buffer_copy_region);
+
+    end_one_time_commands(l_device, transfer_queue, transfer_command_pool, transfer_command_buffer);
+}
+
+void upload_to_buffer(const VkPhysicalDevice p_device, VkDevice l_device, VkQueue transfer_queue, VkCommandPool transfer_command_pool,
+                      const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize staging_size)
+{
+    auto copy = [data](uint8_t *staging, VkDeviceSize offset, VkDeviceSize chunk)
+    {
+        std::memcpy(staging, static_cast<const uint8_t*>(data) + offset, chunk);
+    };
+    upload_to_buffer(p_device, l_device, transfer_queue, transfer_command_pool, copy, size, dst, dst_offset, staging_size);
+}
+
+void upload_to_buffer(const VkPhysicalDevice p_device, VkDevice l_device, VkQueue transfer_queue, VkCommandPool transfer_command_pool,
+                      const std::function<void(uint8_t *staging, VkDeviceSize offset, VkDeviceSize size)> &fill,
+                      VkDeviceSize size, VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize staging_size)
+{
+    PROFILE_ZONE("upload_to_buffer");
+    if(size == 0)
+        return;
+
+    staging_size = std::min(size, staging_size);
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_buffer_memory;
+    create_buffer(p_device, l_device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  &staging_buffer, &staging_buffer_memory);
+    void *staging = nullptr;
+    vkMapMemory(l_device, staging_buffer_memory, 0, staging_size, 0, &staging);
+
+    //copy of a chunk has finished (queue is idle) before the next one overwrites staging
+    for(VkDeviceSize offset = 0; offset < size; offset += staging_size)
+    {
+        const VkDeviceSize chunk = std::min(staging_size, size - offset);
+        fill(static_cast<uint8_t*>(staging), offset, chunk);
+
+        VkCommandBuffer command_buffer = begin_one_time_commands(l_device, transfer_command_pool);
+        VkBufferCopy region
+        {
+            .srcOffset = 0,
+            .dstOffset = dst_offset + offset,
+            .size = chunk
+        };
+        vkCmdCopyBuffer(command_buffer, staging_buffer, dst, 1, &region);
+        end_one_time_commands(l_device, transfer_queue, transfer_command_pool, command_buffer);
+    }
+
+    vkUnmapMemory(l_device, staging_buffer_memory);
+    vkDestroyBuffer(l_device, staging_buffer, nullptr);
+    vkFreeMemory(l_device, staging_buffer_memory, nullptr);
+}
+
+VkCommandBuffer begin_one_time_commands(VkDevice l_device, VkCommandPool command_pool)
+{
+    VkCommandBuffer command_buffer;
+    VkCommandBufferAllocateInfo alloc_info
     {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = transfer_command_pool,
+        .commandPool = command_pool,
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = 1
     };
-    vkAllocateCommandBuffers(l_device, &transfer_command_buffer_alloc_info, &transfer_command_buffer);
+    vkAllocateCommandBuffers(l_device, &alloc_info, &command_buffer);
 
     VkCommandBufferBeginInfo begin_info
     {
@@ -83,30 +167,25 @@ void copy_buffer(VkDevice l_device, VkQueue transfer_queue, VkCommandPool transf
         //one time usage of this buffer
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
     };
-    //Start recording transfer commands
-    vkBeginCommandBuffer(transfer_command_buffer, &begin_info);
-    
-    //Details of what to copy where
-    VkBufferCopy buffer_copy_region
-    {
-        .srcOffset = 0,
-        .dstOffset = 0,
-        .size = buffer_size
-    };
-    vkCmdCopyBuffer(transfer_command_buffer, src, dst, 1, &buffer_copy_region);
+    //Start recording commands
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    return command_buffer;
+}
 
-    vkEndCommandBuffer(transfer_command_buffer);
+void end_one_time_commands(VkDevice l_device, VkQueue queue, VkCommandPool command_pool, VkCommandBuffer command_buffer)
+{
+    vkEndCommandBuffer(command_buffer);
 
     VkSubmitInfo submit_info
     {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .commandBufferCount = 1,
-        .pCommandBuffers = &transfer_command_buffer
+        .pCommandBuffers = &command_buffer
     };
-    vkQueueSubmit(transfer_queue, 1, &submit_info, VK_NULL_HANDLE);
+    vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
 
-    vkQueueWaitIdle(transfer_queue);
-    vkFreeCommandBuffers(l_device, transfer_command_pool, 1, &transfer_command_buffer);
+    vkQueueWaitIdle(queue);
+    vkFreeCommandBuffers(l_device, command_pool, 1, &command_buffer);
 }
 
 QueueFamilyIndices get_queue_families_for_device(const VkPhysicalDevice &device, const VkSurfaceKHR &surface)
@@ -119,7 +198,7 @@ QueueFamilyIndices get_queue_families_for_device(const VkPhysicalDevice &device,
     vkGetPhysicalDeviceQueueFamilyProperties(device, &count, qfp.data());
 
     //check that at least one queue family has at least 1 type of needed quque
-    for(uint32_t indx = 0; indx <= count; indx++)
+    for(uint32_t indx = 0; indx < count; indx++)
     {
         const auto &qfamily = qfp[indx];
         if(qfamily.queueCount > 0 and qfamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
@@ -128,8 +207,10 @@ QueueFamilyIndices get_queue_families_for_device(const VkPhysicalDevice &device,
         }
 
         //check if a queue family(of this device) supports a surface
-        VkBool32 presentation_family_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, indx, surface, &presentation_family_support);
+        //without a surface (headless) there is nothing to present, graphics queue is enough
+        VkBool32 presentation_family_support = surface == VK_NULL_HANDLE;
+        if(surface != VK_NULL_HANDLE)
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, indx, surface, &presentation_family_support);
         //chech if queue is presentation type (can be both graphics and pressentation)
         if(qfamily.queueCount > 0 and presentation_family_support)
             indecies.presentation_family = indx;
@@ -226,7 +307,8 @@ SwapchainCreationDetails get_swapchain_details_for_device(const VkPhysicalDevice
     return details;
 }
 
-VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags)
+VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags,
+                              uint32_t mip_levels)
 {
     VkImageViewCreateInfo create_info =
     {
@@ -252,7 +334,7 @@ VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, V
             //Which aspect of the image to view
             .aspectMask = aspect_flags,
             .baseMipLevel = 0, //Start MIPMAP level to view from
-            .levelCount = 1, // NUM of mipmap levels to view from
+            .levelCount = mip_levels, // NUM of mipmap levels to view from
             .baseArrayLayer = 0, //Start array level to view from 
             .layerCount = 1,
         }
@@ -267,10 +349,10 @@ VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, V
     return image_view;
 }
 
-void create_image(const VkPhysicalDevice p_device, VkDevice device, uint32_t width, uint32_t height,
-                  VkFormat format, VkImageTiling tiling/*interesting!*/,
-                  VkImageUsageFlags use_flags, VkMemoryPropertyFlags mem_flags,
-                  VkDeviceMemory &image_memory, VkImage &image)
+VkDeviceSize create_image(const VkPhysicalDevice p_device, VkDevice device, uint32_t width, uint32_t height,
+                          VkFormat format, VkImageTiling tiling/*interesting!*/,
+                          VkImageUsageFlags use_flags, VkMemoryPropertyFlags mem_flags,
+                          VkDeviceMemory &image_memory, VkImage &image, uint32_t mip_levels)
 {
     //Create image
     VkImageCreateInfo create_info
@@ -280,8 +362,8 @@ void create_image(const VkPhysicalDevice p_device, VkDevice device, uint32_t wid
         .format = format,
         //depth 1 -- no 3d aspect
         .extent = {.width = width, .height = height, .depth = 1},
-        //LoD, 1 mipmap level
-        .mipLevels = 1,
+        //LoD, 1 -- no mipmaps (attachments)
+        .mipLevels = mip_levels,
         //often used for cubemaps
         .arrayLayers = 1,
         //no multisampling for now
@@ -321,6 +403,8 @@ void create_image(const VkPhysicalDevice p_device, VkDevice device, uint32_t wid
 
     //Connect memory to image
     vkBindImageMemory(device, image, image_memory, 0);
+
+    return memory_reqs.size;
 }
 
 VkFormat chooseSupportedFormat(const VkPhysicalDevice p_device, const std::vector<VkFormat> &formats, VkImageTiling tiling, VkFormatFeatureFlags feature_flags)
@@ -343,13 +427,13 @@ VkFormat chooseSupportedFormat(const VkPhysicalDevice p_device, const std::vecto
     throw std::runtime_error("Failed to find supported image format!");
 }
 
-VkShaderModule create_shader_module(VkDevice logical_device, std::vector<char> &shader_code)
+VkShaderModule create_shader_module(VkDevice logical_device, std::span<const uint32_t> shader_code)
 {
     VkShaderModuleCreateInfo create_info
     {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = shader_code.size(),
-        .pCode = reinterpret_cast<const uint32_t*>(shader_code.data())
+        .codeSize = shader_code.size_bytes(),
+        .pCode = shader_code.data()
     };
 
     VkShaderModule shader_module;
@@ -361,3 +445,14 @@ VkShaderModule create_shader_module(VkDevice logical_device, std::vector<char> &
 
     return shader_module;
 }
+
+VkShaderModule load_shader_module(VkDevice logical_device, const std::string &path)
+{
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+    //the driver reads all of it at once
+    MappedFile file(path, MappedFile::Access::WholeFile);
+    if(file.size() == 0 || file.size() % sizeof(uint32_t) != 0 || file.as_span<uint32_t>()[0] != SPIRV_MAGIC)
+        throw std::runtime_error("Failed to load the shader " + path + ": it isn`t SPIR-V!");
+    //mapping can go once the module is created, the driver keeps its own copy
+    return create_shader_module(logical_device, file.as_span<uint32_t>());
+}
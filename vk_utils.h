@@ -3,9 +3,12 @@
 #define GLFW_INCLUDE_VULKAN
 #include <glfw/glfw3.h>
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <functional>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <vector>
-#include <fstream>
 
 struct Vertex
 {
@@ -13,12 +16,28 @@ struct Vertex
     glm::vec3 color;
 };
 
+//is there any memory type with all of these properties (e.g. HOST_CACHED)
+bool is_memory_type_supported(const VkPhysicalDevice p_device, VkMemoryPropertyFlags properties);
+
 void create_buffer(const VkPhysicalDevice p_device, VkDevice l_device, VkDeviceSize buffer_size,
                    VkBufferUsageFlags buffer_usage_falgs, VkMemoryPropertyFlags buffer_property_falgs,
                    VkBuffer *vertex_buffer, VkDeviceMemory *vertex_buffer_memory);
 
 void copy_buffer(VkDevice l_device, VkQueue transfer_queue, VkCommandPool transfer_command_pool,
                  VkBuffer src, VkBuffer dst, VkDeviceSize buffer_size);
+//host data -> dst at dst_offset, through one staging buffer of at most staging_size reused for every chunk
+//(data can be far larger than host visible memory, e.g. a mapped file)
+void upload_to_buffer(const VkPhysicalDevice p_device, VkDevice l_device, VkQueue transfer_queue, VkCommandPool transfer_command_pool,
+                      const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dst_offset = 0,
+                      VkDeviceSize staging_size = 64 << 20);
+//same, fill writes bytes [offset, offset + size) of the data to staging (e.g. decompresses them there)
+void upload_to_buffer(const VkPhysicalDevice p_device, VkDevice l_device, VkQueue transfer_queue, VkCommandPool transfer_command_pool,
+                      const std::function<void(uint8_t *staging, VkDeviceSize offset, VkDeviceSize size)> &fill,
+                      VkDeviceSize size, VkBuffer dst, VkDeviceSize dst_offset = 0, VkDeviceSize staging_size = 64 << 20);
+
+//one time command buffer: begin records into a new buffer, end submits it, waits for the queue and frees it
+VkCommandBuffer begin_one_time_commands(VkDevice l_device, VkCommandPool command_pool);
+void end_one_time_commands(VkDevice l_device, VkQueue queue, VkCommandPool command_pool, VkCommandBuffer command_buffer);
 
 //store indices(locations) of queue families
 struct QueueFamilyIndices
@@ -28,7 +47,8 @@ struct QueueFamilyIndices
 
     bool is_valid()
     {
-        return graphics_family >= 0 && presentation_family >= 0;
+        //-1 (max uint) means family was not found
+        return graphics_family != uint32_t(-1) && presentation_family != uint32_t(-1);
     }
 };
 
@@ -66,31 +86,22 @@ struct SwapchainImage
     VkImageView image_view;
 };
 
-VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags);
-void create_image(const VkPhysicalDevice p_device, VkDevice device, uint32_t width, uint32_t height,
-                  VkFormat format, VkImageTiling tiling/*interesting!*/,
-                  VkImageUsageFlags use_flags, VkMemoryPropertyFlags mem_flags,
-                  VkDeviceMemory &image_memory, VkImage &image);
-VkFormat chooseSupportedFormat(const VkPhysicalDevice p_device, const std::vector<VkFormat> &formats, VkImageTiling tiling, VkFormatFeatureFlags feature_flags);
-VkShaderModule create_shader_module(VkDevice logical_device, std::vector<char> &shader_code);
-
-//read as binary, spv is binary
-inline std::vector<char> read_f(const std::string &filename)
+VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags,
+                              uint32_t mip_levels = 1);
+//returns size of the allocated memory
+VkDeviceSize create_image(const VkPhysicalDevice p_device, VkDevice device, uint32_t width, uint32_t height,
+                          VkFormat format, VkImageTiling tiling/*interesting!*/,
+                          VkImageUsageFlags use_flags, VkMemoryPropertyFlags mem_flags,
+                          VkDeviceMemory &image_memory, VkImage &image, uint32_t mip_levels = 1);
+//full chain down to 1x1
+inline uint32_t get_mip_level_count(uint32_t width, uint32_t height)
 {
-    //ate -- put the pointer to the end, toget size
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    if(!file.is_open())
-    {
-        throw std::runtime_error("Failed to open the file: " + filename);
-    }
-
-    size_t file_size = static_cast<size_t>(file.tellg());
-    std::vector<char> file_buffer(file_size);
-
-    file.seekg(0);
-    //read the whole file
-    file.read(file_buffer.data(), file_size);
-    file.close();
-
-    return file_buffer;
-}
\ No newline at end of file
+    uint32_t levels = 1;
+    for(uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+VkFormat chooseSupportedFormat(const VkPhysicalDevice p_device, const std::vector<VkFormat> &formats, VkImageTiling tiling, VkFormatFeatureFlags feature_flags);
+VkShaderModule create_shader_module(VkDevice logical_device, std::span<const uint32_t> shader_code);
+//.spv file straight from its mapping (words are aligned, nothing is copied), throws if it isn`t SPIR-V
+VkShaderModule load_shader_module(VkDevice logical_device, const std::string &path);
\ No newline at end of file
@@ -7,41 +7,83 @@
 #include <set>
 #include <array>
 #include <algorithm>
+#include <thread>
+#include <chrono>
 
 #include "io_utils.h"
+#include "mapped_file.h"
+#include "geometry_codec.h"
+#include "mesh_file.h"
+#include "mesh_import.h"
+#include "profiler.h"
 
 int VulkanRenderer::init(GLFWwindow *new_window)
 {
     _window = new_window;
+    _headless = false;
 
+    return init_renderer();
+}
+
+int VulkanRenderer::init_headless(uint32_t width, uint32_t height)
+{
+    _window = nullptr;
+    _headless = true;
+    //there is no surface to take extent from
+    _swapchain_extent = {.width = width, .height = height};
+
+    return init_renderer();
+}
+
+int VulkanRenderer::init_renderer()
+{
+    const uint64_t init_begin_ns = profiler::now_ns();
     try
     {
         create_instance();
-        create_surface();
+        if(!_headless)
+            create_surface();
         get_physical_device();
         create_logical_device();
         //get our graphics queue (VkQueue) from logical device
         //place references to the logical device -> queue family -> specific queue index into VK Queue
         vkGetDeviceQueue(_main_device.logical_device, _main_device.queue_indicies.graphics_family, 0, &_graphics_queue);
-        vkGetDeviceQueue(_main_device.logical_device, _main_device.queue_indicies.presentation_family, 0, &_presentation_queue);
+        if(!_headless)
+            vkGetDeviceQueue(_main_device.logical_device, _main_device.queue_indicies.presentation_family, 0, &_presentation_queue);
         //so far we checked that device supports presenting to our surface and created the queue that allows us to do that
-        
-        create_swapchain();
+
+        if(_headless)
+            create_offscreen_images();
+        else
+            create_swapchain();
         create_depth_buffer_image();
-        create_render_pass();
+        //attachments are given at record time with dynamic rendering
+        if(!_optional_features.dynamic_rendering)
+            _render_pass = create_render_pass(_color_final_layout);
         //_descriptor_set_layout needed by pipline
         create_descriptor_set_layout();
         create_push_constant_range();
+        //set 1 of the pipeline layout
+        if(_optional_features.descriptor_indexing)
+            create_bindless_heap();
+        _pipeline_cache.create(_main_device.physical_device, _main_device.logical_device);
         create_graphics_pipeline();
-        create_framebuffers();
+        if(!_optional_features.dynamic_rendering)
+            create_framebuffers();
         create_command_pool();
         create_command_buffers();
+        _geometry.create(_main_device.physical_device, _main_device.logical_device, _graphics_queue, _graphics_command_pool);
+        create_texture_cache();
         //UBO stuff
-        //dynamic buffer stuff -- redundant
-        //allocate_dynamic_buffers_transfer_space();
         create_uniform_buffers();
-        create_descriptor_pool();
-        create_descriptor_sets();
+        //per draw constants, rewound together with the frame
+        _uniform_ring.create(_main_device.physical_device, _main_device.logical_device, MAX_FRAME_DRAWS);
+        //sets for 1 frame in flight are reset together once its fence is waited
+        _descriptor_allocator.create(_main_device.logical_device, MAX_FRAME_DRAWS);
+        create_light_clusters();
+        //copies are recorded by the frames, so they share the frames in flight
+        _streamer.create(_main_device.physical_device, _main_device.logical_device, MAX_FRAME_DRAWS,
+                         STREAMING_BUDGET, STREAMING_STAGING_SIZE);
 
         _ubo_vp.projection = glm::perspective(glm::radians(45.f), //setting th angle of Y axis of the camera
                                            float(_swapchain_extent.width)/float(_swapchain_extent.height), //aspect ratio
@@ -57,40 +99,11 @@ int VulkanRenderer::init(GLFWwindow *new_window)
                                 glm::vec3(0.f, 1.f, 2.f) //up -- how to orientate
                                 );
 
-        //create a mesh
-        //vertex data
-        std::vector<Vertex> mesh_vertices =
-		{
-			{{-0.4,-0.2,0.0}, {1.,0.,0.}}, //0 shared
-			{{0.0,0.6,0.0}, {1.,0.,0.}}, //1 shared
-			{{-0.8,0.2,0.0}, {1.,1.,0.}}, //2
-			{{-0.8,-0.2,0.0}, {1.,1.,0.}}, //3
-        };
-		std::vector<Vertex> mesh_vertices2 =
-        {
-            {{0.4,0.2,0.0}, {0.,1.,0.}}, //0 shared
-            {{0.0,-0.6,0.0}, {0.,1.,0.}}, //1 shared
-            {{0.8,-0.2,0.0}, {0.,1.,0.}}, //2
-            {{0.8,0.2,0.0}, {1.,1.,0.}}, //3
-        };
-        //index data
-        std::vector<uint32_t> mesh_indices =
-        {
-            0, 1, 2,
-            2, 3, 0
-        };
-        Mesh mesh = Mesh(_main_device.physical_device, _main_device.logical_device,
-                           _graphics_queue, _graphics_command_pool,
-                           mesh_vertices, mesh_indices);
-        _meshes.push_back(mesh);
-        
-        mesh = Mesh(_main_device.physical_device, _main_device.logical_device,
-                           _graphics_queue, _graphics_command_pool,
-                           mesh_vertices2, mesh_indices);
-        _meshes.push_back(mesh);
-
+        //meshes are added by the application (add_mesh)
 
         create_synchronization();
+        create_timestamp_queries();
+        create_overdraw_queries();
     }
     catch (std::runtime_error &e)
     {
@@ -98,23 +111,64 @@ int VulkanRenderer::init(GLFWwindow *new_window)
         return EXIT_FAILURE;
     }
 
+    _stats.init_ms = double(profiler::now_ns() - init_begin_ns) / 1e6;
+    _stats.pipeline_cache_warm = _pipeline_cache.is_warm();
+    std::cout << bold_on << "Renderer init: " << _stats.init_ms << " ms ("
+              << (_stats.pipeline_cache_warm ? "warm" : "cold") << " pipeline cache)\n" << bold_off;
+    if(_stats.lazy_attachment_bytes > 0)
+        std::cout << "Transient attachments: " << _stats.lazy_attachment_bytes / 1024 << " KiB lazily allocated\n";
+
     return EXIT_SUCCESS;
 }
 
 void VulkanRenderer::draw()
 {
+    PROFILE_ZONE("draw");
+
     //wait for the previous frame with same index to be submitted and drawn
     //(like  mutex, it`s locked here and unlicked at the end of this function, and checked at the start)
-    vkWaitForFences(_main_device.logical_device, 1, &_draw_fences[_current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    {
+        PROFILE_ZONE("wait draw fence");
+        vkWaitForFences(_main_device.logical_device, 1, &_draw_fences[_current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
     //manually lock(reset) fence
     vkResetFences(_main_device.logical_device, 1, &_draw_fences[_current_frame]);
 
-    // 1. Get a next available image to draw 
+    //frame is finished on GPU, its timestamps and pixels are ready
+    //new GPU time moves the render scale of the next frames
+    if(read_gpu_timestamps(_current_frame) && _dynamic_resolution.is_enabled())
+        _dynamic_resolution.update(_gpu_frame_time_ms);
+    read_overdraw(_current_frame);
+    if(_readback.is_created())
+        _readback.deliver(_current_frame);
+
+    //transient descriptor sets and uniform space of this frame are free again
+    _descriptor_allocator.reset_frame(_current_frame);
+    _uniform_ring.begin_frame(_current_frame);
+    //slots freed MAX_FRAME_DRAWS frames ago aren`t read by the GPU anymore
+    if(_bindless.is_created())
+        _bindless.begin_frame(_frame_number);
+
+    //long running nodes shouldn`t lose pipelines compiled since start if they get killed
+    _pipeline_cache.save_periodically();
+
+    // 1. Get a next available image to draw
     // to and set something to signal whem we finished with the image
     //index of the next image to draw to
     uint32_t image_index;
-    vkAcquireNextImageKHR(_main_device.logical_device, _swapchain, std::numeric_limits<uint64_t>::max(),
-                          _image_available[_current_frame], VK_NULL_HANDLE, &image_index);
+    if(_headless)
+    {
+        //offscreen images are ours, just take the next one
+        //(it was used MAX_FRAME_DRAWS+ frames ago, so its fence has been waited already)
+        image_index = _next_offscreen_image;
+        _next_offscreen_image = (_next_offscreen_image + 1) % static_cast<uint32_t>(_swapchain_images.size());
+    }
+    else
+    {
+        PROFILE_ZONE("vkAcquireNextImageKHR");
+        vkAcquireNextImageKHR(_main_device.logical_device, _swapchain, std::numeric_limits<uint64_t>::max(),
+                              _image_available[_current_frame], VK_NULL_HANDLE, &image_index);
+    }
 
     record_commands(image_index);
     update_uniform_buffers(image_index);
@@ -122,9 +176,10 @@ void VulkanRenderer::draw()
     // 2. Submit command buffer to queue for execution,
     // make sure it waits for image to be signaled as available,
     // also signal when it`s draw
+    //upscaled frame renders into its own target, the image is first touched by the blit
     VkPipelineStageFlags wait_stages[]
     {
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        _frame_upscaled ? VkPipelineStageFlags(VK_PIPELINE_STAGE_TRANSFER_BIT) : VkPipelineStageFlags(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT)
     };
     VkSubmitInfo submit_info
     {
@@ -141,14 +196,28 @@ void VulkanRenderer::draw()
         .signalSemaphoreCount = 1,
         .pSignalSemaphores = &_render_finished[_current_frame] // after signaled -- we are ready to present
     };
+    if(_headless)
+    {
+        //nothing to wait for and nobody to present
+        submit_info.waitSemaphoreCount = 0;
+        submit_info.signalSemaphoreCount = 0;
+    }
 
     //hey GPU execute all this commands for me
     //after submited and finished drawing, signal the fence
+    _frame_submit_cpu_ns[_current_frame] = profiler::now_ns();
     VkResult res = vkQueueSubmit(_graphics_queue, 1, &submit_info, _draw_fences[_current_frame]);
     if(res != VK_SUCCESS)
     {
         std::cerr << "VkResult == " << res << std::endl;
         throw std::runtime_error("Failed submit command buffer to the queue!");
+    }
+
+    if(_headless)
+    {
+        _current_frame = (_current_frame + 1) % MAX_FRAME_DRAWS;
+        _frame_number++;
+        return;
     }
 
     // 3. Present image to screen whem it has signalled finished rendering
@@ -174,6 +243,202 @@ void VulkanRenderer::draw()
 
     //increment frame
     _current_frame = (_current_frame + 1) % MAX_FRAME_DRAWS;
+    _frame_number++;
+}
+
+uint32_t VulkanRenderer::add_mesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+    const uint64_t uploaded_before = _geometry.get_stats().uploaded_bytes;
+    Mesh mesh = Mesh(_main_device.physical_device, _main_device.logical_device, _geometry, vertices, indices);
+    _meshes.push_back(mesh);
+    //new scene content, Auto depth prepass measures again
+    _frames_to_overdraw_measure = 0;
+
+    //shared streams weren`t uploaded
+    _stats.uploaded_bytes += _geometry.get_stats().uploaded_bytes - uploaded_before;
+    return static_cast<uint32_t>(_meshes.size() - 1);
+}
+
+std::vector<uint32_t> VulkanRenderer::load_mesh_file(const std::string &path)
+{
+    PROFILE_ZONE("load_mesh_file");
+    const auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(path);
+    MeshFileView view;
+    std::string error;
+    if(!parse_mesh_file(file.data(), file.size(), view, error))
+        throw std::runtime_error("Failed to load the mesh file " + path + ": " + error);
+    if(view.vertex_stride != sizeof(Vertex))
+        throw std::runtime_error("Failed to load the mesh file " + path + ": it was built for another vertex layout");
+    if(view.meshes.empty())
+        return {};
+
+    //blobs are already in GPU layout: mapped pages -> staging -> device, nothing is looked at on the way
+    //(compressed ones are decoded by all cores straight into staging)
+    const VkDeviceSize vertex_bytes = view.vertex_count * view.vertex_stride;
+    const VkDeviceSize index_bytes = view.index_count * sizeof(uint32_t);
+    GeometryBuffers geometry{};
+    create_buffer(_main_device.physical_device, _main_device.logical_device, std::max<VkDeviceSize>(vertex_bytes, 1),
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  &geometry.vertex_buffer, &geometry.vertex_buffer_memory);
+    create_buffer(_main_device.physical_device, _main_device.logical_device, std::max<VkDeviceSize>(index_bytes, 1),
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  &geometry.index_buffer, &geometry.index_buffer_memory);
+    _geometry_buffers.push_back(geometry);
+    if(view.compressed)
+    {
+        auto decode_to = [](std::span<const uint8_t> stream)
+        {
+            return [stream](uint8_t *staging, VkDeviceSize offset, VkDeviceSize size) { decode_stream(stream, staging, offset, size); };
+        };
+        upload_to_buffer(_main_device.physical_device, _main_device.logical_device, _graphics_queue, _graphics_command_pool,
+                         decode_to(view.vertex_stream), vertex_bytes, geometry.vertex_buffer);
+        upload_to_buffer(_main_device.physical_device, _main_device.logical_device, _graphics_queue, _graphics_command_pool,
+                         decode_to(view.index_stream), index_bytes, geometry.index_buffer);
+    }
+    else
+    {
+        upload_to_buffer(_main_device.physical_device, _main_device.logical_device, _graphics_queue, _graphics_command_pool,
+                         view.vertices.data(), vertex_bytes, geometry.vertex_buffer);
+        upload_to_buffer(_main_device.physical_device, _main_device.logical_device, _graphics_queue, _graphics_command_pool,
+                         view.indices.data(), index_bytes, geometry.index_buffer);
+    }
+
+    std::vector<uint32_t> model_ids;
+    model_ids.reserve(view.meshes.size());
+    for(const mesh_file::MeshRecord &record : view.meshes)
+    {
+        const mesh_file::LodRecord &lod = view.lods[record.first_lod];
+        _meshes.push_back(Mesh(_main_device.physical_device, _main_device.logical_device,
+                               geometry.vertex_buffer, static_cast<int32_t>(record.vertex_offset), record.vertex_count,
+                               geometry.index_buffer, lod.first_index, lod.index_count));
+        model_ids.push_back(static_cast<uint32_t>(_meshes.size() - 1));
+    }
+    _frames_to_overdraw_measure = 0;
+    _stats.uploaded_bytes += vertex_bytes + index_bytes;
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const double mib = double(vertex_bytes + index_bytes) / (1 << 20);
+    std::cout << "Mesh file " << path << ": " << view.meshes.size() << " meshes, " << mib << " MiB";
+    if(view.compressed)
+        std::cout << " (" << double(view.vertex_stream.size() + view.index_stream.size()) / (1 << 20) << " MiB compressed)";
+    std::cout << " in " << ms << " ms (" << (ms > 0.0 ? mib * 1000.0 / ms : 0.0) << " MiB/s)\n";
+    return model_ids;
+}
+
+std::vector<uint32_t> VulkanRenderer::import_asset(const std::string &path)
+{
+    std::vector<uint32_t> model_ids;
+    const ImportStats stats = import_meshes(path, [&](ImportedMesh &mesh)
+    {
+        model_ids.push_back(add_mesh(mesh.vertices, mesh.indices));
+    });
+
+    const double seconds = std::max(stats.ms, 0.001) / 1000.0;
+    std::cout << "Imported " << path << ": " << stats.meshes << " meshes, " << stats.triangles << " triangles, "
+              << stats.duplicate_vertices << " duplicate vertices merged in " << stats.ms << " ms ("
+              << stats.bytes / 1e6 / seconds << " MB/s, " << stats.triangles / 1e6 / seconds << " M triangles/s)\n";
+    return model_ids;
+}
+
+std::vector<uint32_t> VulkanRenderer::stream_mesh_file(const std::string &path)
+{
+    const uint32_t mesh_count = _streamer.open(path);
+    std::vector<uint32_t> model_ids;
+    model_ids.reserve(mesh_count);
+    for(uint32_t i = 0; i < mesh_count; ++i)
+    {
+        //no geometry (0 indices, not drawn) until the streamer points it at its first LOD
+        _meshes.push_back(Mesh(_main_device.physical_device, _main_device.logical_device,
+                               VK_NULL_HANDLE, 0, 0, VK_NULL_HANDLE, 0, 0));
+        model_ids.push_back(static_cast<uint32_t>(_meshes.size() - 1));
+        _streamer.add(path, i, model_ids.back());
+    }
+    _frames_to_overdraw_measure = 0;
+    std::cout << "Streaming mesh file " << path << ": " << mesh_count << " meshes, "
+              << _streamer.get_budget() / 1024 << " KiB per frame\n";
+    return model_ids;
+}
+
+uint32_t VulkanRenderer::add_mesh_instance(uint32_t model_id)
+{
+    if(model_id >= _meshes.size())
+        throw std::runtime_error("No mesh to instance!");
+
+    _meshes.push_back(_meshes[model_id].make_instance());
+    const uint32_t instance_id = static_cast<uint32_t>(_meshes.size() - 1);
+    //streamed geometry isn`t there yet or changes with the LOD, the streamer updates the instance too
+    _streamer.add_instance(model_id, instance_id);
+    _frames_to_overdraw_measure = 0;
+    return instance_id;
+}
+
+DrawHandles VulkanRenderer::add_material(glm::vec4 tint)
+{
+    if(!_bindless.is_created())
+        throw std::runtime_error("Materials need the bindless heap (descriptor indexing)!");
+    if(_material_count == MAX_MATERIALS)
+        throw std::runtime_error("Too many materials!");
+
+    //new slot, no frame in flight reads it yet, so it can be written right away
+    _material_data[_material_count] = tint;
+    return DrawHandles{.material_buffer = _material_buffer_handle, .material = _material_count++};
+}
+
+PipelineDesc VulkanRenderer::get_default_pipeline_desc() const
+{
+    PipelineDesc desc;
+    desc.vertex_attributes = PipelineDesc::default_vertex_attributes();
+    desc.render_pass = _render_pass;
+    desc.subpass = 0;
+    //used instead of the render pass by dynamic rendering
+    desc.color_format = _swapchain_image_format;
+    desc.depth_format = _depth_buffer_format;
+    return desc;
+}
+
+bool VulkanRenderer::enable_readback(FrameReadback::Callback callback)
+{
+    if(!_color_transfer_src_supported)
+    {
+        std::cerr << "Readback is not supported: colour images can`t be a transfer source\n";
+        return false;
+    }
+
+    //one buffer for each frame in flight, it`s reused after the frame fence is waited
+    _readback.create(_main_device.physical_device, _main_device.logical_device,
+                     _swapchain_extent, _swapchain_image_format, MAX_FRAME_DRAWS, std::move(callback));
+    return true;
+}
+
+bool VulkanRenderer::set_dynamic_resolution(double target_gpu_ms, float min_scale, float max_scale)
+{
+    if(target_gpu_ms > 0.0)
+    {
+        //controller is fed with GPU timestamps
+        if(_timestamp_query_pool == VK_NULL_HANDLE)
+        {
+            std::cerr << "Dynamic resolution is not supported: no GPU timestamps\n";
+            return false;
+        }
+
+        VkFormatProperties format_props;
+        vkGetPhysicalDeviceFormatProperties(_main_device.physical_device, _swapchain_image_format, &format_props);
+        const VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                   VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if(!_color_transfer_dst_supported || (format_props.optimalTilingFeatures & blit_features) != blit_features)
+        {
+            std::cerr << "Dynamic resolution is not supported: colour images can`t be a linear blit destination\n";
+            return false;
+        }
+
+        if(_scene_targets[0].image == VK_NULL_HANDLE)
+            create_scene_targets();
+    }
+
+    _dynamic_resolution.configure(target_gpu_ms, min_scale, max_scale);
+    return true;
 }
 
 void VulkanRenderer::cleanup()
@@ -181,27 +446,66 @@ void VulkanRenderer::cleanup()
     //wait until device is not doing anything
     //(nothing left on the queue)
     vkDeviceWaitIdle(_main_device.logical_device);
-    
+
+    if(_timestamp_query_pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(_main_device.logical_device, _timestamp_query_pool, nullptr);
+    if(_overdraw_query_pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(_main_device.logical_device, _overdraw_query_pool, nullptr);
+
+    //last frames are finished, give them out before buffers are gone
+    if(_readback.is_created())
+    {
+        _readback.flush();
+        _readback.destroy();
+    }
+
+    //after rendering: what the driver really had to back (the rest is saved)
+    if(!_lazy_attachment_memory.empty())
+    {
+        const uint64_t committed = get_lazy_attachment_committed_bytes();
+        std::cout << "Transient attachments: " << committed / 1024 << " of " << _stats.lazy_attachment_bytes / 1024
+                  << " KiB committed, " << (_stats.lazy_attachment_bytes - std::min(committed, _stats.lazy_attachment_bytes)) / 1024
+                  << " KiB saved\n";
+        _lazy_attachment_memory.clear();
+    }
     vkDestroyImageView(_main_device.logical_device, _depth_buffer_image_view, nullptr);
     vkDestroyImage(_main_device.logical_device, _depth_buffer_image, nullptr);
     vkFreeMemory(_main_device.logical_device, _depth_buffer_memory, nullptr);
 
-    //dynamic buffer stuff -- redundant
-    //_aligned_free(_model_transfer_space);
-
-    vkDestroyDescriptorPool(_main_device.logical_device, _descriptor_pool, nullptr);
+    _uniform_ring.destroy();
+    _light_clusters.destroy();
+    //geometry of streamed meshes belongs to it (the meshes don`t own buffers)
+    _streamer.destroy();
+    _descriptor_allocator.destroy();
+    _textures.destroy();
+    _bindless.destroy();
+    if(_material_buffer != VK_NULL_HANDLE)
+    {
+        vkUnmapMemory(_main_device.logical_device, _material_buffer_memory);
+        vkDestroyBuffer(_main_device.logical_device, _material_buffer, nullptr);
+        vkFreeMemory(_main_device.logical_device, _material_buffer_memory, nullptr);
+    }
     vkDestroyDescriptorSetLayout(_main_device.logical_device, _descriptor_set_layout, nullptr);
     for(size_t i = 0; i < _vp_uniform_buffer.size(); ++i)
     {
         vkDestroyBuffer(_main_device.logical_device, _vp_uniform_buffer[i], nullptr);
         vkFreeMemory(_main_device.logical_device, _vp_uniform_buffer_memory[i], nullptr);
-        //dynamic buffer stuff -- redundant
-        //vkDestroyBuffer(_main_device.logical_device, _model_uniform_buffer[i], nullptr);
-        //vkFreeMemory(_main_device.logical_device, _model_uniform_buffer_memory[i], nullptr);
     }
 
     for(auto mesh : _meshes)
         mesh.destroy_buffers();
+    const GeometryRegistry::Stats &geometry_stats = _geometry.get_stats();
+    if(geometry_stats.deduplicated_bytes > 0)
+        std::cout << "Geometry: " << geometry_stats.shared << " of " << geometry_stats.requests << " streams shared, "
+                  << geometry_stats.deduplicated_bytes / 1024 << " KiB not uploaded\n";
+    _geometry.destroy();
+    for(const GeometryBuffers &geometry : _geometry_buffers)
+    {
+        vkDestroyBuffer(_main_device.logical_device, geometry.vertex_buffer, nullptr);
+        vkFreeMemory(_main_device.logical_device, geometry.vertex_buffer_memory, nullptr);
+        vkDestroyBuffer(_main_device.logical_device, geometry.index_buffer, nullptr);
+        vkFreeMemory(_main_device.logical_device, geometry.index_buffer_memory, nullptr);
+    }
     for(auto fence : _draw_fences)
         vkDestroyFence(_main_device.logical_device, fence, nullptr);
     for(auto semaphore : _image_available)
@@ -213,16 +517,36 @@ void VulkanRenderer::cleanup()
     for(auto &framebuffer : _swapchain_framebuffers)
         vkDestroyFramebuffer(_main_device.logical_device, framebuffer, nullptr);
 
-    vkDestroyPipeline(_main_device.logical_device, _graphics_pipline, nullptr);
+    for(const PipelineLibrary::VariantStats &variant : _pipelines.get_variant_stats())
+        std::cout << "Pipeline variant " << (variant.name.empty() ? "<unnamed>" : variant.name) << ": "
+                  << (variant.ready ? std::to_string(variant.compile_ms) + " ms" : std::string("not compiled")) << "\n";
+    std::cout << _pipelines.get_variant_stats().size() << " pipeline variants use "
+              << _pipelines.get_pipeline_count() << " pipelines\n";
+    _pipelines.destroy();
+    //written to disk for the next start (with the variants compiled since)
+    _pipeline_cache.destroy();
     vkDestroyPipelineLayout(_main_device.logical_device, _pipline_layout, nullptr);
     vkDestroyRenderPass(_main_device.logical_device, _render_pass, nullptr);
+    destroy_scene_targets();
 
     //images are destroyed by the swapchain, but image views clean up is up to us
     for(auto &image : _swapchain_images)
         vkDestroyImageView(_main_device.logical_device, image.image_view, nullptr);
-    //Everytime we do a create we need to do a destroy
-    vkDestroySwapchainKHR(_main_device.logical_device, _swapchain, nullptr);
-    vkDestroySurfaceKHR(_instance, _surface, nullptr);
+    if(_headless)
+    {
+        //offscreen images are created by us
+        for(size_t i = 0; i < _swapchain_images.size(); ++i)
+        {
+            vkDestroyImage(_main_device.logical_device, _swapchain_images[i].image, nullptr);
+            vkFreeMemory(_main_device.logical_device, _offscreen_images_memory[i], nullptr);
+        }
+    }
+    else
+    {
+        //Everytime we do a create we need to do a destroy
+        vkDestroySwapchainKHR(_main_device.logical_device, _swapchain, nullptr);
+        vkDestroySurfaceKHR(_instance, _surface, nullptr);
+    }
     vkDestroyDevice(_main_device.logical_device, nullptr);
     vkDestroyInstance(_instance, nullptr);
 }
@@ -253,6 +577,10 @@ void VulkanRenderer::get_physical_device()
         if(check_device_suitable(dev))
         {
             _main_device.physical_device = dev;
+
+            VkPhysicalDeviceProperties device_props;
+            vkGetPhysicalDeviceProperties(dev, &device_props);
+            _stats.device_name = device_props.deviceName;
             //after device is chosen, lets save queue family index
             _main_device.queue_indicies =  get_queue_families_for_device(dev, _surface);
             break;
@@ -267,11 +595,21 @@ bool VulkanRenderer::check_device_suitable(const VkPhysicalDevice &device)
     vkGetPhysicalDeviceFeatures(device, &device_features);
     */
     const bool queues_are_valid = get_queue_families_for_device(device, _surface).is_valid();
-    const bool extensions_supported = check_device_extension_support(device, _needed_device_extentions);
-    const bool swapchain_supported = get_swapchain_details_for_device(device, _surface).is_valid();
+    const bool extensions_supported = check_device_extension_support(device, get_needed_device_extensions());
+    //headless mode has nothing to present to
+    const bool swapchain_supported = _headless || get_swapchain_details_for_device(device, _surface).is_valid();
     return queues_are_valid && extensions_supported && swapchain_supported;
 }
 
+std::vector<const char*> VulkanRenderer::get_needed_device_extensions()
+{
+    //no swapchain in headless mode
+    if(_headless)
+        return {};
+
+    return _needed_device_extentions;
+}
+
 bool VulkanRenderer::check_instance_extensions_support(const std::vector<const char*> &extensions_to_check)
 {
     //get number of extensions
@@ -341,15 +679,99 @@ void VulkanRenderer::create_logical_device()
     }
 
     VkPhysicalDeviceFeatures pd_features{};
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(_main_device.physical_device, &supported_features);
+    //fragment shader invocations for the overdraw measurement (depth prepass Auto mode)
+    pd_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+    _optional_features.pipeline_statistics = supported_features.pipelineStatisticsQuery == VK_TRUE;
+    pd_features.samplerAnisotropy = supported_features.samplerAnisotropy;
+    _optional_features.sampler_anisotropy = supported_features.samplerAnisotropy == VK_TRUE;
+    std::vector<const char*> device_extensions = get_needed_device_extensions();
+
+    //OPTIONAL FEATURES
+    //extension has to be there before its feature struct can be queried
+    //enabled features are chained into device create info
+    void *feature_chain = nullptr;
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state_features
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT
+    };
+    if(check_device_extension_support(_main_device.physical_device, {VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME}))
+    {
+        VkPhysicalDeviceFeatures2 features2
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &extended_dynamic_state_features
+        };
+        vkGetPhysicalDeviceFeatures2(_main_device.physical_device, &features2);
+        _optional_features.extended_dynamic_state = extended_dynamic_state_features.extendedDynamicState == VK_TRUE;
+    }
+    if(_optional_features.extended_dynamic_state)
+    {
+        device_extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        extended_dynamic_state_features.pNext = feature_chain;
+        feature_chain = &extended_dynamic_state_features;
+    }
+    //descriptor indexing is core since 1.2, older devices need the extension
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(_main_device.physical_device, &device_properties);
+    const bool descriptor_indexing_core = device_properties.apiVersion >= VK_API_VERSION_1_2;
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES
+    };
+    if(descriptor_indexing_core
+       || check_device_extension_support(_main_device.physical_device, {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME}))
+    {
+        VkPhysicalDeviceFeatures2 features2
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &descriptor_indexing_features
+        };
+        vkGetPhysicalDeviceFeatures2(_main_device.physical_device, &features2);
+        _optional_features.descriptor_indexing = BindlessHeap::is_supported(descriptor_indexing_features);
+    }
+    if(_optional_features.descriptor_indexing)
+    {
+        if(!descriptor_indexing_core)
+            device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        BindlessHeap::enable_features(descriptor_indexing_features);
+        descriptor_indexing_features.pNext = feature_chain;
+        feature_chain = &descriptor_indexing_features;
+    }
+#ifdef VK_KHR_dynamic_rendering
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR
+    };
+    if(check_device_extension_support(_main_device.physical_device, {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME}))
+    {
+        VkPhysicalDeviceFeatures2 features2
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &dynamic_rendering_features
+        };
+        vkGetPhysicalDeviceFeatures2(_main_device.physical_device, &features2);
+        _optional_features.dynamic_rendering = dynamic_rendering_features.dynamicRendering == VK_TRUE;
+    }
+    if(_optional_features.dynamic_rendering)
+    {
+        //depends on VK_KHR_depth_stencil_resolve, which is core in 1.2
+        device_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        dynamic_rendering_features.pNext = feature_chain;
+        feature_chain = &dynamic_rendering_features;
+    }
+#endif
 
     //Device === Logical Device
     VkDeviceCreateInfo device_create_info
     {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = feature_chain,
         .queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size()),
         .pQueueCreateInfos = queue_create_infos.data(),
-        .enabledExtensionCount = static_cast<uint32_t>(_needed_device_extentions.size()),
-        .ppEnabledExtensionNames = _needed_device_extentions.data(),
+        .enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
+        .ppEnabledExtensionNames = device_extensions.data(),
         //.enabledLayerCount depricated, handled by instance
         .pEnabledFeatures = &pd_features
     };
@@ -360,6 +782,35 @@ void VulkanRenderer::create_logical_device()
         std::cerr << "VkResult == " << result << std::endl;
         throw std::runtime_error("Failed to create a Vulkan Logical Device");
     }
+
+    if(_optional_features.extended_dynamic_state)
+    {
+        VkDevice device = _main_device.logical_device;
+        _vkCmdSetCullModeEXT = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT"));
+        _vkCmdSetFrontFaceEXT = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT"));
+        _vkCmdSetDepthTestEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT"));
+        _vkCmdSetDepthWriteEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT"));
+        _vkCmdSetDepthCompareOpEXT = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT"));
+    }
+#ifdef VK_KHR_dynamic_rendering
+    if(_optional_features.dynamic_rendering)
+    {
+        VkDevice device = _main_device.logical_device;
+        _vkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+        _vkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+    }
+#endif
+    std::cout << "Extended dynamic state: " << (_optional_features.extended_dynamic_state ? "yes" : "no") << "\n";
+    std::cout << "Dynamic rendering: " << (_optional_features.dynamic_rendering ? "yes" : "no") << "\n";
+    std::cout << "Descriptor indexing: " << (_optional_features.descriptor_indexing ? "yes" : "no") << "\n";
+
+    //tilers keep transient attachments in tile memory, lazily allocated memory is committed only if they spill
+    _optional_features.lazily_allocated_memory =
+        is_memory_type_supported(_main_device.physical_device,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    std::cout << "Lazily allocated memory: " << (_optional_features.lazily_allocated_memory ? "yes" : "no") << "\n";
+    std::cout << "Pipeline statistics: " << (_optional_features.pipeline_statistics ? "yes" : "no") << "\n";
+    std::cout << "Sampler anisotropy: " << (_optional_features.sampler_anisotropy ? "yes" : "no") << "\n";
 }
 
 void VulkanRenderer::create_instance()
@@ -382,8 +833,9 @@ void VulkanRenderer::create_instance()
 
 
     //get all extensions
+    //(headless mode doesn`t need any window system extensions, GLFW is not even initialized)
     uint32_t glfw_extension_count = 0;
-    const char **glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+    const char **glfw_extensions = _headless ? nullptr : glfwGetRequiredInstanceExtensions(&glfw_extension_count);
     //create a list to hold the extensions 
     std::vector<const char*> instance_extensions(glfw_extension_count);
     for(size_t i = glfw_extension_count;  i--; )
@@ -450,6 +902,18 @@ void VulkanRenderer::create_swapchain()
     if(creation_details.surface_capabilities.maxImageCount > 0)
         minImageCount = std::min(minImageCount, creation_details.surface_capabilities.maxImageCount);
     
+    //let images be copied from (frame readback) if surface allows it
+    VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    _color_transfer_src_supported =
+        (creation_details.surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if(_color_transfer_src_supported)
+        image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    //blit destination of dynamic resolution
+    _color_transfer_dst_supported =
+        (creation_details.surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+    if(_color_transfer_dst_supported)
+        image_usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
     QueueFamilyIndices indices = get_queue_families_for_device(_main_device.physical_device, _surface);
     //if graphics and presentation queues are different,
     //then swapchain must let images to be shared between families
@@ -484,7 +948,7 @@ void VulkanRenderer::create_swapchain()
         // 1 layer so far for each image
         .imageArrayLayers = 1,
         //will attachemnt images will be used as??
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = image_usage,
         
         .imageSharingMode = sharing_mode,
         .queueFamilyIndexCount = count_of_family_queues,
@@ -532,7 +996,46 @@ void VulkanRenderer::create_swapchain()
 
 }
 
-void VulkanRenderer::create_render_pass()
+void VulkanRenderer::create_offscreen_images()
+{
+    //same formats a swapchain would usually give us
+    _swapchain_image_format = chooseSupportedFormat(_main_device.physical_device,
+                                                    {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM},
+                                                    VK_IMAGE_TILING_OPTIMAL,
+                                                    VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT);
+    //nobody presents the image, leave it ready to be copied out
+    _color_final_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    _color_transfer_src_supported = true;
+    _color_transfer_dst_supported = true;
+
+    //one more image than frames in flight, like triple buffered swapchain
+    const uint32_t image_count = MAX_FRAME_DRAWS + 1;
+    std::cout << bold_on << "Offscreen image count: " << bold_off << image_count
+              << " (" << _swapchain_extent.width << "x" << _swapchain_extent.height << ")" << std::endl;
+
+    _swapchain_images.reserve(image_count);
+    _offscreen_images_memory.resize(image_count);
+    for(uint32_t i = 0; i < image_count; ++i)
+    {
+        VkImage image;
+        create_image(_main_device.physical_device, _main_device.logical_device,
+                     _swapchain_extent.width, _swapchain_extent.height,
+                     _swapchain_image_format, VK_IMAGE_TILING_OPTIMAL,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     _offscreen_images_memory[i], image);
+
+        SwapchainImage offscreen_image =
+        {
+            .image = image,
+            .image_view =
+                create_image_view(_main_device.logical_device, image, _swapchain_image_format, VK_IMAGE_ASPECT_COLOR_BIT)
+        };
+        _swapchain_images.push_back(offscreen_image);
+    }
+}
+
+VkRenderPass VulkanRenderer::create_render_pass(VkImageLayout color_final_layout)
 {
     //ATTACHMENTS
     //Describe places to output data to and input data from
@@ -555,7 +1058,7 @@ void VulkanRenderer::create_render_pass()
         //to give optimal  use for certain operation
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, //data layout before render pass starts, that we excpect to have already
         //initialLayout --> subpassFormat (process as ATTACHMENT_OPTIMAL) --> finalLayout
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR //after render pass (to convert to)
+        .finalLayout = color_final_layout //after render pass (to convert to), PRESENT_SRC for the swapchain
     };
     VkAttachmentDescription depth_attachment
     {
@@ -563,6 +1066,7 @@ void VulkanRenderer::create_render_pass()
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
         //VK_ATTACHMENT_STORE_OP_DONT_CARE we don`t need this data out of render pass process
+        //(never written back to memory, so the image can be a lazily allocated transient attachment)
         .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
@@ -620,16 +1124,19 @@ void VulkanRenderer::create_render_pass()
             .dependencyFlags = 0
         },
         //Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR(presentation)
+        //(or to TRANSFER_SRC: copies and blits that follow wait for it)
         VkSubpassDependency
         {
             .srcSubpass = 0,
             .dstSubpass = VK_SUBPASS_EXTERNAL, 
             
             .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            .dstStageMask = color_final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ?
+                VkPipelineStageFlags(VK_PIPELINE_STAGE_TRANSFER_BIT) : VkPipelineStageFlags(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
             
             .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, //we read from src
-            .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+            .dstAccessMask = color_final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ?
+                VkAccessFlags(VK_ACCESS_TRANSFER_READ_BIT) : VkAccessFlags(VK_ACCESS_MEMORY_READ_BIT),
             
             .dependencyFlags = 0
         }
@@ -646,11 +1153,13 @@ void VulkanRenderer::create_render_pass()
         .pDependencies = subpass_dependencies.data()
     };
 
-    VkResult res = vkCreateRenderPass(_main_device.logical_device, &render_pass_createinfo, nullptr, &_render_pass);
+    VkRenderPass render_pass;
+    VkResult res = vkCreateRenderPass(_main_device.logical_device, &render_pass_createinfo, nullptr, &render_pass);
     if(res != VK_SUCCESS)
     { 
         throw std::runtime_error("Failled to create render pass!");
     }
+    return render_pass;
 }
 
 void VulkanRenderer::create_descriptor_set_layout()
@@ -665,22 +1174,40 @@ void VulkanRenderer::create_descriptor_set_layout()
         .pImmutableSamplers = nullptr //for textures
     };
     
-    //dynamic buffer stuff -- redundant
-    ////bind model data to our shader
-    //const VkDescriptorSetLayoutBinding model_layout_binding
-    //{
-    //    .binding = 1, //binding point from shader
-    //    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-    //    .descriptorCount = 1,
-    //    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, //vertex or fragment
-    //    .pImmutableSamplers = nullptr //for textures
-    //};
-
-    std::array<VkDescriptorSetLayoutBinding, 1> layouts
+    //bind model data to our shader, offset into the uniform ring is given per draw
+    const VkDescriptorSetLayoutBinding model_layout_binding
+    {
+        .binding = 1, //binding point from shader
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, //vertex or fragment
+        .pImmutableSamplers = nullptr //for textures
+    };
+
+    //light data and cluster lists (LightClusters) for the fragment shader
+    const VkDescriptorSetLayoutBinding light_layout_binding
+    {
+        .binding = 2,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = nullptr
+    };
+    const VkDescriptorSetLayoutBinding cluster_layout_binding
+    {
+        .binding = 3,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = nullptr
+    };
+
+    std::array<VkDescriptorSetLayoutBinding, 4> layouts
     {
         vp_layout_binding,
-        //dynamic buffer stuff -- redundant
-        //model_layout_binding
+        model_layout_binding,
+        light_layout_binding,
+        cluster_layout_binding
     };
 
     VkDescriptorSetLayoutCreateInfo create_info
@@ -699,296 +1226,58 @@ void VulkanRenderer::create_descriptor_set_layout()
 
 void VulkanRenderer::create_push_constant_range()
 {
-    _push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    //bindless handles for the fragment shader (model comes from the uniform ring)
+    _push_constant_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     _push_constant_range.offset = 0;
-    //size of data being passed
-    _push_constant_range.size = sizeof(Model);
+    //size of data being passed (16 bytes, 128 are guaranteed)
+    _push_constant_range.size = sizeof(PushConstants);
 }
 
 void VulkanRenderer::create_graphics_pipeline()
 {
-    auto vertex_shader_code = read_f("shaders/vert.spv");
-    auto fragment_shader_code = read_f("shaders/frag.spv");
-
-    //Build shader modules to link to the Graphics pipeline
-    VkShaderModule vertex_shader_module = create_shader_module(_main_device.logical_device, vertex_shader_code);
-    VkShaderModule fragment_shader_module = create_shader_module(_main_device.logical_device, fragment_shader_code);
-
-    // SHADER STAGE CREATION INFO
-    VkPipelineShaderStageCreateInfo vertex_shader_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = vertex_shader_module,
-        //function to run in GLSL
-        .pName = "main"
-    };
-
-    VkPipelineShaderStageCreateInfo fragment_shader_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = fragment_shader_module,
-        //function to run in GLSL
-        .pName = "main"
-    };
-
-    //Graphics Pipeline requires array of shader info
-    VkPipelineShaderStageCreateInfo shader_stages[] =
-    {
-        vertex_shader_createinfo,
-        fragment_shader_createinfo
-    };
-
-    //VERTEX INPUT
-    //How a data for any 1 vertex (pos, color, texture, normals...) is layout
-    VkVertexInputBindingDescription binding_description
-    {
-        //can bind multiple streams of data, define which one
-        //which IN parameter in the vertex shader 
-        .binding = 0,
-        //size of the individual vertex
-        .stride = sizeof(Vertex),
-        //How to move the data after each vertex
-        //if we draw multiple instances:
-        // draw all 1st vertices and thend draw all 2nd...
-        // or draw all 1st object vertices, then 2nd...
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-    };
-
-    //How data within a vertex is defined
-    std::vector<VkVertexInputAttributeDescription> attribute_descriptions =
-    {
-        //Position description
-        VkVertexInputAttributeDescription
-        {
-            .location = 0,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT, //data format
-            .offset = offsetof(Vertex, position)
-        },
-        //ColorDescription
-        VkVertexInputAttributeDescription
-        {
-            .location = 1,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = offsetof(Vertex, color)
-        }
-    };
-
-    VkPipelineVertexInputStateCreateInfo vertex_input_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 1,
-        //list of vertex binding desc (data spacing, stride informantion)
-        .pVertexBindingDescriptions = &binding_description,
-        .vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size()),
-        //(data format and where to bind it)
-        .pVertexAttributeDescriptions = attribute_descriptions.data()
-    };
-
-    //INPUT ASSEMBLY
-    //(where we assembly input into primitives)
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        //type of primitive to assemble verticies as (triangles, lines) 
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-
-    //VIEWPORT AND SCISSOR
-    // viewport -- how the transforming image into screen
-    // from top-left to buttom (different for splitscreen for example)
-    VkViewport viewport
-    {
-        //start coordinates
-        .x = 0.f,
-        .y = 0.f,
-        .width = static_cast<float>(_swapchain_extent.width),
-        .height = static_cast<float>(_swapchain_extent.height),
-        // standard depth trange for Vulkan
-        .minDepth = 0.f,
-        .maxDepth = 1.f
-    };
-
-    //scissor - is basicly which part of the image we cut
-    VkRect2D scissor
-    {
-        .offset = {0, 0},
-        .extent = _swapchain_extent
-    };
-
-    VkPipelineViewportStateCreateInfo viewport_state_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .viewportCount = 1,
-        .pViewports = &viewport,
-        .scissorCount = 1,
-        .pScissors = &scissor
-    };
-
-    // DYNAMIC STATE - not used for now
-    // something is not backed but configurable at runtime
-    // we define what parts of pipeline is is dynamic(issued in command buffer)
-    std::vector<VkDynamicState> dynamic_states
-    {
-        //can be resized like this vkCmdSetViewport(commandbuffer, 0, 1, &viewport)
-        VK_DYNAMIC_STATE_VIEWPORT,
-        // can be also resized in command buffer with vkCmdSetScissor(commandbuffer, 0, 1, &scissor)
-        VK_DYNAMIC_STATE_SCISSOR
-    };
-
-    //Dynamic state creation info
-    VkPipelineDynamicStateCreateInfo dynamic_state_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
-        .pDynamicStates = dynamic_states.data()
-    };
-
-    //RASTERIZER - convert the primitives(triangles) into fragments
-    VkPipelineRasterizationStateCreateInfo rasterization_state_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        // when somehing is far away (far plane) do not render them
-        // flat everything when it is far: false, GPU feature
-        .depthClampEnable = VK_FALSE,
-        // if we want to discard data
-        // you compute stuff and do not draw
-        .rasterizerDiscardEnable = VK_FALSE,
-        // how we want to handle poligons
-        // other then fill -- you need GPU feature
-        .polygonMode = VK_POLYGON_MODE_FILL,
-        // do not draw the back of tri
-        .cullMode = VK_CULL_MODE_BACK_BIT,
-        //define what side is the face (if we draw the 3 point in the counter-clockwize)
-        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
-        //to fix "shadow acne"? add a little bit to depth for shadow calculation to fragmenths
-        .depthBiasEnable = VK_FALSE,
-        // how thick lines would be
-        .lineWidth = 1.f,
-
-    };
-
-    // MULTISAMPLING -- form of antialiasing
-    // not for textures, fix "stairs" of the sides of triangles
-    VkPipelineMultisampleStateCreateInfo multisampling_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        //num of samples to use per fragment
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-        //disable the whole feature for now
-        .sampleShadingEnable = VK_FALSE,
-    };
-
-    // BLENDING - of two fragments together
-    // (you draw an object and another object on top of it)
-    // how to blend new color of fragment with the existing one
-
-    // Blend attachment state -- how blending is handled
-    //Blending equasion: (srcColorBlendFactor * newCOLOR) colorBlendOp (dstColorBlendFactor * oldCOLOR)
-    //Our Case: (VK_BLEND_FACTOR_SRC_ALPHA * newCOLOR) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * oldCOLOR)
-    //Or: (newCOLOR-ALPHA * newCOLOR) + ((1-newCOLOR-ALPHA) * oldCOLOR)
-    //in short: use alpha of the new color!
-    VkPipelineColorBlendAttachmentState how_to_blend_colors
-    {
-        .blendEnable = VK_TRUE,
-        //how to blend colors
-        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-        //math op to do
-        .colorBlendOp = VK_BLEND_OP_ADD,
-        //how to blend alpha:
-        //take new alpha
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-        //get rid of the old alpha
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        //same equasion as color 
-        .alphaBlendOp = VK_BLEND_OP_ADD,
-        //what colors to be changed by blending
-        .colorWriteMask =
-            (VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT)
-    };
-    
-    VkPipelineColorBlendStateCreateInfo color_blending_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        //logic operation instead of calculation of blended color
-        .logicOpEnable = VK_FALSE,
-        //color blend attachment state to multiply colors together
-        .attachmentCount = 1,
-        .pAttachments = &how_to_blend_colors
-        
-    };
+    //set 0 -- per frame uniforms, set 1 -- bindless heap
+    std::vector<VkDescriptorSetLayout> set_layouts{_descriptor_set_layout};
+    if(_bindless.is_created())
+        set_layouts.push_back(_bindless.get_layout());
 
     //PIPLINE LAYOUT
     VkPipelineLayoutCreateInfo layout_createinfo
     {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 1,
-        .pSetLayouts = &_descriptor_set_layout,
+        .setLayoutCount = static_cast<uint32_t>(set_layouts.size()),
+        .pSetLayouts = set_layouts.data(),
         .pushConstantRangeCount = 1,
         .pPushConstantRanges = &_push_constant_range
     };
 
-    //set up depth stencil testing
-    VkPipelineDepthStencilStateCreateInfo depth_satencil_create_info
-    {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        //when false - by default depth is 1 (as far away as possible
-        //when true - test every pixel depth with existing pixel(fragment) before drawing it
-        .depthTestEnable = VK_TRUE,
-        //when we put a new pixel we update the depth buffer with relevant info
-        .depthWriteEnable = VK_TRUE,
-        //if new_value < old ==> overwrite fragment
-        .depthCompareOp = VK_COMPARE_OP_LESS,
-        //check if depth value in between two values
-        .depthBoundsTestEnable = VK_FALSE,
-        //we don`t want to enable a stencil test
-        .stencilTestEnable = VK_FALSE
-    };
-
     VkResult res = vkCreatePipelineLayout(_main_device.logical_device, &layout_createinfo, nullptr, &_pipline_layout);
     if(res != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to create a pipeline layout!");
     }
-    //PIPLINE
-    //Create pipline
-    VkGraphicsPipelineCreateInfo pipline_createinfo
-    {
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = 2,
-        .pStages = shader_stages,
-        .pVertexInputState = &vertex_input_createinfo,
-        .pInputAssemblyState = &input_assembly_createinfo,
-        .pViewportState = &viewport_state_createinfo,
-        .pRasterizationState = &rasterization_state_createinfo,
-        .pMultisampleState = &multisampling_createinfo,
-        .pDepthStencilState = &depth_satencil_create_info,
-        .pColorBlendState = &color_blending_createinfo,
-        .pDynamicState = nullptr,
-        .layout = _pipline_layout,
-        .renderPass = _render_pass, //render pass that will be used by the pipline
-        .subpass = 0,
-        .basePipelineHandle = VK_NULL_HANDLE, //if you want to base new pipline on the old one 
-        .basePipelineIndex = -1 // index of the base pipline if you create multiple piplines
-    };
-
-    //there is also a way to chache the pipline_createinfo,
-    res = vkCreateGraphicsPipelines(_main_device.logical_device, VK_NULL_HANDLE, 1, &pipline_createinfo, nullptr, &_graphics_pipline);
-    if(res != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create a graphics pipeline!");
-    }
-
-    //Clean up of the not needed shader modules after we create pipeline
-    vkDestroyShaderModule(_main_device.logical_device, fragment_shader_module, nullptr);
-    vkDestroyShaderModule(_main_device.logical_device, vertex_shader_module, nullptr);
 
+    //all variants share the layout, the cache and the render target size
+    //(shaders, vertex layout and fixed function state are in PipelineDesc)
+    const uint32_t compile_workers = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+    _pipelines.create(_main_device.logical_device, _pipline_layout, _pipeline_cache.get(),
+                      _optional_features.extended_dynamic_state, compile_workers);
+
+    //default pipeline is compiled right away: the first frame needs it,
+    //and it is drawn with until other variants are ready
+    PipelineDesc desc = get_default_pipeline_desc();
+    desc.name = "default";
+    _graphics_pipline = _pipelines.build(desc);
+    _pipelines.set_fallback(_graphics_pipline, desc);
+
+    //DEPTH PREPASS: position only, no fragment shader
+    //compiled in the background like a variant, frames are drawn without the prepass until it`s ready
+    PipelineDesc depth_desc = desc;
+    depth_desc.name = "depth prepass";
+    depth_desc.vertex_shader = "shaders/depth.spv";
+    depth_desc.fragment_shader.clear();
+    depth_desc.vertex_attributes = PipelineDesc::position_vertex_attributes();
+    depth_desc.blend = false;
+    _depth_prepass_key = _pipelines.add(depth_desc);
 }
 
 void VulkanRenderer::create_depth_buffer_image()
@@ -999,14 +1288,46 @@ void VulkanRenderer::create_depth_buffer_image()
                                                  VK_IMAGE_TILING_OPTIMAL,
                                                  VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
     
-    create_image(_main_device.physical_device, _main_device.logical_device,
-                 _swapchain_extent.width, _swapchain_extent.height,
-                 _depth_buffer_format, VK_IMAGE_TILING_OPTIMAL,
-                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 _depth_buffer_memory, _depth_buffer_image);
-
+    //cleared on load and never stored, so it can be transient
     //wea re going to interact with DEPTH aspect of this image
-    _depth_buffer_image_view = create_image_view(_main_device.logical_device, _depth_buffer_image, _depth_buffer_format, VK_IMAGE_ASPECT_DEPTH_BIT);
+    _depth_buffer_image_view = create_attachment_image(_depth_buffer_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                                                       VK_IMAGE_ASPECT_DEPTH_BIT, _depth_buffer_image, _depth_buffer_memory);
+}
+
+VkImageView VulkanRenderer::create_attachment_image(VkFormat format, VkImageUsageFlags use_flags, VkImageAspectFlags aspect_flags,
+                                                    VkImage &image, VkDeviceMemory &memory)
+{
+    //only valid if the attachment is loaded with CLEAR/DONT_CARE and stored with DONT_CARE
+    //(TRANSIENT allows attachment usages only, no sampling or copies)
+    VkMemoryPropertyFlags mem_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if(_optional_features.lazily_allocated_memory)
+    {
+        use_flags |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        mem_flags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    }
+
+    const VkDeviceSize size = create_image(_main_device.physical_device, _main_device.logical_device,
+                                           _swapchain_extent.width, _swapchain_extent.height,
+                                           format, VK_IMAGE_TILING_OPTIMAL, use_flags, mem_flags, memory, image);
+    if(_optional_features.lazily_allocated_memory)
+    {
+        _lazy_attachment_memory.push_back(memory);
+        _stats.lazy_attachment_bytes += size;
+    }
+
+    return create_image_view(_main_device.logical_device, image, format, aspect_flags);
+}
+
+uint64_t VulkanRenderer::get_lazy_attachment_committed_bytes() const
+{
+    uint64_t committed = 0;
+    for(VkDeviceMemory memory : _lazy_attachment_memory)
+    {
+        VkDeviceSize memory_committed = 0;
+        vkGetDeviceMemoryCommitment(_main_device.logical_device, memory, &memory_committed);
+        committed += memory_committed;
+    }
+    return committed;
 }
 
 void VulkanRenderer::create_framebuffers()
@@ -1042,6 +1363,66 @@ void VulkanRenderer::create_framebuffers()
     }
 }
 
+void VulkanRenderer::create_scene_targets()
+{
+    //render pass compatible with _render_pass (pipelines work with both), only the final layout differs
+    if(!_optional_features.dynamic_rendering)
+        _scene_render_pass = create_render_pass(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    //per frame in flight: a frame writes its target only after the fence of its previous blit
+    for(SceneTarget &target : _scene_targets)
+    {
+        create_image(_main_device.physical_device, _main_device.logical_device,
+                     _swapchain_extent.width, _swapchain_extent.height,
+                     _swapchain_image_format, VK_IMAGE_TILING_OPTIMAL,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     target.memory, target.image);
+        target.image_view = create_image_view(_main_device.logical_device, target.image, _swapchain_image_format,
+                                              VK_IMAGE_ASPECT_COLOR_BIT);
+        if(_scene_render_pass == VK_NULL_HANDLE)
+            continue;
+
+        //full size, render area picks the scaled part
+        std::array<VkImageView, 2> attachments = {target.image_view, _depth_buffer_image_view};
+        VkFramebufferCreateInfo fb_createinfo
+        {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = _scene_render_pass,
+            .attachmentCount = static_cast<uint32_t>(attachments.size()),
+            .pAttachments = attachments.data(),
+            .width = _swapchain_extent.width,
+            .height = _swapchain_extent.height,
+            .layers = 1
+        };
+
+        VkResult res = vkCreateFramebuffer(_main_device.logical_device, &fb_createinfo, nullptr, &target.framebuffer);
+        if(res != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create scene framebuffer");
+        }
+    }
+}
+
+void VulkanRenderer::destroy_scene_targets()
+{
+    for(SceneTarget &target : _scene_targets)
+    {
+        if(target.image == VK_NULL_HANDLE)
+            continue;
+
+        if(target.framebuffer != VK_NULL_HANDLE)
+            vkDestroyFramebuffer(_main_device.logical_device, target.framebuffer, nullptr);
+        vkDestroyImageView(_main_device.logical_device, target.image_view, nullptr);
+        vkDestroyImage(_main_device.logical_device, target.image, nullptr);
+        vkFreeMemory(_main_device.logical_device, target.memory, nullptr);
+        target = {};
+    }
+    if(_scene_render_pass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(_main_device.logical_device, _scene_render_pass, nullptr);
+    _scene_render_pass = VK_NULL_HANDLE;
+}
+
 void VulkanRenderer::create_command_pool()
 {
     //chunk of memory dedicated only for creation of command buffers
@@ -1064,7 +1445,7 @@ void VulkanRenderer::create_command_pool()
 
 void VulkanRenderer::create_command_buffers()
 {
-    _command_buffers.resize(_swapchain_framebuffers.size());
+    _command_buffers.resize(_swapchain_images.size());
 
     VkCommandBufferAllocateInfo cb_alloc_info
     {
@@ -1113,190 +1494,275 @@ void VulkanRenderer::create_synchronization()
         }
 }
 
-void VulkanRenderer::create_uniform_buffers()
+void VulkanRenderer::create_timestamp_queries()
 {
-    const VkDeviceSize vp_buffer_size = sizeof(UBOViewProjection);
-    ////dynamic buffer stuff -- redundant
-    //const VkDeviceSize  model_buffer_size = _model_transfer_space_size;
-
-    //One uniform buffer for each image
-    const size_t buffers_num = _swapchain_images.size();
+    VkPhysicalDeviceProperties device_props;
+    vkGetPhysicalDeviceProperties(_main_device.physical_device, &device_props);
+    _timestamp_period_ns = device_props.limits.timestampPeriod;
+
+    //not every queue can write timestamps, 0 valid bits == no support
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(_main_device.physical_device, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> qfp(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(_main_device.physical_device, &count, qfp.data());
+    const uint32_t valid_bits = qfp[_main_device.queue_indicies.graphics_family].timestampValidBits;
+    if(valid_bits == 0)
+    {
+        std::cout << bold_on << "GPU timestamps are not supported on the graphics queue" << bold_off << std::endl;
+        return;
+    }
+    _timestamp_valid_mask = valid_bits >= 64 ? ~uint64_t(0) : ((uint64_t(1) << valid_bits) - 1);
 
-    _vp_uniform_buffer.resize(buffers_num);
-    _vp_uniform_buffer_memory.resize(buffers_num);
-    
-    //dynamic buffer stuff -- redundant
-    //_model_uniform_buffer.resize(buffers_num);
-    //_model_uniform_buffer_memory.resize(buffers_num);
+    VkQueryPoolCreateInfo create_info
+    {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        //begin and end of each frame in flight
+        .queryCount = MAX_FRAME_DRAWS * 2
+    };
 
-    //Create ViewProjection uniform buffers and
-    //Create Model dynamic unified buffers
-    for(size_t i = 0; i < buffers_num; ++i)
+    VkResult res = vkCreateQueryPool(_main_device.logical_device, &create_info, nullptr, &_timestamp_query_pool);
+    if(res != VK_SUCCESS)
     {
-        create_buffer(_main_device.physical_device, _main_device.logical_device, vp_buffer_size,
-                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, //memory visible only to the GPU 
-                  &_vp_uniform_buffer[i], &_vp_uniform_buffer_memory[i]);
-       
-        //dynamic buffer stuff -- redundant
-        //create_buffer(_main_device.physical_device, _main_device.logical_device, model_buffer_size,
-        //              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        //              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, //memory visible only to the GPU 
-        //              &_model_uniform_buffer[i], &_model_uniform_buffer_memory[i]);
+        throw std::runtime_error("Failed to create a timestamp query pool!");
     }
 }
 
-void VulkanRenderer::create_descriptor_pool()
+void VulkanRenderer::create_overdraw_queries()
 {
-    //ViewProjection pool
-    VkDescriptorPoolSize vp_pool_size
+    if(!_optional_features.pipeline_statistics)
     {
-        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        //each set has 1 descriptor (mvp struct)
-        .descriptorCount = static_cast<uint32_t>(_vp_uniform_buffer.size())
-    };
-
-    //dynamic buffer stuff -- redundant
-    //Model pool
-    //VkDescriptorPoolSize model_pool_size
-    //{
-    //    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-    //    //each set has 1 descriptor (mvp struct)
-    //    .descriptorCount = static_cast<uint32_t>(_model_uniform_buffer.size())
-    //};
+        std::cout << "Overdraw can`t be measured, depth prepass Auto mode keeps it off\n";
+        return;
+    }
 
-    std::array<VkDescriptorPoolSize, 1> pool_sizes
+    VkQueryPoolCreateInfo create_info
     {
-        vp_pool_size,
-        //model_pool_size
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+        //one colour pass of each frame in flight
+        .queryCount = MAX_FRAME_DRAWS,
+        .pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
     };
 
-    VkDescriptorPoolCreateInfo create_info
+    VkResult res = vkCreateQueryPool(_main_device.logical_device, &create_info, nullptr, &_overdraw_query_pool);
+    if(res != VK_SUCCESS)
     {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = static_cast<uint32_t>(_swapchain_images.size()),
-        .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
-        .pPoolSizes = pool_sizes.data(),
-    };
+        throw std::runtime_error("Failed to create an overdraw query pool!");
+    }
+}
 
-    VkResult res = vkCreateDescriptorPool(_main_device.logical_device, &create_info, nullptr, &_descriptor_pool);
+void VulkanRenderer::read_overdraw(uint32_t frame)
+{
+    if(_overdraw_query_pool == VK_NULL_HANDLE || !_overdraw_queried[frame])
+        return;
+    _overdraw_queried[frame] = false;
+
+    //fence of the frame has signaled, so no need to wait for results
+    uint64_t invocations = 0;
+    VkResult res = vkGetQueryPoolResults(_main_device.logical_device, _overdraw_query_pool, frame, 1,
+                                         sizeof(invocations), &invocations, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
     if(res != VK_SUCCESS)
+        return;
+
+    //frame without the prepass: every shaded fragment above 1 per rendered pixel is overdraw
+    const VkExtent2D extent = _overdraw_extent[frame];
+    _stats.overdraw = double(invocations) / (double(extent.width) * double(extent.height));
+    if(_depth_prepass_mode != DepthPrepassMode::Auto)
+        return;
+
+    const bool wanted = _stats.overdraw > (_depth_prepass_wanted ? OVERDRAW_PREPASS_OFF : OVERDRAW_PREPASS_ON);
+    if(wanted != _depth_prepass_wanted)
     {
-        throw std::runtime_error("Failed to create Descriptor Pool!");
+        std::cout << "Depth prepass: " << (wanted ? "on" : "off") << " (overdraw " << _stats.overdraw << ")\n";
+        _depth_prepass_wanted = wanted;
+        _frames_to_overdraw_measure = OVERDRAW_MEASURE_INTERVAL;
     }
 }
 
-void VulkanRenderer::create_descriptor_sets()
+bool VulkanRenderer::use_depth_prepass()
 {
-    //1. Create sets
-    const uint32_t buffers_num = static_cast<uint32_t>(_swapchain_images.size());
-    _descriptor_sets.resize(buffers_num);
+    if(_depth_prepass_mode == DepthPrepassMode::Off)
+        return false;
+    if(_depth_prepass_mode == DepthPrepassMode::Auto)
+    {
+        if(!_depth_prepass_wanted)
+            return false;
+        //once in a while (and after scene changes) a frame without it checks if it still pays off
+        if(_overdraw_query_pool != VK_NULL_HANDLE && _frames_to_overdraw_measure == 0)
+        {
+            _frames_to_overdraw_measure = OVERDRAW_MEASURE_INTERVAL;
+            return false;
+        }
+        _frames_to_overdraw_measure--;
+    }
 
-    //each set has a same layout
-    std::vector<VkDescriptorSetLayout> set_layouts(buffers_num, _descriptor_set_layout);
+    //try_get queues compiles of missing pipelines, frames don`t wait for them
+    bool ready = _pipelines.try_get(_depth_prepass_key) != VK_NULL_HANDLE;
+    if(!ready && _pipelines.has_failed(_depth_prepass_key))
+    {
+        if(!_depth_prepass_failed)
+            std::cerr << "Depth prepass disabled: " << _pipelines.get_desc(_depth_prepass_key).vertex_shader
+                      << " pipeline failed to compile\n";
+        _depth_prepass_failed = true;
+        return false;
+    }
+    for(Mesh &mesh : _meshes)
+    {
+        const DepthPrepassInfo &info = get_depth_prepass_info(mesh.get_pipeline_key());
+        if(info.eligible && _pipelines.try_get(info.color_key) == VK_NULL_HANDLE)
+            ready = false;
+    }
+    return ready;
+}
 
-    //we create multiple sets at once
-    VkDescriptorSetAllocateInfo allocate_info
+const VulkanRenderer::DepthPrepassInfo& VulkanRenderer::get_depth_prepass_info(uint64_t pipeline_key)
+{
+    auto it = _depth_prepass_info.find(pipeline_key);
+    if(it != _depth_prepass_info.end())
+        return it->second;
+
+    const PipelineDesc &desc = _pipelines.get_desc(pipeline_key);
+    const PipelineDesc &depth_desc = _pipelines.get_desc(_depth_prepass_key);
+    //without dynamic raster state the depth pipeline culls like the default one
+    const bool same_raster = _pipelines.has_dynamic_raster_state() ||
+                             (desc.cull_mode == depth_desc.cull_mode && desc.front_face == depth_desc.front_face);
+
+    DepthPrepassInfo info{};
+    info.eligible = !desc.transparent && desc.depth_test && desc.depth_write && same_raster &&
+                    (desc.depth_compare == VK_COMPARE_OP_LESS || desc.depth_compare == VK_COMPARE_OP_LESS_OR_EQUAL);
+    if(info.eligible)
     {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .descriptorPool = _descriptor_pool,
-        .descriptorSetCount = buffers_num,
-        .pSetLayouts = set_layouts.data()
-    };
+        //depth is final after the prepass, colour pass only shades the front fragment
+        PipelineDesc color_desc = desc;
+        color_desc.depth_compare = VK_COMPARE_OP_EQUAL;
+        color_desc.depth_write = false;
+        color_desc.name = (desc.name.empty() ? std::string("<unnamed>") : desc.name) + " after prepass";
+        info.color_key = _pipelines.add(color_desc);
+    }
+    return _depth_prepass_info[pipeline_key] = info;
+}
 
-    VkResult res = vkAllocateDescriptorSets(_main_device.logical_device, &allocate_info, _descriptor_sets.data());
+bool VulkanRenderer::read_gpu_timestamps(uint32_t frame)
+{
+    if(_timestamp_query_pool == VK_NULL_HANDLE || !_timestamps_written[frame])
+        return false;
+
+    //fence of the frame has signaled, so no need to wait for results
+    uint64_t timestamps[2];
+    VkResult res = vkGetQueryPoolResults(_main_device.logical_device, _timestamp_query_pool, frame * 2, 2,
+                                         sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
     if(res != VK_SUCCESS)
+        return false;
+
+    const uint64_t gpu_begin_ns = uint64_t(double(timestamps[0] & _timestamp_valid_mask) * _timestamp_period_ns);
+    const uint64_t gpu_end_ns = uint64_t(double(timestamps[1] & _timestamp_valid_mask) * _timestamp_period_ns);
+    _gpu_frame_time_ms = double(gpu_end_ns - gpu_begin_ns) / 1e6;
+
+    //GPU clock has its own origin
+    //frame can`t start on GPU before it was submitted, so move GPU timeline to be after the submit
+    const int64_t submit_offset_ns = int64_t(_frame_submit_cpu_ns[frame]) - int64_t(gpu_begin_ns);
+    if(!_gpu_clock_calibrated || submit_offset_ns > _gpu_to_cpu_offset_ns)
     {
-        throw std::runtime_error("Failed to allocate Descriptor Sets!");
+        _gpu_to_cpu_offset_ns = submit_offset_ns;
+        _gpu_clock_calibrated = true;
     }
 
-    //2. Connect each set to its uniform buffer
-    for(size_t i = 0; i < buffers_num; ++i)
+    PROFILE_GPU_ZONE("GPU frame", gpu_begin_ns + _gpu_to_cpu_offset_ns, gpu_end_ns + _gpu_to_cpu_offset_ns);
+    return true;
+}
+
+void VulkanRenderer::create_bindless_heap()
+{
+    //freed slots are reused once no frame in flight can read them
+    _bindless.create(_main_device.physical_device, _main_device.logical_device, MAX_FRAME_DRAWS);
+
+    //small material constants, written by the CPU rarely, read by every fragment
+    const VkDeviceSize material_buffer_size = sizeof(glm::vec4) * MAX_MATERIALS;
+    create_buffer(_main_device.physical_device, _main_device.logical_device, material_buffer_size,
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  &_material_buffer, &_material_buffer_memory);
+    vkMapMemory(_main_device.logical_device, _material_buffer_memory, 0, material_buffer_size, 0,
+                reinterpret_cast<void**>(&_material_data));
+    _material_buffer_handle = _bindless.add_storage_buffer(_material_buffer);
+}
+
+void VulkanRenderer::create_texture_cache()
+{
+    //0 -- anisotropic filtering is off for every sampler
+    float max_anisotropy = 0.f;
+    if(_optional_features.sampler_anisotropy)
     {
-        //VIEW-PROJECTION
-        VkDescriptorBufferInfo vp_buffer_info
-        {
-            .buffer = _vp_uniform_buffer[i],
-            //start of data == start of the buffer
-            .offset = 0,
-            //how much data will be bound
-            .range = sizeof(UBOViewProjection)
-        };
+        VkPhysicalDeviceProperties device_props;
+        vkGetPhysicalDeviceProperties(_main_device.physical_device, &device_props);
+        max_anisotropy = device_props.limits.maxSamplerAnisotropy;
+    }
 
-        VkWriteDescriptorSet vp_set_write
-        {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = _descriptor_sets[i],
-            //ref to shader: layout(binding = 0) uniform 
-            .dstBinding = 0,
-            //index in array of element
-            .dstArrayElement = 0,
-            //how many descriptors are we updating
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pBufferInfo = &vp_buffer_info
-        };
+    //uploads (and mip blits) go through the graphics queue, waited like mesh uploads
+    _textures.create(_main_device.physical_device, _main_device.logical_device, _graphics_queue, _graphics_command_pool,
+                     _bindless.is_created() ? &_bindless : nullptr, max_anisotropy);
+}
 
-        //dynamic buffer stuff -- redundant
-        ////MODEL
-        //VkDescriptorBufferInfo model_buffer_info
-        //{
-        //    .buffer = _model_uniform_buffer[i],
-        //    //start of data == start of the buffer
-        //    .offset = 0,
-        //    //step
-        //    .range = _model_uniform_alignment
-        //};
-
-        //VkWriteDescriptorSet model_set_write
-        //{
-        //    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        //    .dstSet = _descriptor_sets[i],
-        //    //ref to shader: layout(binding = 1) uniform 
-        //    .dstBinding = 1,
-        //    //index in array of element
-        //    .dstArrayElement = 0,
-        //    //how many descriotors are we updating
-        //    .descriptorCount = 1,
-        //    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-        //    .pBufferInfo = &model_buffer_info
-        //};
-
-        std::array<VkWriteDescriptorSet, 1> descriptor_set_updates
-        {
-            vp_set_write,
-            //dynamic buffer stuff -- redundant
-            //model_set_write
-        };
+void VulkanRenderer::create_light_clusters()
+{
+    //binning runs on the graphics queue, it needs compute support
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(_main_device.physical_device, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> qfp(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(_main_device.physical_device, &count, qfp.data());
+    const bool compute_supported = (qfp[_main_device.queue_indicies.graphics_family].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+    if(!compute_supported)
+        std::cout << bold_on << "Graphics queue has no compute, lights are ignored (ambient only)" << bold_off << std::endl;
+
+    _light_clusters.create(_main_device.physical_device, _main_device.logical_device, _pipeline_cache.get(),
+                           MAX_FRAME_DRAWS, compute_supported);
+}
+
+void VulkanRenderer::create_uniform_buffers()
+{
+    const VkDeviceSize vp_buffer_size = sizeof(UBOViewProjection);
 
-        vkUpdateDescriptorSets(_main_device.logical_device,
-                               descriptor_set_updates.size(), descriptor_set_updates.data(),
-                               0, nullptr);
+    //One uniform buffer for each image
+    const size_t buffers_num = _swapchain_images.size();
+
+    _vp_uniform_buffer.resize(buffers_num);
+    _vp_uniform_buffer_memory.resize(buffers_num);
+
+    //Create ViewProjection uniform buffers
+    //(models live in the uniform ring)
+    for(size_t i = 0; i < buffers_num; ++i)
+    {
+        create_buffer(_main_device.physical_device, _main_device.logical_device, vp_buffer_size,
+                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, //memory visible only to the GPU 
+                  &_vp_uniform_buffer[i], &_vp_uniform_buffer_memory[i]);
     }
 }
 
-//dynamic buffer stuff -- redundant
-//void VulkanRenderer::allocate_dynamic_buffers_transfer_space()
-//{
-//    //Info about device itself
-//    VkPhysicalDeviceProperties device_props;
-//    vkGetPhysicalDeviceProperties(_main_device.physical_device, &device_props);
-//    _min_uniform_buf_offset = device_props.limits.minUniformBufferOffsetAlignment;
-//
-//    //Calculate model uniform alighment
-//    if(sizeof(Model) == _min_uniform_buf_offset)
-//        _model_uniform_alignment = _min_uniform_buf_offset;
-//    else
-//        _model_uniform_alignment = (sizeof(Model) + _min_uniform_buf_offset) & ~(_min_uniform_buf_offset - 1);
-//
-//    //Peace of data to store all Model UBOs
-//    //Allocate a lot of memory and then add/delete meshes
-//    _model_transfer_space_size = _model_uniform_alignment * MAX_OBJECTS;
-//    _model_transfer_space = (Model *)_aligned_malloc(_model_transfer_space_size, _model_uniform_alignment);
-//}
+VkDescriptorSet VulkanRenderer::get_frame_descriptor_set(uint32_t current_image, VkBuffer model_buffer)
+{
+    //same image + ring chunk give the cached set, so usually 1 set per frame
+    return _descriptor_allocator.get_transient(_current_frame, _descriptor_set_layout,
+    {
+        //VIEW-PROJECTION
+        //ref to shader: layout(binding = 0) uniform, whole struct from the start of the buffer
+        DescriptorWrite::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _vp_uniform_buffer[current_image], 0, sizeof(UBOViewProjection)),
+        //MODEL
+        //ref to shader: layout(binding = 1) uniform, one Model from the dynamic offset
+        DescriptorWrite::buffer(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, model_buffer, 0, sizeof(Model)),
+        //LIGHTS of the frame in flight
+        DescriptorWrite::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _light_clusters.get_light_buffer(_current_frame),
+                                0, _light_clusters.get_light_buffer_size()),
+        DescriptorWrite::buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _light_clusters.get_cluster_buffer(_current_frame),
+                                0, _light_clusters.get_cluster_buffer_size())
+    });
+}
 
 void VulkanRenderer::record_commands(const uint32_t current_image)
 {
+    PROFILE_ZONE("record_commands");
+
     //Info about how to begin each command buffer
     VkCommandBufferBeginInfo cb_begin_info
     {
@@ -1314,15 +1780,20 @@ void VulkanRenderer::record_commands(const uint32_t current_image)
         VkClearValue{.depthStencil = {.depth = 1.f }} //depth
     };
 
+    //DYNAMIC RESOLUTION: below full size the scene goes to a part of the frame scene target, then is upscaled
+    const VkExtent2D render_extent = _dynamic_resolution.get_render_extent(_swapchain_extent);
+    _frame_upscaled = render_extent.width != _swapchain_extent.width || render_extent.height != _swapchain_extent.height;
+    _stats.render_scale = float(render_extent.width) / float(_swapchain_extent.width);
+
     VkRenderPassBeginInfo  rp_begin_info
     {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         //which render pass we are begining
-        .renderPass = _render_pass,
+        .renderPass = _frame_upscaled ? _scene_render_pass : _render_pass,
         .renderArea =
         {
             .offset = {0,0}, //start point of render pass in pixels
-            .extent = _swapchain_extent //size of region to run render pass at (starting at offset)
+            .extent = render_extent //size of region to run render pass at (starting at offset)
         },
         .clearValueCount = static_cast<uint32_t>(clear_values.size()),
         .pClearValues = clear_values.data()
@@ -1336,49 +1807,237 @@ void VulkanRenderer::record_commands(const uint32_t current_image)
         throw std::runtime_error("Failed to start recording a command buffer!");
     }
 
+    //models of every mesh go to the ring once, both passes read them
+    _draw_models.clear();
+    for(Mesh &mesh : _meshes)
+        _draw_models.push_back(_uniform_ring.push(mesh.get_model()));
+    _stats.uploaded_bytes += sizeof(Model) * _meshes.size();
+
+    //opaque front-to-back, transparent back-to-front
+    _render_queues.build(_meshes, _ubo_vp.view);
+
+    const bool depth_prepass = use_depth_prepass();
+    //shaded fragments of a frame without the prepass tell if it would pay off
+    const bool measure_overdraw = _overdraw_query_pool != VK_NULL_HANDLE && !depth_prepass;
+    _overdraw_queried[_current_frame] = measure_overdraw;
+    _overdraw_extent[_current_frame] = render_extent;
+    _stats.depth_prepass = depth_prepass;
+
     //everything with vkCmd is recorded commands
     {
-        //say we are using a render pass (not compute or transfer)
-        rp_begin_info.framebuffer = _swapchain_framebuffers[current_image];
-        vkCmdBeginRenderPass(_command_buffers[current_image], &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-        //INLINE -- no secoonary command buffers
+        //queries must be reset before they are written again (outside of render pass)
+        if(_timestamp_query_pool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(_command_buffers[current_image], _timestamp_query_pool, _current_frame * 2, 2);
+            vkCmdWriteTimestamp(_command_buffers[current_image], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                _timestamp_query_pool, _current_frame * 2);
+        }
+        if(measure_overdraw)
+            vkCmdResetQueryPool(_command_buffers[current_image], _overdraw_query_pool, _current_frame, 1);
+
+        //LIGHTS: cluster lists for this camera and rendered size (compute, before the render pass)
+        _light_clusters.update(_current_frame, _lights, _ambient_light, _ubo_vp.view, _ubo_vp.projection, render_extent);
+        _light_clusters.record_binning(_command_buffers[current_image], _current_frame, _descriptor_allocator);
+        _stats.lights = _light_clusters.get_light_count();
+        _stats.uploaded_bytes += sizeof(Light) * _stats.lights;
+
+        //STREAMING: copies of loaded geometry within the budget, finished meshes are drawn from this frame on
+        _streamer.update(_command_buffers[current_image], _current_frame, _frame_number, _meshes,
+                         _ubo_vp.view, _ubo_vp.projection, render_extent);
+        _stats.uploaded_bytes += _streamer.get_stats().frame_uploaded_bytes;
+
+#ifdef VK_KHR_dynamic_rendering
+        if(_optional_features.dynamic_rendering)
+        {
+            if(_frame_upscaled)
+                begin_dynamic_rendering(_command_buffers[current_image], _scene_targets[_current_frame].image,
+                                        _scene_targets[_current_frame].image_view, render_extent, clear_values);
+            else
+                begin_dynamic_rendering(_command_buffers[current_image], _swapchain_images[current_image].image,
+                                        _swapchain_images[current_image].image_view, render_extent, clear_values);
+        }
+        else
+#endif
+        {
+            //say we are using a render pass (not compute or transfer)
+            rp_begin_info.framebuffer = _frame_upscaled ? _scene_targets[_current_frame].framebuffer
+                                                        : _swapchain_framebuffers[current_image];
+            vkCmdBeginRenderPass(_command_buffers[current_image], &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+            //INLINE -- no secoonary command buffers
+        }
 
-        //bind pipeline to render pass
-        vkCmdBindPipeline(_command_buffers[current_image], VK_PIPELINE_BIND_POINT_GRAPHICS, _graphics_pipline);
+        //viewport and scissor are dynamic in every pipeline, set once per command buffer
+        //(scaled part of the target, same aspect ratio, so projection stays)
+        VkViewport viewport
+        {
+            .x = 0.f,
+            .y = 0.f,
+            .width = static_cast<float>(render_extent.width),
+            .height = static_cast<float>(render_extent.height),
+            .minDepth = 0.f,
+            .maxDepth = 1.f
+        };
+        VkRect2D scissor
+        {
+            .offset = {0, 0},
+            .extent = render_extent
+        };
+        vkCmdSetViewport(_command_buffers[current_image], 0, 1, &viewport);
+        vkCmdSetScissor(_command_buffers[current_image], 0, 1, &scissor);
 
-        size_t j = 0;
-        for(Mesh &mesh : _meshes)
+        //every bindless resource of the frame with one bind, set 0 binds below keep it (compatible layout)
+        if(_bindless.is_created())
         {
+            VkDescriptorSet bindless_set = _bindless.get_set();
+            vkCmdBindDescriptorSets(_command_buffers[current_image], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipline_layout,
+                                    1/*first set*/, 1, &bindless_set, 0, nullptr);
+        }
+
+        if(measure_overdraw)
+            vkCmdBeginQuery(_command_buffers[current_image], _overdraw_query_pool, _current_frame, 0);
+
+        _stats.draw_calls = 0;
+        VkPipeline bound_pipeline = VK_NULL_HANDLE;
+        PipelineDynamicState bound_state{};
+        bool state_set = false;
+        VkBuffer bound_model_buffer = VK_NULL_HANDLE;
+        VkDescriptorSet frame_set = VK_NULL_HANDLE;
+
+        //bind pipeline to render pass, only when it changes
+        auto bind_pipeline = [&](VkPipeline pipeline, const PipelineDynamicState &state)
+        {
+            if(pipeline != bound_pipeline)
+            {
+                vkCmdBindPipeline(_command_buffers[current_image], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                bound_pipeline = pipeline;
+            }
+            if(_pipelines.has_dynamic_raster_state() && (!state_set || !(state == bound_state)))
+            {
+                _vkCmdSetCullModeEXT(_command_buffers[current_image], state.cull_mode);
+                _vkCmdSetFrontFaceEXT(_command_buffers[current_image], state.front_face);
+                _vkCmdSetDepthTestEnableEXT(_command_buffers[current_image], state.depth_test);
+                _vkCmdSetDepthWriteEnableEXT(_command_buffers[current_image], state.depth_write);
+                _vkCmdSetDepthCompareOpEXT(_command_buffers[current_image], state.depth_compare);
+                bound_state = state;
+                state_set = true;
+            }
+        };
+
+        auto draw_mesh = [&](size_t i)
+        {
+            Mesh &mesh = _meshes[i];
+            //streamed mesh without any LOD yet
+            if(mesh.get_index_count() == 0)
+                return;
             //Buffers to bind to drawing
             VkBuffer vertex_buffers[] = {mesh.get_vertex_buffer()};
             VkDeviceSize offsets[] = {0};
             vkCmdBindVertexBuffers(_command_buffers[current_image], 0/*binding from shader*/, 1, vertex_buffers, offsets);
             vkCmdBindIndexBuffer(_command_buffers[current_image], mesh.get_index_buffer(), 0, VK_INDEX_TYPE_UINT32);
 
-            //dynamic buffer stuff -- redundant
-            //Offset only applies to the dynamic uniform buffers
-            //const uint32_t dynamic_model_offset_for_current_mesh = _model_uniform_alignment * j;
+            //offset only applies to the dynamic uniform buffer
+            //set changes only when the ring moves to another chunk
+            const UniformRing::Allocation &model = _draw_models[i];
+            if(model.buffer != bound_model_buffer)
+            {
+                frame_set = get_frame_descriptor_set(current_image, model.buffer);
+                bound_model_buffer = model.buffer;
+            }
+            vkCmdBindDescriptorSets(_command_buffers[current_image], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipline_layout,
+                                    0/*first set*/, 1, &frame_set, 1, &model.offset);
+
+            //execute our pipline
+            vkCmdDrawIndexed(_command_buffers[current_image], mesh.get_index_count(), 1,
+                             mesh.get_first_index(), mesh.get_vertex_offset(), 0);
+            _stats.draw_calls++;
+        };
 
-            //Push constants to vertex directly without a buffer
+        //DEPTH PREPASS: depth of opaque meshes, cheap (no fragment shader)
+        if(depth_prepass)
+        {
+            const VkPipeline depth_pipeline = _pipelines.try_get(_depth_prepass_key);
+            for(const SortItem &item : _render_queues.get_opaque())
+            {
+                const uint32_t i = item.mesh;
+                const uint64_t key = _meshes[i].get_pipeline_key();
+                if(!get_depth_prepass_info(key).eligible)
+                    continue;
+
+                //raster state of the mesh, so the colour pass gets exactly the same depth
+                PipelineDynamicState state = _pipelines.get_dynamic_state(key);
+                state.depth_write = VK_TRUE;
+                bind_pipeline(depth_pipeline, state);
+                draw_mesh(i);
+            }
+        }
+
+        //COLOUR PASS
+        //opaque queue, then transparent queue over the finished opaque image
+        auto draw_colour = [&](uint32_t i)
+        {
+            Mesh &mesh = _meshes[i];
+            //after the prepass opaque meshes use their EQUAL variant
+            uint64_t key = mesh.get_pipeline_key();
+            if(depth_prepass && get_depth_prepass_info(key).eligible)
+                key = get_depth_prepass_info(key).color_key;
+            //(variant that isn`t compiled yet gives the default pipeline)
+            bind_pipeline(_pipelines.get(key), _pipelines.get_dynamic_state(key));
+
+            //Push constants to fragment directly without a buffer
+            const PushConstants push_constants{mesh.get_draw_handles()};
             vkCmdPushConstants(_command_buffers[current_image],
                                _pipline_layout,
-                               VK_SHADER_STAGE_VERTEX_BIT,
+                               _push_constant_range.stageFlags,
                                0,
-                               sizeof(Model),
-                               &mesh.get_model()
+                               sizeof(PushConstants),
+                               &push_constants
                                );
-            vkCmdBindDescriptorSets(_command_buffers[current_image], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipline_layout,
-                                    0/*first set*/, 1, &_descriptor_sets[current_image], 0, nullptr);
-            //dynamic buffer stuff -- redundant
-                                    //1, &dynamic_model_offset_for_current_mesh);
+            draw_mesh(i);
+        };
+        for(const SortItem &item : _render_queues.get_opaque())
+            draw_colour(item.mesh);
+        for(const SortItem &item : _render_queues.get_transparent())
+            draw_colour(item.mesh);
 
-            //execute our pipline
-            vkCmdDrawIndexed(_command_buffers[current_image], mesh.get_index_count(), 1, 0, 0, 0);
-                
-            j++;
+        if(measure_overdraw)
+            vkCmdEndQuery(_command_buffers[current_image], _overdraw_query_pool, _current_frame);
+
+#ifdef VK_KHR_dynamic_rendering
+        if(_optional_features.dynamic_rendering)
+        {
+            if(_frame_upscaled)
+                end_dynamic_rendering(_command_buffers[current_image], _scene_targets[_current_frame].image,
+                                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+            else
+                end_dynamic_rendering(_command_buffers[current_image], _swapchain_images[current_image].image,
+                                      _color_final_layout);
         }
+        else
+#endif
+            vkCmdEndRenderPass(_command_buffers[current_image]);
 
-        vkCmdEndRenderPass(_command_buffers[current_image]);
+        if(_frame_upscaled)
+            record_upscale(_command_buffers[current_image], current_image, render_extent);
+
+        //copy out the finished image, slot is reused when this frame fence is waited again
+        if(_readback.is_created())
+        {
+            //last write of the colour image: the upscale blit or the render pass
+            const VkPipelineStageFlags src_stage = _frame_upscaled ? VK_PIPELINE_STAGE_TRANSFER_BIT
+                                                                   : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            const VkAccessFlags src_access = _frame_upscaled ? VK_ACCESS_TRANSFER_WRITE_BIT
+                                                             : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            _readback.record_copy(_command_buffers[current_image], _current_frame,
+                                  _swapchain_images[current_image].image, _color_final_layout,
+                                  src_stage, src_access, _frame_number);
+        }
+
+        if(_timestamp_query_pool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(_command_buffers[current_image], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                _timestamp_query_pool, _current_frame * 2 + 1);
+            _timestamps_written[_current_frame] = true;
+        }
 
         res = vkEndCommandBuffer(_command_buffers[current_image]);
         if(res != VK_SUCCESS)
@@ -1388,26 +2047,166 @@ void VulkanRenderer::record_commands(const uint32_t current_image)
     }
 }
 
+#ifdef VK_KHR_dynamic_rendering
+void VulkanRenderer::begin_dynamic_rendering(VkCommandBuffer command_buffer, VkImage color_image, VkImageView color_view,
+                                             VkExtent2D render_extent, const std::array<VkClearValue, 2> &clear_values)
+{
+    //combined formats have to be transitioned with both aspects
+    VkImageAspectFlags depth_aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if(_depth_buffer_format == VK_FORMAT_D32_SFLOAT_S8_UINT || _depth_buffer_format == VK_FORMAT_D24_UNORM_S8_UINT)
+        depth_aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    //what the first subpass dependency + initialLayout of the render pass did:
+    //UNDEFINED -> attachment layouts (old content is cleared anyway)
+    std::array<VkImageMemoryBarrier, 2> to_attachment =
+    {
+        VkImageMemoryBarrier
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = color_image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+        },
+        //depth image is shared: wait for the writes of the previous frame
+        VkImageMemoryBarrier
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = _depth_buffer_image,
+            .subresourceRange = {depth_aspect, 0, 1, 0, 1}
+        }
+    };
+    //colour stage is the one image_available semaphore is waited at
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                         0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(to_attachment.size()), to_attachment.data());
+
+    VkRenderingAttachmentInfoKHR color_attachment
+    {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .imageView = color_view,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = clear_values[0]
+    };
+    VkRenderingAttachmentInfoKHR depth_attachment
+    {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .imageView = _depth_buffer_image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        //not needed after the frame
+        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .clearValue = clear_values[1]
+    };
+
+    VkRenderingInfoKHR rendering_info
+    {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+        .renderArea = {.offset = {0, 0}, .extent = render_extent},
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment,
+        .pDepthAttachment = &depth_attachment
+    };
+    _vkCmdBeginRenderingKHR(command_buffer, &rendering_info);
+}
+
+void VulkanRenderer::end_dynamic_rendering(VkCommandBuffer command_buffer, VkImage color_image, VkImageLayout color_final_layout)
+{
+    _vkCmdEndRenderingKHR(command_buffer);
+
+    //finalLayout of the render pass: PRESENT_SRC, or TRANSFER_SRC for offscreen images and scene targets
+    //(copies and blits that follow wait for it)
+    const bool to_transfer = color_final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    VkImageMemoryBarrier to_final
+    {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = to_transfer ? VkAccessFlags(VK_ACCESS_TRANSFER_READ_BIT) : VkAccessFlags(0),
+        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout = color_final_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = color_image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+    };
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         to_transfer ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &to_final);
+}
+#endif
+
+void VulkanRenderer::record_upscale(VkCommandBuffer command_buffer, uint32_t current_image, VkExtent2D render_extent)
+{
+    //scene target is already a blit source (render pass / end_dynamic_rendering), colour image gets everything overwritten
+    VkImageMemoryBarrier to_transfer
+    {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = _swapchain_images[current_image].image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+    };
+    //transfer stage is the one image_available semaphore is waited at for upscaled frames
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+    //bilinear upscale of the rendered part to the whole image
+    VkImageBlit region
+    {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .srcOffsets = {{0, 0, 0}, {int32_t(render_extent.width), int32_t(render_extent.height), 1}},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstOffsets = {{0, 0, 0}, {int32_t(_swapchain_extent.width), int32_t(_swapchain_extent.height), 1}}
+    };
+    vkCmdBlitImage(command_buffer,
+                   _scene_targets[_current_frame].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   _swapchain_images[current_image].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &region, VK_FILTER_LINEAR);
+
+    //same layout the render pass leaves the colour image in
+    //(readback waits for the transfer stage of this barrier, see record_commands)
+    VkImageMemoryBarrier to_final = to_transfer;
+    to_final.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_final.dstAccessMask = 0;
+    to_final.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_final.newLayout = _color_final_layout;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &to_final);
+}
+
 //Update date about view and position of all objects every frame
 void VulkanRenderer::update_uniform_buffers(uint32_t index)
 {
+    PROFILE_ZONE("update_uniform_buffers");
+
     //VP data
     void *data = nullptr;
     vkMapMemory(_main_device.logical_device, _vp_uniform_buffer_memory[index], 0, sizeof(UBOViewProjection), 0, &data);
     std::memcpy(data, &_ubo_vp, sizeof(_ubo_vp));
     vkUnmapMemory(_main_device.logical_device, _vp_uniform_buffer_memory[index]);
-
-    //Model data
-    //Was relevant when we used dynamic buffers, keep here as a reference
-    //for(size_t i = 0; i < _meshes.size(); i++)
-    //{
-    //    const uint32_t dynamic_model_offset_for_current_mesh = _model_uniform_alignment * i;
-    //    Model *current_model = (Model*)((uint64_t)_model_transfer_space + dynamic_model_offset_for_current_mesh);
-    //    *current_model = _meshes[i].get_model();
-    //}
-    //vkMapMemory(_main_device.logical_device, _model_uniform_buffer_memory[index], 0, _meshes.size() * _model_uniform_alignment, 0, &data);
-    //std::memcpy(data, _model_transfer_space, _meshes.size() * _model_uniform_alignment);
-    //vkUnmapMemory(_main_device.logical_device, _model_uniform_buffer_memory[index]);
+    _stats.uploaded_bytes += sizeof(_ubo_vp);
+    //Model data is pushed into the uniform ring while recording
 }
 
 bool VulkanRenderer::check_validation_layers_support()
@@ -3,12 +3,51 @@
 #define GLFW_INCLUDE_VULKAN
 #include <glfw/glfw3.h>
 
+#include <array>
 #include <stdexcept>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "vk_utils.h"
 #include "vk_mesh.h"
-
+#include "vk_readback.h"
+#include "vk_pipeline_cache.h"
+#include "vk_pipeline_library.h"
+#include "vk_bindless.h"
+#include "vk_descriptor_allocator.h"
+#include "vk_uniform_ring.h"
+#include "vk_light_clusters.h"
+#include "vk_mesh_streamer.h"
+#include "vk_texture.h"
+#include "render_queue.h"
+#include "dynamic_resolution.h"
+
+
+struct RendererStats
+{
+    //draw calls recorded for the last frame
+    uint32_t draw_calls = 0;
+    //bytes copied from CPU to GPU since init (geometry + uniforms)
+    uint64_t uploaded_bytes = 0;
+    std::string device_name;
+    //time spent in init, and if the pipeline cache came from disk
+    double init_ms = 0.0;
+    bool pipeline_cache_warm = false;
+    //size of transient attachments in lazily allocated memory (not backed on tilers)
+    uint64_t lazy_attachment_bytes = 0;
+    //shaded fragments per pixel of the last measured frame (0 if never measured)
+    double overdraw = 0.0;
+    //last frame drew opaque depth first
+    bool depth_prepass = false;
+    //rendered size / output size of the last frame (dynamic resolution)
+    float render_scale = 1.f;
+    //lights binned for the last frame
+    uint32_t lights = 0;
+};
+
+//Off -- never, On -- always, Auto -- when measured overdraw is high enough
+enum class DepthPrepassMode { Off, On, Auto };
 
 class VulkanRenderer
 {
@@ -16,6 +55,85 @@ public:
     VulkanRenderer() = default;
 
     int init(GLFWwindow *new_window);
+    //Render into a pool of offscreen images instead of a window
+    //no GLFW, surface, presentation queue or swapchain is created (works on software ICDs like lavapipe)
+    int init_headless(uint32_t width, uint32_t height);
+
+    //upload new geometry, returns model_id for updateModel
+    //vertex / index data equal to what another mesh has shares its buffer (see GeometryRegistry)
+    uint32_t add_mesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+    //draw geometry of model_id once more (no new upload), returns new model_id
+    uint32_t add_mesh_instance(uint32_t model_id);
+    //all meshes of a mesh cache file (see mesh_file.h) at their LOD 0, returns their model_ids
+    //file is mapped and its blobs go to one vertex and one index buffer as they are
+    std::vector<uint32_t> load_mesh_file(const std::string &path);
+    //meshes of a glTF / OBJ file (see mesh_import.h), uploaded as the importer threads finish them
+    //returns their model_ids, logs the import throughput
+    std::vector<uint32_t> import_asset(const std::string &path);
+    //all meshes of a mesh cache file, loaded in the background (see MeshStreamer), returns their model_ids at once
+    //meshes aren`t drawn until their coarsest LOD is uploaded, full detail follows, closest / biggest first
+    std::vector<uint32_t> stream_mesh_file(const std::string &path);
+    //bytes of streamed geometry copied to the GPU per frame (more -- streams in faster, frames cost more)
+    void set_streaming_budget(VkDeviceSize bytes_per_frame) { _streamer.set_budget(bytes_per_frame); }
+
+    //state of the default pipeline (render pass filled in), start point for new variants
+    PipelineDesc get_default_pipeline_desc() const;
+    //register a pipeline variant, compiled in the background the first time a mesh uses it
+    uint64_t add_pipeline_variant(const PipelineDesc &desc) { return _pipelines.add(desc); }
+    //meshes are drawn with the default pipeline until their variant is compiled
+    void set_mesh_pipeline(uint32_t model_id, uint64_t pipeline_key)
+    {
+        if(model_id >= _meshes.size())
+            return;
+
+        _meshes[model_id].set_pipeline_key(pipeline_key);
+        _meshes[model_id].set_transparent(_pipelines.get_desc(pipeline_key).transparent);
+        _frames_to_overdraw_measure = 0;
+    }
+
+    //depth of opaque meshes is drawn first, colour pass then shades only visible fragments (EQUAL test)
+    void set_depth_prepass_mode(DepthPrepassMode mode) { _depth_prepass_mode = mode; }
+
+    //global descriptor heap (set 1), nullptr if the device has no descriptor indexing
+    BindlessHeap* get_bindless_heap() { return _bindless.is_created() ? &_bindless : nullptr; }
+    //material constants in the bindless material buffer, returns handles for set_mesh_draw_handles
+    DrawHandles add_material(glm::vec4 tint);
+    //image file uploaded with its mip chain, the same file (content) is loaded once, returns texture_id
+    uint32_t load_texture(const std::string &path, bool srgb = true) { return _textures.load(path, srgb); }
+    uint32_t add_texture(const uint8_t *rgba_pixels, uint32_t width, uint32_t height, bool srgb = true)
+    {
+        return _textures.add_rgba8(rgba_pixels, width, height, srgb);
+    }
+    //bindless texture + sampler slots of the handles (equal sampler descs share a sampler)
+    void set_material_texture(DrawHandles &handles, uint32_t texture_id, const SamplerDesc &sampler = {})
+    {
+        handles.texture = _textures.get(texture_id).handle;
+        handles.sampler = _textures.get_sampler_handle(sampler);
+    }
+    void set_mesh_draw_handles(uint32_t model_id, const DrawHandles &handles)
+    {
+        if(model_id >= _meshes.size())
+            return;
+
+        _meshes[model_id].set_draw_handles(handles);
+    }
+
+    //clustered forward lighting: any amount of point / spot lights, only the ones near a fragment are shaded
+    //returns light_id for update_light
+    uint32_t add_light(const Light &light)
+    {
+        _lights.push_back(light);
+        return static_cast<uint32_t>(_lights.size() - 1);
+    }
+    void update_light(uint32_t light_id, const Light &light)
+    {
+        if(light_id >= _lights.size())
+            return;
+
+        _lights[light_id] = light;
+    }
+    //added to every surface, white (1) shows vertex colours unlit
+    void set_ambient_light(glm::vec3 ambient) { _ambient_light = ambient; }
 
     void updateModel(uint32_t model_id, glm::mat4 new_model)
     {
@@ -28,12 +146,42 @@ public:
     void draw();
     void cleanup();
 
+    //GPU time of the last finished frame (0 if the queue has no timestamp support)
+    double get_gpu_frame_time_ms() const { return _gpu_frame_time_ms; }
+    uint64_t get_frame_number() const { return _frame_number; }
+    const RendererStats& get_stats() const { return _stats; }
+    const DescriptorAllocator::Stats& get_descriptor_stats() const { return _descriptor_allocator.get_stats(); }
+    const TextureCache::Stats& get_texture_stats() const { return _textures.get_stats(); }
+    const MeshStreamer::Stats& get_streaming_stats() const { return _streamer.get_stats(); }
+    const GeometryRegistry::Stats& get_geometry_stats() const { return _geometry.get_stats(); }
+
+    //Copy every rendered frame back to host memory, callback is called MAX_FRAME_DRAWS frames later
+    //from draw() (and for the last frames from cleanup()), call after init
+    //false if the colour images can`t be used as a copy source
+    bool enable_readback(FrameReadback::Callback callback);
+
+    //Dynamic resolution: scene is rendered into a part of a full size target and upscaled (linear blit)
+    //scale follows GPU frame time towards target_gpu_ms, 0 turns it off, call after init
+    //false if GPU timestamps or blits to the colour images aren`t supported
+    bool set_dynamic_resolution(double target_gpu_ms, float min_scale = 0.5f, float max_scale = 1.f);
+
     ~VulkanRenderer(){}
 
 private:
+    //microbenchmarks drive record_commands/update_uniform_buffers directly
+    friend struct RendererBenchAccess;
+
     //max amount of images on the queue
     static constexpr uint32_t MAX_FRAME_DRAWS = 2;
-    static constexpr uint32_t MAX_OBJECTS = 20;
+    static constexpr uint32_t MAX_MATERIALS = 1024;
+    //Auto depth prepass: switched on above, off below (gap so it doesn`t flip every measurement)
+    static constexpr double OVERDRAW_PREPASS_ON = 1.5;
+    static constexpr double OVERDRAW_PREPASS_OFF = 1.2;
+    //frames with the prepass between measurements without it
+    static constexpr uint32_t OVERDRAW_MEASURE_INTERVAL = 300;
+    //streamed geometry: default copies per frame (~500 MiB/s at 60 fps), staging per frame in flight (max budget)
+    static constexpr VkDeviceSize STREAMING_BUDGET = 8 << 20;
+    static constexpr VkDeviceSize STREAMING_STAGING_SIZE = 32 << 20;
 
     const std::vector<const char*> _needed_device_extentions
     {
@@ -46,11 +194,27 @@ private:
     const bool enable_validation_layers = true;
 #endif
 
-    GLFWwindow *_window;
+    GLFWwindow *_window = nullptr;
+    bool _headless = false;
     uint32_t _current_frame = 0;
+    //frames submitted since init
+    uint64_t _frame_number = 0;
+    //headless mode cycles through offscreen images instead of acquiring them
+    uint32_t _next_offscreen_image = 0;
 
     // Scene objects
     std::vector<Mesh> _meshes;
+    //buffers shared by the meshes of a mesh file (meshes don`t own them)
+    struct GeometryBuffers
+    {
+        VkBuffer vertex_buffer;
+        VkDeviceMemory vertex_buffer_memory;
+        VkBuffer index_buffer;
+        VkDeviceMemory index_buffer_memory;
+    };
+    std::vector<GeometryBuffers> _geometry_buffers;
+
+    RendererStats _stats;
 
     //Scene settings
     struct UBOViewProjection
@@ -70,22 +234,60 @@ private:
     std::vector<VkBuffer> _vp_uniform_buffer;
     std::vector<VkDeviceMemory> _vp_uniform_buffer_memory;
 
-    VkDescriptorPool _descriptor_pool;
-    //Describe set of data stored in buffer
-    std::vector <VkDescriptorSet> _descriptor_sets;
-
-    //dynamic buffer stuff -- redundant
-    //VkDeviceSize _min_uniform_buf_offset;
-    //size_t _model_uniform_alignment;
-    //size_t _model_transfer_space_size;
-    //Model *_model_transfer_space;
-    ////Dynamic uniform buffer
-    //std::vector<VkBuffer> _model_uniform_buffer;
-    //std::vector<VkDeviceMemory> _model_uniform_buffer_memory;
+    DescriptorAllocator _descriptor_allocator;
+    //Dynamic uniform buffer: per draw models (any amount of objects)
+    UniformRing _uniform_ring;
+    //ring allocation of every mesh in the frame being recorded
+    std::vector<UniformRing::Allocation> _draw_models;
+    //draw order of the frame being recorded
+    RenderQueues _render_queues;
+
+    //Lights (world space), binned into clusters every frame
+    std::vector<Light> _lights;
+    glm::vec3 _ambient_light{1.f};
+    LightClusters _light_clusters;
+
+    //Buffers of add_mesh geometry, shared between meshes with the same data
+    GeometryRegistry _geometry;
+    //Background loading of mesh files, copies recorded into the frames
+    MeshStreamer _streamer;
+
+    //Depth prepass
+    struct DepthPrepassInfo
+    {
+        //opaque, writes depth, and its raster state can be matched by the depth pipeline
+        bool eligible;
+        //same variant with EQUAL test and no depth writes
+        uint64_t color_key;
+    };
+    DepthPrepassMode _depth_prepass_mode = DepthPrepassMode::Auto;
+    bool _depth_prepass_wanted = false;
+    uint64_t _depth_prepass_key = 0;
+    //depth pipeline failed to compile, logged once
+    bool _depth_prepass_failed = false;
+    //by pipeline key of the mesh
+    std::unordered_map<uint64_t, DepthPrepassInfo> _depth_prepass_info;
+    //fragment shader invocations of the colour pass, per frame in flight
+    VkQueryPool _overdraw_query_pool = VK_NULL_HANDLE;
+    std::array<bool, MAX_FRAME_DRAWS> _overdraw_queried{};
+    //render extent of the measured frame (dynamic resolution can change it between frames)
+    std::array<VkExtent2D, MAX_FRAME_DRAWS> _overdraw_extent{};
+    uint32_t _frames_to_overdraw_measure = 0;
 
     //Push constants
     VkPushConstantRange _push_constant_range;
 
+    //bindless resources, one set bind per frame
+    BindlessHeap _bindless;
+    //material constants (vec4 tint each), persistently mapped, slot in the heap
+    VkBuffer _material_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory _material_buffer_memory = VK_NULL_HANDLE;
+    glm::vec4 *_material_data = nullptr;
+    uint32_t _material_count = 0;
+    uint32_t _material_buffer_handle = BindlessHeap::INVALID_HANDLE;
+    //textures with mips and samplers (registered in the heap when there is one)
+    TextureCache _textures;
+
     // Vulkan components
     //The instance is the connection between your application and the Vulkan library 
     VkInstance _instance;
@@ -96,18 +298,74 @@ private:
         QueueFamilyIndices queue_indicies;
 
     } _main_device;
+    //optional device features, enabled when the GPU has them
+    struct
+    {
+        //VK_EXT_extended_dynamic_state: cull mode and depth state set per draw
+        bool extended_dynamic_state = false;
+        //VK_KHR_dynamic_rendering: no VkRenderPass / VkFramebuffer objects, attachments picked at record time
+        //(needs SDK headers 1.2.197+, otherwise the render pass path is always used)
+        bool dynamic_rendering = false;
+        //descriptor indexing (core 1.2 / VK_EXT_descriptor_indexing): bindless heap
+        bool descriptor_indexing = false;
+        //LAZILY_ALLOCATED memory type (tile-based / integrated GPUs): transient attachments get no real memory
+        bool lazily_allocated_memory = false;
+        //pipelineStatisticsQuery: fragment shader invocations for the overdraw measurement
+        bool pipeline_statistics = false;
+        //samplerAnisotropy: sharper minified textures at grazing angles
+        bool sampler_anisotropy = false;
+    } _optional_features;
+    //extension functions (not exported by the loader)
+    PFN_vkCmdSetCullModeEXT _vkCmdSetCullModeEXT = nullptr;
+    PFN_vkCmdSetFrontFaceEXT _vkCmdSetFrontFaceEXT = nullptr;
+    PFN_vkCmdSetDepthTestEnableEXT _vkCmdSetDepthTestEnableEXT = nullptr;
+    PFN_vkCmdSetDepthWriteEnableEXT _vkCmdSetDepthWriteEnableEXT = nullptr;
+    PFN_vkCmdSetDepthCompareOpEXT _vkCmdSetDepthCompareOpEXT = nullptr;
+#ifdef VK_KHR_dynamic_rendering
+    PFN_vkCmdBeginRenderingKHR _vkCmdBeginRenderingKHR = nullptr;
+    PFN_vkCmdEndRenderingKHR _vkCmdEndRenderingKHR = nullptr;
+#endif
     //drawing to our images
     VkQueue _graphics_queue;
     //taking and presenting images to the surface
     VkQueue _presentation_queue;
-    VkSurfaceKHR _surface;
+    VkSurfaceKHR _surface = VK_NULL_HANDLE;
     //swapchain stuff
     VkSwapchainKHR _swapchain;
     
     //info needed for image views
     VkFormat _swapchain_image_format;
     VkExtent2D _swapchain_extent;
+    //swapchain images, or offscreen colour images in headless mode
     std::vector<SwapchainImage> _swapchain_images;
+    //only offscreen images own their memory
+    std::vector<VkDeviceMemory> _offscreen_images_memory;
+    //layout color attachment is left in after the render pass
+    VkImageLayout _color_final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    //colour images can be copied from (needed by readback)
+    bool _color_transfer_src_supported = false;
+    //colour images can be blitted to (needed by dynamic resolution)
+    bool _color_transfer_dst_supported = false;
+
+    //Dynamic resolution
+    DynamicResolution _dynamic_resolution;
+    //full size scene colour target of each frame in flight, rendered partially and blitted to the colour image
+    //(created once on first enable, scale changes never reallocate)
+    struct SceneTarget
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView image_view = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    };
+    std::array<SceneTarget, MAX_FRAME_DRAWS> _scene_targets{};
+    //same as _render_pass, but colour ends as a blit source
+    VkRenderPass _scene_render_pass = VK_NULL_HANDLE;
+    //frame being recorded goes through the scene target (acquire is waited at the transfer stage then)
+    bool _frame_upscaled = false;
+
+    //frame readback (disabled until enable_readback)
+    FrameReadback _readback;
     //one framebuffer for each swapchain image
     std::vector<VkFramebuffer> _swapchain_framebuffers;
     //one to one connection between -->
@@ -119,11 +377,18 @@ private:
     VkFormat _depth_buffer_format;
     VkDeviceMemory _depth_buffer_memory;
     VkImageView _depth_buffer_image_view;
+    //memory of attachments created by create_attachment_image, for commitment reports
+    std::vector<VkDeviceMemory> _lazy_attachment_memory;
 
     //pipeline
     VkPipelineLayout _pipline_layout;
-    VkRenderPass _render_pass;
+    //VK_NULL_HANDLE with dynamic rendering
+    VkRenderPass _render_pass = VK_NULL_HANDLE;
+    //default pipeline, also stands in for variants that are still compiling
     VkPipeline _graphics_pipline;
+    PipelineLibrary _pipelines;
+    //persisted between runs, makes pipeline creation on the next start cheap
+    PipelineCacheStore _pipeline_cache;
 
     //pools
     VkCommandPool _graphics_command_pool;
@@ -133,6 +398,19 @@ private:
     std::vector<VkSemaphore> _render_finished;
     std::vector<VkFence> _draw_fences;
 
+    //GPU timing
+    //2 timestamps per frame in flight: start and end of the frame command buffer
+    VkQueryPool _timestamp_query_pool = VK_NULL_HANDLE;
+    //nanoseconds per timestamp tick
+    float _timestamp_period_ns = 0.f;
+    uint64_t _timestamp_valid_mask = 0;
+    std::array<bool, MAX_FRAME_DRAWS> _timestamps_written{};
+    //CPU time of the submit, used to put GPU zones on the CPU timeline
+    std::array<uint64_t, MAX_FRAME_DRAWS> _frame_submit_cpu_ns{};
+    int64_t _gpu_to_cpu_offset_ns = 0;
+    bool _gpu_clock_calibrated = false;
+    double _gpu_frame_time_ms = 0.0;
+
     /// Vulkan functions
     ///Checks
     //if Vulkan supports needed extensions
@@ -141,33 +419,61 @@ private:
     //validation stuff
     bool check_validation_layers_support();
     bool check_device_suitable(const VkPhysicalDevice &device);
+    std::vector<const char*> get_needed_device_extensions();
 
     //Creation of stuff
+    int init_renderer();
     //find our GPU
     void get_physical_device();
     void create_logical_device();
     void create_instance();
     void create_surface();
     void create_swapchain();
-    void create_render_pass();
+    void create_offscreen_images();
+    VkRenderPass create_render_pass(VkImageLayout color_final_layout);
+    void create_scene_targets();
+    void destroy_scene_targets();
     void create_descriptor_set_layout();
     void create_push_constant_range();
     void create_graphics_pipeline();
     void create_depth_buffer_image();
+    //attachment that lives only inside a render pass (depth, MSAA colour): transient + lazily allocated if possible
+    VkImageView create_attachment_image(VkFormat format, VkImageUsageFlags use_flags, VkImageAspectFlags aspect_flags,
+                                        VkImage &image, VkDeviceMemory &memory);
+    uint64_t get_lazy_attachment_committed_bytes() const;
     void create_framebuffers();
     void create_command_pool();
     void create_command_buffers();
     void create_synchronization();
+    void create_timestamp_queries();
+    void create_overdraw_queries();
+    void create_bindless_heap();
+    void create_light_clusters();
+    void create_texture_cache();
 
     void create_uniform_buffers();
-    void create_descriptor_pool();
-    void create_descriptor_sets();
-
-    void allocate_dynamic_buffers_transfer_space();
+    //set 0 for the frame: VP of the image + ring chunk with the models
+    VkDescriptorSet get_frame_descriptor_set(uint32_t current_image, VkBuffer model_buffer);
 
 
     //record
     void record_commands(uint32_t current_image);
+#ifdef VK_KHR_dynamic_rendering
+    //dynamic rendering does no layout transitions, barriers replace the ones of the render pass
+    void begin_dynamic_rendering(VkCommandBuffer command_buffer, VkImage color_image, VkImageView color_view,
+                                 VkExtent2D render_extent, const std::array<VkClearValue, 2> &clear_values);
+    void end_dynamic_rendering(VkCommandBuffer command_buffer, VkImage color_image, VkImageLayout color_final_layout);
+#endif
+    //scaled scene target -> colour image (linear filter), leaves it in _color_final_layout
+    void record_upscale(VkCommandBuffer command_buffer, uint32_t current_image, VkExtent2D render_extent);
 
     void update_uniform_buffers(uint32_t index);
+    //read timestamps of the frame whose fence just signaled
+    //true if there was a new GPU frame time
+    bool read_gpu_timestamps(uint32_t frame);
+    //overdraw of a finished frame, Auto mode decides on the prepass here
+    void read_overdraw(uint32_t frame);
+    //prepass this frame: wanted, not a measuring frame, and every pipeline of it is compiled
+    bool use_depth_prepass();
+    const DepthPrepassInfo& get_depth_prepass_info(uint64_t pipeline_key);
 };
\ No newline at end of file